@@ -0,0 +1,816 @@
+#ifndef BPLUSTREE_CLASS
+#define BPLUSTREE_CLASS
+
+#include <stddef.h>//This gets NULL
+#include <functional>
+#include <utility>
+#include "KeyCompare.hh"
+
+template<typename Key, typename T, typename Compare = std::less<Key>,
+    int Fanout = 16>
+/**
+ * @breif The BPlusTree is a multiset with the interface of RBTree laid out as
+ *        a B+-tree, whose wide nodes take one cache miss for several levels
+ *        of a binary tree.
+ *
+ * Every node holds up to Fanout keys, the inner nodes Fanout children. The
+ * elements are in the leaves, which are linked to walk them in order, and
+ * the keys of a node are kept apart from the rest, so the Fanout keys of a
+ * search fill Fanout * sizeof(Key) / 64 cache lines. A node is searched by
+ * counting the keys below the given one, with no branch to mispredict.
+ *
+ * Like in RBTree, elements with the same key and data share a slot through
+ * its multiplicity, and an element with the key of another one but different
+ * data is rejected. The elements are given as a Position, which stays good
+ * until the tree changes. Key and T must be default constructible.
+ */
+class BPlusTree : private KeyCompare<Compare>{
+    static_assert(Fanout >= 4, "a node needs room for 4 keys at least");
+
+    private:
+        /**
+         * @breif A leaf, with the elements.
+         */
+        struct alignas(64) Leaf {
+            Key keys[Fanout];
+            int multiplicities[Fanout];
+            int size = 0;
+            Leaf * previous = NULL;
+            Leaf * next = NULL;
+            T data[Fanout];
+        };
+
+        /**
+         * @breif An inner node. The keys of the child i + 1 go from the key
+         *        i on, the ones of the child i before it.
+         */
+        struct alignas(64) Inner {
+            Key keys[Fanout - 1];
+            void * children[Fanout];
+            int size = 0;///How many children.
+        };
+
+    public:
+        /**
+         * @breif An element of the tree, or past the last one.
+         */
+        class Position{
+            friend class BPlusTree;
+
+            private:
+                Leaf * leaf = NULL;
+                int slot = 0;
+
+                Position(Leaf * leaf, int slot) : leaf(leaf), slot(slot) {}
+
+            public:
+                Position(void) = default;
+
+                const Key & getKey(void) const {
+                    return this->leaf->keys[this->slot];
+                }
+                const T & getData(void) const {
+                    return this->leaf->data[this->slot];
+                }
+                int getMultiplicity(void) const {
+                    return this->leaf->multiplicities[this->slot];
+                }
+
+                /**
+                 * @breif Tells wether this is an element.
+                 * @return False past the ends of the tree.
+                 */
+                explicit operator bool(void) const {
+                    return this->leaf != NULL;
+                }
+        };
+
+    private:
+        /**
+         * @breif The root, a Leaf if height is 1, NULL if the tree is empty.
+         */
+        void * root = NULL;
+
+        /**
+         * @breif How many levels there are, the leaves included.
+         */
+        int height = 0;
+
+        /**
+         * @breif The first and the last leaf.
+         */
+        Leaf * head = NULL;
+        Leaf * tail = NULL;
+
+        /**
+         * @breif How many elements there are, multiplicities included.
+         */
+        size_t count = 0;
+
+        /**
+         * @breif The fewest keys a leaf other than the root may have.
+         */
+        static const int minLeaf = Fanout / 2;
+
+        /**
+         * @breif The fewest children an inner node other than the root may
+         *        have.
+         */
+        static const int minChildren = (Fanout + 1) / 2;
+
+        /**
+         * @breif Returns how many keys of a leaf go before a key, which is
+         *        the slot of the key.
+         */
+        int slotOf(const Leaf * leaf, const Key & key) const;
+
+        /**
+         * @breif Returns the child of an inner node whose keys hold a key.
+         */
+        int childOf(const Inner * inner, const Key & key) const;
+
+        /**
+         * @breif Returns the leaf a key belongs to.
+         */
+        Leaf * leafOf(const Key & key) const;
+
+        /**
+         * @breif Inserts an element in a subtree.
+         * @param node      The root of the subtree.
+         * @param level     The level of the node, 1 for a leaf.
+         * @param key       The key value to insert.
+         * @param data      The data to insert.
+         * @param inserted  Where is written wether the element was inserted.
+         * @param separator Where the first key of the split node is written.
+         * @return The node split off the given one when it was full, NULL if
+         *         it wasn't split.
+         */
+        void * insertNode(void * node, int level, const Key & key,
+            const T & data, bool * inserted, Key * separator);
+
+        /**
+         * @breif Extracts an element from a subtree.
+         * @param node  The root of the subtree.
+         * @param level The level of the node, 1 for a leaf.
+         * @param key   The key to extract.
+         * @param data  Where the extracted data is written, if it's found.
+         * @return True if the node was left with too few keys or children.
+         */
+        bool extractNode(void * node, int level, const Key & key, T * data);
+
+        /**
+         * @breif Gives a child that has too few keys or children some from a
+         *        sibling, or merges it with one.
+         * @param inner The parent.
+         * @param child The child.
+         * @param level The level of the child.
+         */
+        void fixChild(Inner * inner, int child, int level);
+
+        /**
+         * @breif Takes the key i and the child i + 1 out of an inner node.
+         */
+        static void removeChild(Inner * inner, int i);
+
+        /**
+         * @breif Destroys a subtree.
+         */
+        static void destroy(void * node, int level);
+
+        /**
+         * @breif Checks a subtree, see validate().
+         * @param node  The root of the subtree.
+         * @param level The level of the node.
+         * @param low   The lowest key the subtree may have, NULL if none.
+         * @param high  The key the keys of the subtree go before, NULL if
+         *              none.
+         * @param leaf  The leaf that goes before the subtree, updated to the
+         *              last one of it.
+         * @param count Where the elements are added.
+         * @return True if the subtree is right.
+         */
+        bool checkNode(const void * node, int level, const Key * low,
+            const Key * high, const Leaf ** leaf, size_t * count) const;
+
+    public:
+        /**
+         * @breif Creates an empty tree.
+         * @param compare The comparator of the keys.
+         */
+        explicit BPlusTree(const Compare & compare = Compare());
+
+        BPlusTree(const BPlusTree & other) = delete;
+        BPlusTree & operator=(const BPlusTree & other) = delete;
+
+        /**
+         * @breif Destroys the tree and its nodes.
+         */
+        ~BPlusTree(void);
+
+        /**
+         * @breif Removes every element.
+         */
+        void clear(void);
+
+        /**
+         * @breif Inserts a key-data pair, see RBTree::insert().
+         * @param key  The key value to insert.
+         * @param data The data to insert.
+         * @return True if the data was inserted, false if the key is there
+         *         with other data.
+         */
+        bool insert(const Key & key, const T & data);
+
+        /**
+         * @breif Returns the multiplicity of a key.
+         * @param key The key to search for.
+         * @return The multiplicity, 0 if the key is not in the tree.
+         */
+        int exists(const Key & key) const;
+
+        /**
+         * @breif Finds the element of a key.
+         * @param key The key to search for.
+         * @return The element, past the end if the key is not in the tree.
+         */
+        Position find(const Key & key) const;
+
+        /**
+         * @breif Extracts an element, see RBTree::extract().
+         * @param key The key to extract.
+         * @return The extracted data, a default constructed one if the key is
+         *         not in the tree.
+         */
+        T extract(const Key & key);
+
+        /**
+         * @breif Returns how many elements there are, multiplicities
+         *        included.
+         * @return The number of elements.
+         */
+        size_t size(void) const;
+
+        /**
+         * @breif Returns the element with the lowest key, in O(1).
+         * @return The element, past the end if the tree is empty.
+         */
+        Position first(void) const;
+
+        /**
+         * @breif Returns the element with the highest key, in O(1).
+         * @return The element, past the end if the tree is empty.
+         */
+        Position last(void) const;
+
+        /**
+         * @breif Returns the element that follows another one in key order.
+         * @param position The element.
+         * @return The next element, past the end after the last one.
+         */
+        Position next(Position position) const;
+
+        /**
+         * @breif Returns the element that goes before another one in key
+         *        order.
+         * @param position The element.
+         * @return The previous element, past the end before the first one.
+         */
+        Position previous(Position position) const;
+
+        /**
+         * @breif Checks the order of the keys, the sizes of the nodes, the
+         *        depth of the leaves, their links and the count, in O(n).
+         * @return True if the tree is right.
+         */
+        bool validate(void) const;
+};
+
+/******************************************************************************
+ *                                                                           **
+ * CLASS IMPLEMENTATION                                                      **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare, int Fanout>
+BPlusTree<Key, T, Compare, Fanout>::BPlusTree(const Compare & compare) :
+    KeyCompare<Compare>(compare) {}
+
+template<typename Key, typename T, typename Compare, int Fanout>
+BPlusTree<Key, T, Compare, Fanout>::~BPlusTree(void) {
+    this->clear();
+}
+
+template<typename Key, typename T, typename Compare, int Fanout>
+void BPlusTree<Key, T, Compare, Fanout>::clear(void) {
+    if (this->root != NULL) {
+        destroy(this->root, this->height);
+    }
+    this->root = NULL;
+    this->height = 0;
+    this->head = NULL;
+    this->tail = NULL;
+    this->count = 0;
+}
+
+template<typename Key, typename T, typename Compare, int Fanout>
+void BPlusTree<Key, T, Compare, Fanout>::destroy(void * node, int level) {
+    if (level == 1) {
+        delete static_cast<Leaf *>(node);
+        return;
+    }
+    Inner * inner = static_cast<Inner *>(node);
+    for (int i = 0; i < inner->size; ++i) {
+        destroy(inner->children[i], level - 1);
+    }
+    delete inner;
+}
+
+template<typename Key, typename T, typename Compare, int Fanout>
+int BPlusTree<Key, T, Compare, Fanout>::slotOf(const Leaf * leaf,
+    const Key & key) const {
+    // Counting instead of stopping at the first key that isn't lower keeps
+    // the loop free of branches.
+    int slot = 0;
+    for (int i = 0; i < leaf->size; ++i) {
+        slot += this->less(leaf->keys[i], key);
+    }
+    return slot;
+}
+
+template<typename Key, typename T, typename Compare, int Fanout>
+int BPlusTree<Key, T, Compare, Fanout>::childOf(const Inner * inner,
+    const Key & key) const {
+    int child = 0;
+    for (int i = 0; i < inner->size - 1; ++i) {
+        child += !this->less(key, inner->keys[i]);
+    }
+    return child;
+}
+
+template<typename Key, typename T, typename Compare, int Fanout>
+typename BPlusTree<Key, T, Compare, Fanout>::Leaf *
+BPlusTree<Key, T, Compare, Fanout>::leafOf(const Key & key) const {
+    void * node = this->root;
+    for (int level = this->height; level > 1; --level) {
+        const Inner * inner = static_cast<const Inner *>(node);
+        node = inner->children[this->childOf(inner, key)];
+    }
+    return static_cast<Leaf *>(node);
+}
+
+/******************************************************************************
+ *                                                                           **
+ * INSERTION                                                                 **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare, int Fanout>
+bool BPlusTree<Key, T, Compare, Fanout>::insert(const Key & key,
+    const T & data) {
+    if (this->root == NULL) {
+        Leaf * leaf = new Leaf();
+        this->root = leaf;
+        this->height = 1;
+        this->head = leaf;
+        this->tail = leaf;
+    }
+    bool inserted;
+    Key separator;
+    void * split = this->insertNode(this->root, this->height, key, data,
+        &inserted, &separator);
+    if (split != NULL) {
+        Inner * root = new Inner();
+        root->keys[0] = separator;
+        root->children[0] = this->root;
+        root->children[1] = split;
+        root->size = 2;
+        this->root = root;
+        ++this->height;
+    }
+    return inserted;
+}
+
+template<typename Key, typename T, typename Compare, int Fanout>
+void * BPlusTree<Key, T, Compare, Fanout>::insertNode(void * node, int level,
+    const Key & key, const T & data, bool * inserted, Key * separator) {
+    if (level == 1) {
+        Leaf * leaf = static_cast<Leaf *>(node);
+        int slot = this->slotOf(leaf, key);
+        if (slot < leaf->size && !this->less(key, leaf->keys[slot])) {
+            *inserted = leaf->data[slot] == data;
+            if (*inserted) {
+                ++leaf->multiplicities[slot];
+                ++this->count;
+            }
+            return NULL;
+        }
+        *inserted = true;
+        ++this->count;
+        Leaf * target = leaf;
+        Leaf * right = NULL;
+        if (leaf->size == Fanout) {
+            // The upper half moves to a new leaf, the key goes to the half
+            // it belongs to.
+            right = new Leaf();
+            int keep = (Fanout + 1) / 2;
+            if (slot < keep) {
+                --keep;
+            }
+            for (int i = keep; i < Fanout; ++i) {
+                right->keys[i - keep] = std::move(leaf->keys[i]);
+                right->multiplicities[i - keep] = leaf->multiplicities[i];
+                right->data[i - keep] = std::move(leaf->data[i]);
+            }
+            right->size = Fanout - keep;
+            leaf->size = keep;
+            right->next = leaf->next;
+            right->previous = leaf;
+            if (leaf->next != NULL) {
+                leaf->next->previous = right;
+            } else {
+                this->tail = right;
+            }
+            leaf->next = right;
+            if (slot > keep) {
+                target = right;
+                slot -= keep;
+            }
+        }
+        for (int i = target->size; i > slot; --i) {
+            target->keys[i] = std::move(target->keys[i - 1]);
+            target->multiplicities[i] = target->multiplicities[i - 1];
+            target->data[i] = std::move(target->data[i - 1]);
+        }
+        target->keys[slot] = key;
+        target->multiplicities[slot] = 1;
+        target->data[slot] = data;
+        ++target->size;
+        if (right != NULL) {
+            *separator = right->keys[0];
+        }
+        return right;
+    }
+
+    Inner * inner = static_cast<Inner *>(node);
+    int child = this->childOf(inner, key);
+    Key key2;
+    void * split = this->insertNode(inner->children[child], level - 1, key,
+        data, inserted, &key2);
+    if (split == NULL) {
+        return NULL;
+    }
+    if (inner->size < Fanout) {
+        for (int i = inner->size - 1; i > child; --i) {
+            inner->keys[i] = std::move(inner->keys[i - 1]);
+            inner->children[i + 1] = inner->children[i];
+        }
+        inner->keys[child] = key2;
+        inner->children[child + 1] = split;
+        ++inner->size;
+        return NULL;
+    }
+
+    // Fanout + 1 children don't fit, they are laid in order and the middle
+    // key goes up.
+    Key keys[Fanout];
+    void * children[Fanout + 1];
+    for (int i = 0, j = 0; i < Fanout; ++i) {
+        if (i == child) {
+            keys[j++] = key2;
+        }
+        if (i < Fanout - 1) {
+            keys[j++] = std::move(inner->keys[i]);
+        }
+    }
+    for (int i = 0, j = 0; i < Fanout; ++i) {
+        children[j++] = inner->children[i];
+        if (i == child) {
+            children[j++] = split;
+        }
+    }
+    Inner * right = new Inner();
+    int keep = (Fanout + 1) / 2;
+    for (int i = 0; i < keep; ++i) {
+        inner->children[i] = children[i];
+    }
+    for (int i = 0; i < keep - 1; ++i) {
+        inner->keys[i] = std::move(keys[i]);
+    }
+    inner->size = keep;
+    *separator = std::move(keys[keep - 1]);
+    for (int i = keep; i <= Fanout; ++i) {
+        right->children[i - keep] = children[i];
+    }
+    for (int i = keep; i < Fanout; ++i) {
+        right->keys[i - keep] = std::move(keys[i]);
+    }
+    right->size = Fanout + 1 - keep;
+    return right;
+}
+
+/******************************************************************************
+ *                                                                           **
+ * DELETION                                                                  **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare, int Fanout>
+T BPlusTree<Key, T, Compare, Fanout>::extract(const Key & key) {
+    T data = T();
+    if (this->root == NULL) {
+        return data;
+    }
+    this->extractNode(this->root, this->height, key, &data);
+    if (this->height == 1 && static_cast<Leaf *>(this->root)->size == 0) {
+        delete static_cast<Leaf *>(this->root);
+        this->root = NULL;
+        this->height = 0;
+        this->head = NULL;
+        this->tail = NULL;
+    } else if (this->height > 1 && static_cast<Inner *>(this->root)->size == 1) {
+        Inner * old = static_cast<Inner *>(this->root);
+        this->root = old->children[0];
+        --this->height;
+        delete old;
+    }
+    return data;
+}
+
+template<typename Key, typename T, typename Compare, int Fanout>
+bool BPlusTree<Key, T, Compare, Fanout>::extractNode(void * node, int level,
+    const Key & key, T * data) {
+    if (level == 1) {
+        Leaf * leaf = static_cast<Leaf *>(node);
+        int slot = this->slotOf(leaf, key);
+        if (slot == leaf->size || this->less(key, leaf->keys[slot])) {
+            return false;
+        }
+        --this->count;
+        if (--leaf->multiplicities[slot] > 0) {
+            *data = leaf->data[slot];
+            return false;
+        }
+        *data = std::move(leaf->data[slot]);
+        for (int i = slot + 1; i < leaf->size; ++i) {
+            leaf->keys[i - 1] = std::move(leaf->keys[i]);
+            leaf->multiplicities[i - 1] = leaf->multiplicities[i];
+            leaf->data[i - 1] = std::move(leaf->data[i]);
+        }
+        --leaf->size;
+        return leaf->size < minLeaf;
+    }
+    Inner * inner = static_cast<Inner *>(node);
+    int child = this->childOf(inner, key);
+    if (this->extractNode(inner->children[child], level - 1, key, data)) {
+        this->fixChild(inner, child, level - 1);
+    }
+    return inner->size < minChildren;
+}
+
+template<typename Key, typename T, typename Compare, int Fanout>
+void BPlusTree<Key, T, Compare, Fanout>::removeChild(Inner * inner, int i) {
+    for (int j = i + 1; j < inner->size - 1; ++j) {
+        inner->keys[j - 1] = std::move(inner->keys[j]);
+    }
+    for (int j = i + 2; j < inner->size; ++j) {
+        inner->children[j - 1] = inner->children[j];
+    }
+    --inner->size;
+}
+
+template<typename Key, typename T, typename Compare, int Fanout>
+void BPlusTree<Key, T, Compare, Fanout>::fixChild(Inner * inner, int child,
+    int level) {
+    bool hasLeft = child > 0;
+    bool hasRight = child < inner->size - 1;
+    if (level == 1) {
+        Leaf * leaf = static_cast<Leaf *>(inner->children[child]);
+        Leaf * left = hasLeft? static_cast<Leaf *>(inner->children[child - 1]):
+            NULL;
+        Leaf * right = hasRight?
+            static_cast<Leaf *>(inner->children[child + 1]): NULL;
+        if (left != NULL && left->size > minLeaf) {
+            for (int i = leaf->size; i > 0; --i) {
+                leaf->keys[i] = std::move(leaf->keys[i - 1]);
+                leaf->multiplicities[i] = leaf->multiplicities[i - 1];
+                leaf->data[i] = std::move(leaf->data[i - 1]);
+            }
+            --left->size;
+            leaf->keys[0] = std::move(left->keys[left->size]);
+            leaf->multiplicities[0] = left->multiplicities[left->size];
+            leaf->data[0] = std::move(left->data[left->size]);
+            ++leaf->size;
+            inner->keys[child - 1] = leaf->keys[0];
+        } else if (right != NULL && right->size > minLeaf) {
+            leaf->keys[leaf->size] = std::move(right->keys[0]);
+            leaf->multiplicities[leaf->size] = right->multiplicities[0];
+            leaf->data[leaf->size] = std::move(right->data[0]);
+            ++leaf->size;
+            for (int i = 1; i < right->size; ++i) {
+                right->keys[i - 1] = std::move(right->keys[i]);
+                right->multiplicities[i - 1] = right->multiplicities[i];
+                right->data[i - 1] = std::move(right->data[i]);
+            }
+            --right->size;
+            inner->keys[child] = right->keys[0];
+        } else {
+            // Two leaves that fit in one, the right one goes.
+            if (left == NULL) {
+                left = leaf;
+                leaf = right;
+                ++child;
+            }
+            for (int i = 0; i < leaf->size; ++i) {
+                left->keys[left->size + i] = std::move(leaf->keys[i]);
+                left->multiplicities[left->size + i] = leaf->multiplicities[i];
+                left->data[left->size + i] = std::move(leaf->data[i]);
+            }
+            left->size += leaf->size;
+            left->next = leaf->next;
+            if (leaf->next != NULL) {
+                leaf->next->previous = left;
+            } else {
+                this->tail = left;
+            }
+            delete leaf;
+            removeChild(inner, child - 1);
+        }
+        return;
+    }
+
+    Inner * node = static_cast<Inner *>(inner->children[child]);
+    Inner * left = hasLeft? static_cast<Inner *>(inner->children[child - 1]):
+        NULL;
+    Inner * right = hasRight? static_cast<Inner *>(inner->children[child + 1]):
+        NULL;
+    if (left != NULL && left->size > minChildren) {
+        // The last child of the left sibling moves over, the key between
+        // them goes through the parent.
+        for (int i = node->size - 1; i > 0; --i) {
+            node->keys[i] = std::move(node->keys[i - 1]);
+        }
+        for (int i = node->size; i > 0; --i) {
+            node->children[i] = node->children[i - 1];
+        }
+        node->keys[0] = std::move(inner->keys[child - 1]);
+        node->children[0] = left->children[left->size - 1];
+        ++node->size;
+        inner->keys[child - 1] = std::move(left->keys[left->size - 2]);
+        --left->size;
+    } else if (right != NULL && right->size > minChildren) {
+        node->keys[node->size - 1] = std::move(inner->keys[child]);
+        node->children[node->size] = right->children[0];
+        ++node->size;
+        inner->keys[child] = std::move(right->keys[0]);
+        for (int i = 1; i < right->size - 1; ++i) {
+            right->keys[i - 1] = std::move(right->keys[i]);
+        }
+        for (int i = 1; i < right->size; ++i) {
+            right->children[i - 1] = right->children[i];
+        }
+        --right->size;
+    } else {
+        // Two nodes that fit in one with the key between them, the right
+        // one goes.
+        if (left == NULL) {
+            left = node;
+            node = right;
+            ++child;
+        }
+        left->keys[left->size - 1] = inner->keys[child - 1];
+        for (int i = 0; i < node->size - 1; ++i) {
+            left->keys[left->size + i] = std::move(node->keys[i]);
+        }
+        for (int i = 0; i < node->size; ++i) {
+            left->children[left->size + i] = node->children[i];
+        }
+        left->size += node->size;
+        delete node;
+        removeChild(inner, child - 1);
+    }
+}
+
+/******************************************************************************
+ *                                                                           **
+ * SEARCH AND ORDER                                                          **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare, int Fanout>
+typename BPlusTree<Key, T, Compare, Fanout>::Position
+BPlusTree<Key, T, Compare, Fanout>::find(const Key & key) const {
+    if (this->root == NULL) {
+        return Position();
+    }
+    Leaf * leaf = this->leafOf(key);
+    int slot = this->slotOf(leaf, key);
+    if (slot == leaf->size || this->less(key, leaf->keys[slot])) {
+        return Position();
+    }
+    return Position(leaf, slot);
+}
+
+template<typename Key, typename T, typename Compare, int Fanout>
+int BPlusTree<Key, T, Compare, Fanout>::exists(const Key & key) const {
+    Position position = this->find(key);
+    return position? position.getMultiplicity(): 0;
+}
+
+template<typename Key, typename T, typename Compare, int Fanout>
+size_t BPlusTree<Key, T, Compare, Fanout>::size(void) const {
+    return this->count;
+}
+
+template<typename Key, typename T, typename Compare, int Fanout>
+typename BPlusTree<Key, T, Compare, Fanout>::Position
+BPlusTree<Key, T, Compare, Fanout>::first(void) const {
+    return this->head == NULL? Position(): Position(this->head, 0);
+}
+
+template<typename Key, typename T, typename Compare, int Fanout>
+typename BPlusTree<Key, T, Compare, Fanout>::Position
+BPlusTree<Key, T, Compare, Fanout>::last(void) const {
+    return this->tail == NULL? Position():
+        Position(this->tail, this->tail->size - 1);
+}
+
+template<typename Key, typename T, typename Compare, int Fanout>
+typename BPlusTree<Key, T, Compare, Fanout>::Position
+BPlusTree<Key, T, Compare, Fanout>::next(Position position) const {
+    if (position.slot + 1 < position.leaf->size) {
+        return Position(position.leaf, position.slot + 1);
+    }
+    return position.leaf->next == NULL? Position():
+        Position(position.leaf->next, 0);
+}
+
+template<typename Key, typename T, typename Compare, int Fanout>
+typename BPlusTree<Key, T, Compare, Fanout>::Position
+BPlusTree<Key, T, Compare, Fanout>::previous(Position position) const {
+    if (position.slot > 0) {
+        return Position(position.leaf, position.slot - 1);
+    }
+    Leaf * leaf = position.leaf->previous;
+    return leaf == NULL? Position(): Position(leaf, leaf->size - 1);
+}
+
+/******************************************************************************
+ *                                                                           **
+ * VALIDATION                                                                **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare, int Fanout>
+bool BPlusTree<Key, T, Compare, Fanout>::checkNode(const void * node,
+    int level, const Key * low, const Key * high, const Leaf ** leaf,
+    size_t * count) const {
+    bool isRoot = node == this->root;
+    if (level == 1) {
+        const Leaf * l = static_cast<const Leaf *>(node);
+        if (l->size > Fanout || l->size < (isRoot? 1: minLeaf) ||
+            l->previous != *leaf || (*leaf != NULL && (*leaf)->next != l)) {
+            return false;
+        }
+        for (int i = 0; i < l->size; ++i) {
+            if ((i > 0 && !this->less(l->keys[i - 1], l->keys[i])) ||
+                (low != NULL && this->less(l->keys[i], *low)) ||
+                (high != NULL && !this->less(l->keys[i], *high)) ||
+                l->multiplicities[i] <= 0) {
+                return false;
+            }
+            *count += l->multiplicities[i];
+        }
+        *leaf = l;
+        return true;
+    }
+    const Inner * inner = static_cast<const Inner *>(node);
+    if (inner->size > Fanout || inner->size < (isRoot? 2: minChildren)) {
+        return false;
+    }
+    for (int i = 0; i < inner->size; ++i) {
+        const Key * from = i == 0? low: &inner->keys[i - 1];
+        const Key * to = i == inner->size - 1? high: &inner->keys[i];
+        if ((i > 0 && i < inner->size - 1 &&
+            !this->less(inner->keys[i - 1], inner->keys[i])) ||
+            !this->checkNode(inner->children[i], level - 1, from, to, leaf,
+            count)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename Key, typename T, typename Compare, int Fanout>
+bool BPlusTree<Key, T, Compare, Fanout>::validate(void) const {
+    if (this->root == NULL) {
+        return this->height == 0 && this->head == NULL &&
+            this->tail == NULL && this->count == 0;
+    }
+    const Leaf * leaf = NULL;
+    size_t count = 0;
+    return this->checkNode(this->root, this->height, NULL, NULL, &leaf,
+        &count) && leaf == this->tail && leaf->next == NULL &&
+        this->head->previous == NULL && count == this->count;
+}
+
+#endif
@@ -0,0 +1,284 @@
+#ifndef BENCH_HELPERS
+#define BENCH_HELPERS
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+/**
+ * @breif Measures the elapsed wall time since it was created or restarted.
+ */
+class Stopwatch{
+    private:
+        /**
+         * @breif When the measure started.
+         */
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        /**
+         * @breif Creates a stopwatch, which starts measuring right away.
+         */
+        Stopwatch(void) {
+            this->restart();
+        }
+
+        /**
+         * @breif Starts measuring again.
+         */
+        void restart(void) {
+            this->start = std::chrono::steady_clock::now();
+        }
+
+        /**
+         * @breif Returns the elapsed time.
+         * @return The elapsed nanoseconds.
+         */
+        double elapsedNs(void) {
+            std::chrono::duration<double, std::nano> elapsed =
+                std::chrono::steady_clock::now() - this->start;
+            return elapsed.count();
+        }
+};
+
+/**
+ * @breif A xorshift generator, so every run of a benchmark sees the same keys
+ *        no matter the standard library.
+ */
+class KeyGenerator{
+    private:
+        /**
+         * @breif The state of the generator, never 0.
+         */
+        uint64_t state;
+
+    public:
+        /**
+         * @breif Creates a generator.
+         * @param seed The seed, 0 is replaced by a fixed value.
+         */
+        KeyGenerator(uint64_t seed = 88172645463325252ULL) {
+            this->state = seed == 0? 88172645463325252ULL: seed;
+        }
+
+        /**
+         * @breif Returns the next pseudo random number.
+         * @return The number.
+         */
+        uint64_t next(void) {
+            this->state ^= this->state << 13;
+            this->state ^= this->state >> 7;
+            this->state ^= this->state << 17;
+            return this->state;
+        }
+
+        /**
+         * @breif Returns a pseudo random key in [0, bound).
+         * @param bound The upper bound, must be positive.
+         * @return The key.
+         */
+        int nextKey(int bound) {
+            return static_cast<int>(this->next() % static_cast<uint64_t>(bound));
+        }
+};
+
+/**
+ * @breif Returns the resident memory of the process, read from /proc.
+ * @return The resident kilobytes, 0 if they can't be read.
+ */
+inline long residentKb(void) {
+    std::ifstream statm("/proc/self/statm");
+    long pages = 0, resident = 0;
+    if (!(statm >> pages >> resident)) {
+        return 0;
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/**
+ * @breif Returns the peak resident memory of the process since it started or
+ *        since the last resetPeakResident(), read from /proc.
+ * @return The peak resident kilobytes, 0 if they can't be read.
+ */
+inline long peakResidentKb(void) {
+    std::ifstream status("/proc/self/status");
+    std::string field;
+    long kb = 0;
+    while (status >> field) {
+        if (field == "VmHWM:") {
+            status >> kb;
+            return kb;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @breif Makes the peak resident memory start again from the current one, so
+ *        each case of a benchmark gets its own peak.
+ * @return True if the kernel allowed the reset.
+ */
+inline bool resetPeakResident(void) {
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+    clearRefs.flush();
+    return clearRefs.good();
+}
+
+/**
+ * @breif Collects the cost of batches of operations, timing every operation
+ *        by itself would mostly measure the clock.
+ */
+class LatencyRecorder{
+    private:
+        /**
+         * @breif The nanoseconds per operation of each batch.
+         */
+        std::vector<double> samples;
+
+        /**
+         * @breif The nanoseconds of every batch together.
+         */
+        double totalNs = 0;
+
+        /**
+         * @breif The operations of every batch together.
+         */
+        size_t totalOps = 0;
+
+    public:
+        /**
+         * @breif Records a batch.
+         * @param ns  The nanoseconds the batch took.
+         * @param ops How many operations the batch did, must be positive.
+         */
+        void add(double ns, size_t ops) {
+            this->samples.push_back(ns / ops);
+            this->totalNs += ns;
+            this->totalOps += ops;
+        }
+
+        /**
+         * @breif Forgets every batch.
+         */
+        void clear(void) {
+            this->samples.clear();
+            this->totalNs = 0;
+            this->totalOps = 0;
+        }
+
+        /**
+         * @breif Returns the mean cost of an operation.
+         * @return The nanoseconds per operation, 0 if nothing was recorded.
+         */
+        double nsPerOp(void) const {
+            return this->totalOps == 0? 0: this->totalNs / this->totalOps;
+        }
+
+        /**
+         * @breif Returns how many operations were recorded.
+         * @return The number of operations.
+         */
+        size_t getOps(void) const {
+            return this->totalOps;
+        }
+
+        /**
+         * @breif Returns a percentile of the batch costs.
+         * @param p The percentile, from 0 to 100.
+         * @return The nanoseconds per operation, 0 if nothing was recorded.
+         */
+        double percentile(double p) const {
+            if (this->samples.empty()) return 0;
+            std::vector<double> sorted(this->samples);
+            size_t index = static_cast<size_t>(p / 100 * (sorted.size() - 1) + 0.5);
+            std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+            return sorted[index];
+        }
+};
+
+/**
+ * @breif Counts the last level cache misses of the process through
+ *        perf_event_open. Where the kernel doesn't allow it, nothing is
+ *        counted.
+ */
+class CacheMissCounter{
+    private:
+        /**
+         * @breif The file of the counter, -1 if it couldn't be opened.
+         */
+        int fd;
+
+    public:
+        /**
+         * @breif Opens the counter, stopped.
+         */
+        CacheMissCounter(void) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            this->fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+
+        ~CacheMissCounter(void) {
+            if (this->fd >= 0) close(this->fd);
+        }
+
+        CacheMissCounter(const CacheMissCounter & other) = delete;
+        CacheMissCounter & operator=(const CacheMissCounter & other) = delete;
+
+        /**
+         * @breif Tells wether the kernel allowed counting.
+         * @return True if the misses are counted.
+         */
+        bool available(void) const {
+            return this->fd >= 0;
+        }
+
+        /**
+         * @breif Sets the count to 0 and starts counting.
+         */
+        void start(void) {
+            if (this->fd < 0) return;
+            ioctl(this->fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(this->fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+
+        /**
+         * @breif Stops counting.
+         * @return The misses since start(), -1 if they can't be counted.
+         */
+        long long stop(void) {
+            if (this->fd < 0) return -1;
+            ioctl(this->fd, PERF_EVENT_IOC_DISABLE, 0);
+            long long misses = 0;
+            if (read(this->fd, &misses, sizeof(misses)) != sizeof(misses)) {
+                return -1;
+            }
+            return misses;
+        }
+};
+
+/**
+ * @breif Keeps the compiler from throwing away a value that is never used.
+ * @param value The value to keep.
+ */
+template<typename V>
+inline void keep(const V & value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+#endif
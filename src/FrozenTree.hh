@@ -0,0 +1,494 @@
+#ifndef FROZENTREE_CLASS
+#define FROZENTREE_CLASS
+
+#include <stddef.h>//This gets NULL
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "KeyCompare.hh"
+
+/**
+ * @breif Returns how many keys a block of a FrozenTree holds by default, as
+ *        many as fill a cache line, or 1 when two don't fit in one.
+ */
+template<typename Key>
+constexpr int frozenWidth(void) {
+    return 64 / sizeof(Key) >= 2? 64 / sizeof(Key): 1;
+}
+
+template<typename Key, typename T, typename Compare = std::less<Key>,
+    int Width = frozenWidth<Key>()>
+/**
+ * @breif The FrozenTree is an immutable copy of a tree laid out for lookups,
+ *        made by RBTree::freeze().
+ *
+ * The keys are in a flat array of blocks of Width keys, a (Width + 1)-ary
+ * search tree stored level by level like an Eytzinger array: the children of
+ * the block b are the blocks b * (Width + 1) + 1 to b * (Width + 1) + Width +
+ * 1. A block is searched by counting the keys below the given one, a loop
+ * with no branch that the compiler turns into vector compares for arithmetic
+ * keys, and a descent takes one cache line per level. With Width 1 this is
+ * the binary Eytzinger layout, where the blocks four levels down, which
+ * share a cache line, are prefetched while the levels between are compared.
+ *
+ * The data and the multiplicities are kept in arrays of their own in the
+ * order of the keys, so the key array holds keys only. The elements are
+ * given as a Position and walked in key order like the ones of the source
+ * tree, with the same multiplicities. Key and T must be default
+ * constructible.
+ */
+class FrozenTree : private KeyCompare<Compare>{
+    static_assert(Width >= 1, "a block needs room for a key");
+
+    public:
+        /**
+         * @breif An element of the tree, or past the last one.
+         */
+        class Position{
+            friend class FrozenTree;
+
+            private:
+                const FrozenTree * tree = NULL;
+                size_t slot = 0;
+
+                Position(const FrozenTree * tree, size_t slot) :
+                    tree(tree), slot(slot) {}
+
+            public:
+                Position(void) = default;
+
+                const Key & getKey(void) const {
+                    return this->tree->keys()[this->slot];
+                }
+                const T & getData(void) const {
+                    return this->tree->data[this->slot];
+                }
+                int getMultiplicity(void) const {
+                    return this->tree->multiplicities[this->slot];
+                }
+
+                /**
+                 * @breif Tells wether this is an element.
+                 * @return False past the ends of the tree.
+                 */
+                explicit operator bool(void) const {
+                    return this->tree != NULL;
+                }
+        };
+
+    private:
+        /**
+         * @breif The keys, with room to move the first one to where the
+         *        blocks line up with the cache lines.
+         */
+        std::vector<Key> storage;
+
+        /**
+         * @breif Where the key of slot 0 is in storage. The key i of the
+         *        block b is in the slot b * Width + i.
+         */
+        size_t shift = 0;
+
+        /**
+         * @breif The data and the multiplicities, by slot. The slots past
+         *        the last key, which fill the last block with copies of the
+         *        highest key, have multiplicity 0. The data isn't in a
+         *        vector, whose bools would be bits handed out by proxy.
+         */
+        std::unique_ptr<T[]> data;
+        std::vector<int> multiplicities;
+
+        /**
+         * @breif How many blocks there are.
+         */
+        size_t blocks = 0;
+
+        /**
+         * @breif The slots of the lowest and the highest key.
+         */
+        size_t firstSlot = 0;
+        size_t lastSlot = 0;
+
+        /**
+         * @breif How many elements there are, multiplicities included.
+         */
+        size_t count = 0;
+
+        /**
+         * @breif How many levels down the block prefetched while a block is
+         *        searched is, the most whose blocks below a block fit in a
+         *        cache line.
+         */
+        static constexpr int prefetchLevels(void) {
+            int levels = 0;
+            size_t span = Width;
+            while (span * (Width + 1) * sizeof(Key) <= 64) {
+                span *= Width + 1;
+                ++levels;
+            }
+            return levels;
+        }
+
+        /**
+         * @breif How many blocks there are prefetchLevels() levels below a
+         *        block.
+         */
+        static constexpr size_t prefetchSpan(void) {
+            size_t span = 1;
+            for (int i = 0; i < prefetchLevels(); ++i) span *= Width + 1;
+            return span;
+        }
+
+        /**
+         * @breif Returns the child i of a block, 0 to Width.
+         */
+        static size_t child(size_t block, int i) {
+            return block * (Width + 1) + i + 1;
+        }
+
+        /**
+         * @breif Returns where the keys are.
+         */
+        const Key * keys(void) const {
+            return this->storage.data() + this->shift;
+        }
+
+        /**
+         * @breif Returns the slot of the lowest key that doesn't go before
+         *        a key.
+         * @param key The key.
+         * @return The slot, blocks * Width if every key goes before.
+         */
+        size_t lowerSlot(const Key & key) const;
+
+        /**
+         * @breif Returns the Position of a slot, past the end for the slots
+         *        past the last key.
+         */
+        Position at(size_t slot) const;
+
+        /**
+         * @breif Moves the elements, in key order, to a subtree in order.
+         * @param block    The root of the subtree.
+         * @param keys     The keys.
+         * @param data     The data.
+         * @param counts   The multiplicities.
+         * @param padding  The key of the slots past the last key.
+         * @param next     The next element to move, updated.
+         */
+        void place(size_t block, std::vector<Key> & keys,
+            std::vector<T> & data, const std::vector<int> & counts,
+            const Key & padding, size_t * next);
+
+    public:
+        /**
+         * @breif Creates an empty tree.
+         * @param compare The comparator of the keys.
+         */
+        explicit FrozenTree(const Compare & compare = Compare());
+
+        /**
+         * @breif Creates a tree of elements sorted by key, with no two of
+         *        the same key, in O(n).
+         * @param keys           The keys.
+         * @param data           The data.
+         * @param multiplicities The multiplicities, all above 0.
+         * @param compare        The comparator of the keys.
+         */
+        FrozenTree(std::vector<Key> keys, std::vector<T> data,
+            const std::vector<int> & multiplicities,
+            const Compare & compare = Compare());
+
+        FrozenTree(FrozenTree && other);
+        FrozenTree & operator=(FrozenTree && other);
+        FrozenTree(const FrozenTree & other) = delete;
+        FrozenTree & operator=(const FrozenTree & other) = delete;
+
+        /**
+         * @breif Returns the multiplicity of a key.
+         * @param key The key to search for.
+         * @return The multiplicity, 0 if the key is not in the tree.
+         */
+        int exists(const Key & key) const;
+
+        /**
+         * @breif Finds the element of a key.
+         * @param key The key to search for.
+         * @return The element, past the end if the key is not in the tree.
+         */
+        Position find(const Key & key) const;
+
+        /**
+         * @breif Finds the element with the lowest key that doesn't go
+         *        before a key.
+         * @param key The key.
+         * @return The element, past the end if every key goes before.
+         */
+        Position lower_bound(const Key & key) const;
+
+        /**
+         * @breif Returns how many elements there are, multiplicities
+         *        included.
+         * @return The number of elements.
+         */
+        size_t size(void) const;
+
+        /**
+         * @breif Returns the element with the lowest key, in O(1).
+         * @return The element, past the end if the tree is empty.
+         */
+        Position first(void) const;
+
+        /**
+         * @breif Returns the element with the highest key, in O(1).
+         * @return The element, past the end if the tree is empty.
+         */
+        Position last(void) const;
+
+        /**
+         * @breif Returns the element that follows another one in key order,
+         *        in amortized O(1).
+         * @param position The element.
+         * @return The next element, past the end after the last one.
+         */
+        Position next(Position position) const;
+
+        /**
+         * @breif Returns the element that goes before another one in key
+         *        order, in amortized O(1).
+         * @param position The element.
+         * @return The previous element, past the end before the first one.
+         */
+        Position previous(Position position) const;
+};
+
+/******************************************************************************
+ *                                                                           **
+ * CLASS IMPLEMENTATION                                                      **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare, int Width>
+FrozenTree<Key, T, Compare, Width>::FrozenTree(const Compare & compare) :
+    KeyCompare<Compare>(compare) {}
+
+template<typename Key, typename T, typename Compare, int Width>
+FrozenTree<Key, T, Compare, Width>::FrozenTree(std::vector<Key> keys,
+    std::vector<T> data, const std::vector<int> & multiplicities,
+    const Compare & compare) : KeyCompare<Compare>(compare) {
+    size_t elements = keys.size();
+    if (elements == 0) {
+        return;
+    }
+    this->blocks = (elements + Width - 1) / Width;
+    size_t slots = this->blocks * Width;
+
+    // With Width 1 the blocks below a block start one slot before a cache
+    // line, so the slot -1 is the one put at the start of a line.
+    const size_t line = 64 % sizeof(Key) == 0? 64 / sizeof(Key): 1;
+    const size_t lead = Width == 1? 1: 0;
+    this->storage.resize(slots + line + lead);
+    size_t gap = (64 - (uintptr_t) this->storage.data() % 64) % 64;
+    size_t skip = gap % sizeof(Key) == 0? gap / sizeof(Key): lead;
+    this->shift = lead + (skip + line - lead % line) % line;
+    this->data.reset(new T[slots]);
+    this->multiplicities.assign(slots, 0);
+
+    Key padding = keys[elements - 1];
+    size_t next = 0;
+    this->place(0, keys, data, multiplicities, padding, &next);
+    for (size_t i = 0; i < elements; ++i) {
+        this->count += multiplicities[i];
+    }
+}
+
+template<typename Key, typename T, typename Compare, int Width>
+FrozenTree<Key, T, Compare, Width>::FrozenTree(FrozenTree && other) :
+    KeyCompare<Compare>(other.getCompare()) {
+    *this = std::move(other);
+}
+
+template<typename Key, typename T, typename Compare, int Width>
+FrozenTree<Key, T, Compare, Width> &
+FrozenTree<Key, T, Compare, Width>::operator=(FrozenTree && other) {
+    if (this != &other) {
+        static_cast<KeyCompare<Compare> &>(*this) = other;
+        this->storage = std::move(other.storage);
+        this->data = std::move(other.data);
+        this->multiplicities = std::move(other.multiplicities);
+        this->shift = std::exchange(other.shift, 0);
+        this->blocks = std::exchange(other.blocks, 0);
+        this->firstSlot = std::exchange(other.firstSlot, 0);
+        this->lastSlot = std::exchange(other.lastSlot, 0);
+        this->count = std::exchange(other.count, 0);
+    }
+    return *this;
+}
+
+template<typename Key, typename T, typename Compare, int Width>
+void FrozenTree<Key, T, Compare, Width>::place(size_t block,
+    std::vector<Key> & keys, std::vector<T> & data,
+    const std::vector<int> & counts, const Key & padding, size_t * next) {
+    if (block >= this->blocks) {
+        return;
+    }
+    Key * line = this->storage.data() + this->shift;
+    for (int i = 0; i < Width; ++i) {
+        this->place(child(block, i), keys, data, counts, padding, next);
+        size_t slot = block * Width + i;
+        if (*next < keys.size()) {
+            line[slot] = std::move(keys[*next]);
+            this->data[slot] = std::move(data[*next]);
+            this->multiplicities[slot] = counts[*next];
+            if (*next == 0) this->firstSlot = slot;
+            if (*next + 1 == keys.size()) this->lastSlot = slot;
+        } else {
+            line[slot] = padding;
+        }
+        ++*next;
+    }
+    this->place(child(block, Width), keys, data, counts, padding, next);
+}
+
+/******************************************************************************
+ *                                                                           **
+ * LOOKUP                                                                    **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare, int Width>
+size_t FrozenTree<Key, T, Compare, Width>::lowerSlot(const Key & key)
+    const {
+    const Key * keys = this->keys();
+    size_t found = this->blocks * Width;
+    size_t block = 0;
+    while (block < this->blocks) {
+        if (prefetchLevels() > 0) {
+            // The first block that many levels down, the ones after it are
+            // in the same cache line.
+            __builtin_prefetch(keys + (block * prefetchSpan() +
+                (prefetchSpan() - 1) / Width) * Width);
+        }
+        const Key * line = keys + block * Width;
+        int below = 0;
+        for (int i = 0; i < Width; ++i) {
+            below += this->less(line[i], key);
+        }
+        // The keys below the child go before the one found here, so a key
+        // found further down takes its place.
+        found = below < Width? block * Width + below: found;
+        block = child(block, below);
+    }
+    return found;
+}
+
+template<typename Key, typename T, typename Compare, int Width>
+typename FrozenTree<Key, T, Compare, Width>::Position
+FrozenTree<Key, T, Compare, Width>::at(size_t slot) const {
+    if (slot >= this->blocks * Width || this->multiplicities[slot] == 0) {
+        return Position();
+    }
+    return Position(this, slot);
+}
+
+template<typename Key, typename T, typename Compare, int Width>
+int FrozenTree<Key, T, Compare, Width>::exists(const Key & key) const {
+    Position position = this->find(key);
+    return position? position.getMultiplicity(): 0;
+}
+
+template<typename Key, typename T, typename Compare, int Width>
+typename FrozenTree<Key, T, Compare, Width>::Position
+FrozenTree<Key, T, Compare, Width>::find(const Key & key) const {
+    Position position = this->lower_bound(key);
+    if (position && this->less(key, position.getKey())) {
+        return Position();
+    }
+    return position;
+}
+
+template<typename Key, typename T, typename Compare, int Width>
+typename FrozenTree<Key, T, Compare, Width>::Position
+FrozenTree<Key, T, Compare, Width>::lower_bound(const Key & key) const {
+    return this->at(this->lowerSlot(key));
+}
+
+template<typename Key, typename T, typename Compare, int Width>
+size_t FrozenTree<Key, T, Compare, Width>::size(void) const {
+    return this->count;
+}
+
+/******************************************************************************
+ *                                                                           **
+ * TRAVERSAL                                                                 **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare, int Width>
+typename FrozenTree<Key, T, Compare, Width>::Position
+FrozenTree<Key, T, Compare, Width>::first(void) const {
+    return this->blocks == 0? Position(): Position(this, this->firstSlot);
+}
+
+template<typename Key, typename T, typename Compare, int Width>
+typename FrozenTree<Key, T, Compare, Width>::Position
+FrozenTree<Key, T, Compare, Width>::last(void) const {
+    return this->blocks == 0? Position(): Position(this, this->lastSlot);
+}
+
+template<typename Key, typename T, typename Compare, int Width>
+typename FrozenTree<Key, T, Compare, Width>::Position
+FrozenTree<Key, T, Compare, Width>::next(Position position) const {
+    size_t block = position.slot / Width;
+    int i = position.slot % Width;
+    size_t below = child(block, i + 1);
+    if (below < this->blocks) {
+        while (child(below, 0) < this->blocks) {
+            below = child(below, 0);
+        }
+        return this->at(below * Width);
+    }
+    if (i + 1 < Width) {
+        return this->at(position.slot + 1);
+    }
+    // The last key of a block whose last child is missing, the next one is
+    // in the first block up that this one isn't under the last child of.
+    while (block > 0) {
+        size_t parent = (block - 1) / (Width + 1);
+        int j = (block - 1) % (Width + 1);
+        if (j < Width) {
+            return this->at(parent * Width + j);
+        }
+        block = parent;
+    }
+    return Position();
+}
+
+template<typename Key, typename T, typename Compare, int Width>
+typename FrozenTree<Key, T, Compare, Width>::Position
+FrozenTree<Key, T, Compare, Width>::previous(Position position) const {
+    size_t block = position.slot / Width;
+    int i = position.slot % Width;
+    size_t below = child(block, i);
+    if (below < this->blocks) {
+        while (child(below, Width) < this->blocks) {
+            below = child(below, Width);
+        }
+        return this->at(below * Width + Width - 1);
+    }
+    if (i > 0) {
+        return this->at(position.slot - 1);
+    }
+    while (block > 0) {
+        size_t parent = (block - 1) / (Width + 1);
+        int j = (block - 1) % (Width + 1);
+        if (j > 0) {
+            return this->at(parent * Width + j - 1);
+        }
+        block = parent;
+    }
+    return Position();
+}
+#endif
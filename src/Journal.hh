@@ -0,0 +1,458 @@
+#ifndef JOURNAL_CLASS
+#define JOURNAL_CLASS
+
+#include <stddef.h>//This gets NULL
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "SyncPolicy.hh"
+#include "TreeSnapshot.hh"
+
+/**
+ * @breif The first bytes of a journal, "RBTJ" when read in the byte order it
+ *        was written in.
+ */
+const uint32_t JOURNAL_MAGIC = 0x4a544252;
+
+/**
+ * @breif The version of the journal format, a file of another one isn't
+ *        read.
+ */
+const uint32_t JOURNAL_VERSION = 1;
+
+/**
+ * @breif The header a journal starts with.
+ */
+struct JournalHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t keySize;///sizeof the key of the tree.
+    uint32_t dataSize;///sizeof the data of the tree.
+    uint64_t base;///The checksum of the snapshot the records follow, 0 if none.
+    uint64_t sum;///The checksum of the fields above.
+};
+
+/**
+ * @breif Flushes a directory to the disk, so the files renamed into it stay
+ *        renamed after a crash.
+ * @param path The path of a file in the directory.
+ * @return False if the directory couldn't be flushed.
+ */
+inline bool syncDirectory(const char * path);
+
+/**
+ * @breif The JournalWriter appends records to a journal file.
+ *
+ * A record is framed by its length and its checksum, so a record torn by a
+ * crash is told from a whole one. The records are gathered in a buffer and
+ * written, and flushed to the disk, as the SyncPolicies say: one by one, in
+ * groups of a given number of records, which is a group commit, or never,
+ * leaving it to the system.
+ */
+class JournalWriter{
+    private:
+        int file = -1;
+        std::vector<char> buffer;
+        size_t start = 0;
+        size_t pending = 0;
+        uint64_t written = 0;
+        size_t syncs = 0;
+        SyncPolicies policy = SYNC_GROUP;
+        size_t group = 64;
+        bool failed = false;
+
+        /**
+         * @breif Writes the buffer to the file, without flushing it to the
+         *        disk.
+         * @return False if the file couldn't be written.
+         */
+        bool flush(void);
+
+    public:
+        /**
+         * @breif How many bytes the frame of a record takes, its length and
+         *        its checksum.
+         */
+        static const size_t frameSize = sizeof(uint32_t) + sizeof(uint64_t);
+
+        JournalWriter(void) = default;
+        JournalWriter(const JournalWriter & other) = delete;
+        JournalWriter & operator=(const JournalWriter & other) = delete;
+
+        /**
+         * @breif Commits the records left and closes the file.
+         */
+        ~JournalWriter(void);
+
+        /**
+         * @breif Sets when the records are flushed to the disk.
+         * @param policy The policy.
+         * @param group  How many records a group has, for SYNC_GROUP.
+         */
+        void setPolicy(SyncPolicies policy, size_t group);
+
+        /**
+         * @breif Starts a new journal, written aside and renamed over the
+         *        path, the one it replaces stays whole until then.
+         * @param path     The path of the journal.
+         * @param keySize  The sizeof the key of the tree.
+         * @param dataSize The sizeof the data of the tree.
+         * @param base     The checksum of the snapshot the records follow.
+         * @return False if the journal couldn't be written.
+         */
+        bool create(const char * path, uint32_t keySize, uint32_t dataSize,
+            uint64_t base);
+
+        /**
+         * @breif Opens a journal to append records to it. The file is cut
+         *        where the last whole record ends, a torn one is dropped.
+         * @param path The path of the journal.
+         * @param end  Where the last whole record ends, see
+         *             JournalReader::end().
+         * @return False if the journal couldn't be opened.
+         */
+        bool append(const char * path, uint64_t end);
+
+        /**
+         * @breif Tells if everything went well so far.
+         * @return False if the journal isn't open or couldn't be written.
+         */
+        bool good(void) const;
+
+        /**
+         * @breif Starts a record.
+         * @param operation What the record does, its first byte.
+         */
+        void begin(uint8_t operation);
+
+        /**
+         * @breif Adds bytes to the record.
+         * @param bytes The bytes.
+         * @param size  How many bytes.
+         */
+        void write(const void * bytes, size_t size);
+
+        /**
+         * @breif Ends the record, which is committed if the policy says so.
+         * @return False if the journal failed, now or before, so the record
+         *         may not be in it.
+         */
+        bool end(void);
+
+        /**
+         * @breif Drops the record, as if begin() wasn't called.
+         */
+        void cancel(void);
+
+        /**
+         * @breif Writes the records and flushes them to the disk, unless the
+         *        policy is SYNC_NEVER. A record is only sure to survive a
+         *        crash once it's committed.
+         * @return False if the journal couldn't be written.
+         */
+        bool commit(void);
+
+        /**
+         * @breif Commits the records and closes the file.
+         * @return False if the journal couldn't be written.
+         */
+        bool close(void);
+
+        /**
+         * @breif Returns how long the journal is, with the records not
+         *        written yet.
+         * @return The number of bytes.
+         */
+        uint64_t size(void) const;
+
+        /**
+         * @breif Returns how many times the journal was flushed to the disk.
+         * @return The number of flushes.
+         */
+        size_t getSyncs(void) const;
+};
+
+/**
+ * @breif The JournalReader reads the records of a journal one by one, up to
+ *        the first one that is torn or doesn't match its checksum.
+ */
+class JournalReader{
+    private:
+        FILE * file;
+        JournalHeader header;
+        std::vector<char> record;
+        size_t used = 0;
+        uint64_t offset = 0;
+        uint64_t length = 0;
+        bool failed = false;
+
+    public:
+        /**
+         * @breif Opens a journal and reads its header.
+         * @param path The path of the journal.
+         */
+        explicit JournalReader(const char * path);
+
+        JournalReader(const JournalReader & other) = delete;
+        JournalReader & operator=(const JournalReader & other) = delete;
+
+        /**
+         * @breif Closes the file.
+         */
+        ~JournalReader(void);
+
+        /**
+         * @breif Tells if the journal could be opened and has a whole header
+         *        of this version.
+         * @return True if the records can be read.
+         */
+        bool good(void) const;
+
+        /**
+         * @breif Returns the header of the journal.
+         * @return The header.
+         */
+        const JournalHeader & getHeader(void) const;
+
+        /**
+         * @breif Moves to the next record.
+         * @param operation Where the first byte of the record is written.
+         * @return False if there are no more whole records.
+         */
+        bool next(uint8_t * operation);
+
+        /**
+         * @breif Reads bytes of the current record.
+         * @param bytes Where the bytes are copied.
+         * @param size  How many bytes.
+         * @return False if the record ends before.
+         */
+        bool read(void * bytes, size_t size);
+
+        /**
+         * @breif Returns how many bytes of the current record are left.
+         * @return The number of bytes.
+         */
+        uint64_t remaining(void) const;
+
+        /**
+         * @breif Returns where the last whole record read ends.
+         * @return The offset in the file.
+         */
+        uint64_t end(void) const;
+};
+
+/******************************************************************************
+ *                                                                           **
+ * CLASS IMPLEMENTATION                                                      **
+ *                                                                           **
+ ******************************************************************************/
+
+inline bool syncDirectory(const char * path) {
+    std::string directory(path);
+    size_t slash = directory.rfind('/');
+    directory = slash == std::string::npos? ".": directory.substr(0,
+        slash == 0? 1: slash);
+    int handle = open(directory.c_str(), O_RDONLY);
+    if (handle < 0) {
+        return false;
+    }
+    bool synced = fsync(handle) == 0;
+    ::close(handle);
+    return synced;
+}
+
+inline JournalWriter::~JournalWriter(void) {
+    this->close();
+}
+
+inline void JournalWriter::setPolicy(SyncPolicies policy, size_t group) {
+    this->policy = policy;
+    this->group = group == 0? 1: group;
+}
+
+inline bool JournalWriter::create(const char * path, uint32_t keySize,
+    uint32_t dataSize, uint64_t base) {
+    this->close();
+    std::string aside = std::string(path) + ".tmp";
+    JournalHeader header = {JOURNAL_MAGIC, JOURNAL_VERSION, keySize, dataSize,
+        base, 0};
+    header.sum = snapshotChecksum(0, reinterpret_cast<const char *>(&header),
+        offsetof(JournalHeader, sum));
+    this->file = open(aside.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    this->failed = this->file < 0 ||
+        ::write(this->file, &header, sizeof(header)) != sizeof(header) ||
+        fdatasync(this->file) != 0 || rename(aside.c_str(), path) != 0 ||
+        !syncDirectory(path);
+    if (this->failed) {
+        remove(aside.c_str());
+    }
+    this->written = sizeof(header);
+    return !this->failed;
+}
+
+inline bool JournalWriter::append(const char * path, uint64_t end) {
+    this->close();
+    this->file = open(path, O_WRONLY);
+    this->failed = this->file < 0 || ftruncate(this->file, end) != 0 ||
+        lseek(this->file, end, SEEK_SET) != (off_t) end;
+    this->written = end;
+    return !this->failed;
+}
+
+inline bool JournalWriter::good(void) const {
+    return this->file >= 0 && !this->failed;
+}
+
+inline void JournalWriter::begin(uint8_t operation) {
+    this->start = this->buffer.size();
+    this->buffer.resize(this->start + frameSize);
+    this->buffer.push_back(operation);
+}
+
+inline void JournalWriter::write(const void * bytes, size_t size) {
+    const char * from = static_cast<const char *>(bytes);
+    this->buffer.insert(this->buffer.end(), from, from + size);
+}
+
+inline bool JournalWriter::end(void) {
+    uint32_t length = this->buffer.size() - this->start - frameSize;
+    uint64_t sum = snapshotChecksum(0, &this->buffer[this->start + frameSize],
+        length);
+    memcpy(&this->buffer[this->start], &length, sizeof(length));
+    memcpy(&this->buffer[this->start + sizeof(length)], &sum, sizeof(sum));
+    ++this->pending;
+    if (this->policy == SYNC_ALWAYS ||
+        (this->policy == SYNC_GROUP && this->pending >= this->group)) {
+        return this->commit();
+    } else if (this->buffer.size() >= SnapshotWriter::bufferSize) {
+        return this->flush();
+    }
+    return this->good();
+}
+
+inline void JournalWriter::cancel(void) {
+    this->buffer.resize(this->start);
+}
+
+inline bool JournalWriter::flush(void) {
+    if (!this->good()) {
+        this->buffer.clear();
+        return false;
+    }
+    size_t done = 0;
+    while (done < this->buffer.size()) {
+        ssize_t piece = ::write(this->file, &this->buffer[done],
+            this->buffer.size() - done);
+        if (piece <= 0) {
+            this->failed = true;
+            break;
+        }
+        done += piece;
+    }
+    this->written += done;
+    this->buffer.clear();
+    return !this->failed;
+}
+
+inline bool JournalWriter::commit(void) {
+    if (!this->flush()) {
+        return false;
+    }
+    if (this->policy != SYNC_NEVER && this->pending > 0) {
+        if (fdatasync(this->file) != 0) {
+            this->failed = true;
+        }
+        ++this->syncs;
+    }
+    this->pending = 0;
+    return !this->failed;
+}
+
+inline bool JournalWriter::close(void) {
+    if (this->file < 0) {
+        return false;
+    }
+    bool committed = this->commit();
+    ::close(this->file);
+    this->file = -1;
+    return committed;
+}
+
+inline uint64_t JournalWriter::size(void) const {
+    return this->written + this->buffer.size();
+}
+
+inline size_t JournalWriter::getSyncs(void) const {
+    return this->syncs;
+}
+
+inline JournalReader::JournalReader(const char * path) {
+    this->file = fopen(path, "rb");
+    this->failed = this->file == NULL ||
+        fread(&this->header, sizeof(this->header), 1, this->file) != 1 ||
+        this->header.magic != JOURNAL_MAGIC ||
+        this->header.version != JOURNAL_VERSION ||
+        this->header.sum != snapshotChecksum(0,
+            reinterpret_cast<const char *>(&this->header),
+            offsetof(JournalHeader, sum));
+    if (!this->failed && fseek(this->file, 0, SEEK_END) == 0) {
+        this->length = ftell(this->file);
+        fseek(this->file, sizeof(this->header), SEEK_SET);
+    }
+    this->offset = sizeof(this->header);
+}
+
+inline JournalReader::~JournalReader(void) {
+    if (this->file != NULL) fclose(this->file);
+}
+
+inline bool JournalReader::good(void) const {
+    return !this->failed;
+}
+
+inline const JournalHeader & JournalReader::getHeader(void) const {
+    return this->header;
+}
+
+inline bool JournalReader::next(uint8_t * operation) {
+    uint32_t size;
+    uint64_t sum;
+    if (this->failed || fread(&size, sizeof(size), 1, this->file) != 1 ||
+        fread(&sum, sizeof(sum), 1, this->file) != 1 || size == 0 ||
+        size > this->length - this->offset - JournalWriter::frameSize) {
+        return false;
+    }
+    this->record.resize(size);
+    if (fread(&this->record[0], 1, size, this->file) != size ||
+        snapshotChecksum(0, &this->record[0], size) != sum) {
+        return false;
+    }
+    this->offset += JournalWriter::frameSize + size;
+    *operation = this->record[0];
+    this->used = 1;
+    return true;
+}
+
+inline bool JournalReader::read(void * bytes, size_t size) {
+    if (size > this->remaining()) {
+        return false;
+    }
+    memcpy(bytes, this->record.data() + this->used, size);
+    this->used += size;
+    return true;
+}
+
+inline uint64_t JournalReader::remaining(void) const {
+    return this->record.size() - this->used;
+}
+
+inline uint64_t JournalReader::end(void) const {
+    return this->offset;
+}
+
+#endif
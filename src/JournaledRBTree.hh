@@ -0,0 +1,470 @@
+#ifndef JOURNALEDRBTREE_CLASS
+#define JOURNALEDRBTREE_CLASS
+
+#include <stddef.h>//This gets NULL
+#include <stdint.h>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#include "Journal.hh"
+#include "RBTree.hh"
+
+template<typename Key, typename T, typename Compare = std::less<Key>,
+    typename Alloc = NodePool<Node<Key, T> >,
+    typename Serializer = RawSerializer>
+/**
+ * @breif The JournaledRBTree is a RBTree whose changes survive a crash. Every
+ *        change is appended to a journal, see JournalWriter, and the journal
+ *        is folded into a snapshot of the tree from time to time, see
+ *        RBTree::save().
+ *
+ * open() recovers the tree: it loads the snapshot and replays the records of
+ * the journal that follow it. The journal remembers the checksum of the
+ * snapshot it follows, so after a crash between writing a snapshot and
+ * starting its journal the old journal, whose records are in the snapshot
+ * already, is not replayed again.
+ *
+ * Replaying a record does what the call did the first time, the tree being
+ * the same, so the records only hold the arguments: the key and data of an
+ * insertion, the key of an extraction, the records of a batch. A record is
+ * written before the tree changes. Insertions and extractions that change
+ * nothing leave no record, a batch is always recorded.
+ *
+ * Once the journal fails to be written or flushed, the tree is no longer sure
+ * to match what a recovery would give, so every change is refused until
+ * open() recovers the tree from what reached the disk.
+ */
+class JournaledRBTree{
+    private:
+        /**
+         * @breif What a record of the journal does.
+         */
+        enum Operation : uint8_t {
+            INSERT = 1,///An insertion, with its key and data.
+            EXTRACT = 2,///An extraction, with its key.
+            BATCH = 3///A batch insertion, with its records.
+        };
+
+        /**
+         * @breif The tree.
+         */
+        RBTree<Key, T, Compare, Alloc> tree;
+
+        /**
+         * @breif Writes the keys and the data to the journal and the
+         *        snapshots.
+         */
+        Serializer serializer;
+
+        /**
+         * @breif The journal the changes are appended to.
+         */
+        JournalWriter journal;
+
+        /**
+         * @breif The path of the snapshot.
+         */
+        std::string snapshotPath;
+
+        /**
+         * @breif The path of the journal.
+         */
+        std::string journalPath;
+
+        /**
+         * @breif How long the journal may grow before it's compacted, 0 for
+         *        never.
+         */
+        uint64_t compactBytes = 0;
+
+        /**
+         * @breif Replays the records of a journal on the tree.
+         * @param in The journal.
+         * @return False if a whole record can't be read.
+         */
+        bool replay(JournalReader & in);
+
+        /**
+         * @breif Compacts the journal if it's longer than compactBytes.
+         */
+        void compactIfLong(void);
+
+        /**
+         * @breif Returns the multiplicity of a record of a batch, which is
+         *        its third field.
+         */
+        template<typename R>
+        static int32_t recordMultiplicity(const R & record, std::true_type);
+
+        /**
+         * @breif Returns the multiplicity of a record with no third field,
+         *        which is 1.
+         */
+        template<typename R>
+        static int32_t recordMultiplicity(const R & record, std::false_type);
+
+    public:
+        /**
+         * @breif Creates an empty tree with no journal, see open(). Until a
+         *        journal is opened every change is refused.
+         * @param compare    The comparator of the keys.
+         * @param serializer Writes the keys and the data, see RawSerializer.
+         */
+        explicit JournaledRBTree(const Compare & compare = Compare(),
+            const Serializer & serializer = Serializer());
+
+        JournaledRBTree(const JournaledRBTree & other) = delete;
+        JournaledRBTree & operator=(const JournaledRBTree & other) = delete;
+
+        /**
+         * @breif Recovers the tree from a snapshot and a journal and keeps
+         *        appending to the journal. A missing snapshot is an empty
+         *        tree, a missing journal is started. A record torn by a crash
+         *        ends the journal and is cut off.
+         * @param snapshotPath The path of the snapshot.
+         * @param journalPath  The path of the journal.
+         * @param policy       When the records are flushed to the disk.
+         * @param group        How many records are flushed at once, for
+         *                     SYNC_GROUP. A group that doesn't fill waits
+         *                     for commit(), see SyncPolicies.
+         * @return False, and the tree left empty, if the snapshot or the
+         *         journal are there but can't be read, or aren't of a tree
+         *         of these types.
+         */
+        bool open(const char * snapshotPath, const char * journalPath,
+            SyncPolicies policy = SYNC_GROUP, size_t group = 64);
+
+        /**
+         * @breif Sets how long the journal may grow before it's compacted on
+         *        its own, see compact().
+         * @param bytes The length in bytes, 0 for never.
+         */
+        void setCompactBytes(uint64_t bytes);
+
+        /**
+         * @breif Inserts a key-data pair, see RBTree::insert().
+         * @param key  The key value to insert.
+         * @param data The data to insert.
+         * @return True if the data was inserted. False, and the tree left
+         *         as it was, if the key is there with other data or the
+         *         journal failed.
+         */
+        bool insert(const Key & key, const T & data);
+
+        /**
+         * @breif Inserts a batch of records, see RBTree::insert_batch(). The
+         *        whole batch is one record of the journal.
+         * @param first The first record, a forward iterator.
+         * @param last  Past the last record.
+         * @return How many elements were inserted, multiplicities included,
+         *         0 and the tree left as it was if the journal failed.
+         */
+        template<typename Iterator>
+        size_t insert_batch(Iterator first, Iterator last);
+
+        /**
+         * @breif Extracts an element, see RBTree::extract().
+         * @param key The key to extract.
+         * @return The extracted data, a default constructed one, and the
+         *         tree left as it was, if the key is not in the tree or the
+         *         journal failed.
+         */
+        T extract(const Key & key);
+
+        /**
+         * @breif Returns the multiplicity of a key.
+         * @param key The key to search for.
+         * @return The multiplicity, 0 if the key is not in the tree.
+         */
+        int exists(const Key & key);
+
+        /**
+         * @breif Returns how many elements there are, multiplicities
+         *        included.
+         * @return The number of elements.
+         */
+        size_t size(void);
+
+        /**
+         * @breif Returns the tree, to read it. Changes made through it are
+         *        not journaled.
+         * @return The tree.
+         */
+        RBTree<Key, T, Compare, Alloc> & getTree(void);
+
+        /**
+         * @breif Returns the journal.
+         * @return The journal.
+         */
+        const JournalWriter & getJournal(void) const;
+
+        /**
+         * @breif Flushes the records to the disk, see JournalWriter::commit().
+         * @return False if the journal couldn't be written.
+         */
+        bool commit(void);
+
+        /**
+         * @breif Writes a snapshot of the tree and starts an empty journal
+         *        that follows it. A crash at any point leaves a snapshot and
+         *        a journal that recover the tree.
+         * @return False if the snapshot or the journal couldn't be written.
+         */
+        bool compact(void);
+};
+
+/******************************************************************************
+ *                                                                           **
+ * CLASS IMPLEMENTATION                                                      **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare, typename Alloc,
+    typename Serializer>
+JournaledRBTree<Key, T, Compare, Alloc, Serializer>::JournaledRBTree(
+    const Compare & compare, const Serializer & serializer) :
+    tree(compare), serializer(serializer) {}
+
+template<typename Key, typename T, typename Compare, typename Alloc,
+    typename Serializer>
+bool JournaledRBTree<Key, T, Compare, Alloc, Serializer>::open(
+    const char * snapshotPath, const char * journalPath, SyncPolicies policy,
+    size_t group) {
+    this->journal.close();
+    this->tree.clear();
+    this->snapshotPath = snapshotPath;
+    this->journalPath = journalPath;
+    this->journal.setPolicy(policy, group);
+
+    uint64_t base = 0;
+    if (access(snapshotPath, F_OK) == 0 &&
+        (!this->tree.load(snapshotPath, this->serializer) ||
+        !snapshotChecksumOf(snapshotPath, &base))) {
+        return false;
+    }
+    if (access(journalPath, F_OK) != 0) {
+        return this->journal.create(journalPath, sizeof(Key), sizeof(T), base);
+    }
+
+    JournalReader in(journalPath);
+    if (!in.good() || in.getHeader().keySize != sizeof(Key) ||
+        in.getHeader().dataSize != sizeof(T)) {
+        this->tree.clear();
+        return false;
+    }
+    if (in.getHeader().base != base) {
+        // The snapshot was written after this journal was committed, its
+        // records are in the snapshot.
+        return this->journal.create(journalPath, sizeof(Key), sizeof(T), base);
+    }
+    if (!this->replay(in)) {
+        this->tree.clear();
+        return false;
+    }
+    return this->journal.append(journalPath, in.end());
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc,
+    typename Serializer>
+bool JournaledRBTree<Key, T, Compare, Alloc, Serializer>::replay(
+    JournalReader & in) {
+    uint8_t operation;
+    while (in.next(&operation)) {
+        Key key;
+        T data;
+        if (operation == INSERT) {
+            if (!this->serializer.read(in, key) ||
+                !this->serializer.read(in, data)) {
+                return false;
+            }
+            this->tree.insert(key, std::move(data));
+        } else if (operation == EXTRACT) {
+            if (!this->serializer.read(in, key)) {
+                return false;
+            }
+            this->tree.extract(key);
+        } else if (operation == BATCH) {
+            uint32_t records;
+            if (!in.read(&records, sizeof(records)) ||
+                records > in.remaining()) {
+                return false;
+            }
+            std::vector<std::tuple<Key, T, int> > batch(records);
+            for (uint32_t i = 0; i < records; ++i) {
+                int32_t multiplicity;
+                if (!this->serializer.read(in, std::get<0>(batch[i])) ||
+                    !this->serializer.read(in, std::get<1>(batch[i])) ||
+                    !in.read(&multiplicity, sizeof(multiplicity))) {
+                    return false;
+                }
+                std::get<2>(batch[i]) = multiplicity;
+            }
+            this->tree.insert_batch(batch.begin(), batch.end());
+        } else {
+            return false;
+        }
+        if (in.remaining() != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc,
+    typename Serializer>
+void JournaledRBTree<Key, T, Compare, Alloc, Serializer>::setCompactBytes(
+    uint64_t bytes) {
+    this->compactBytes = bytes;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc,
+    typename Serializer>
+void JournaledRBTree<Key, T, Compare, Alloc, Serializer>::compactIfLong(void) {
+    if (this->compactBytes != 0 && this->journal.size() > this->compactBytes) {
+        this->compact();
+    }
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc,
+    typename Serializer>
+bool JournaledRBTree<Key, T, Compare, Alloc, Serializer>::insert(
+    const Key & key, const T & data) {
+    if (!this->journal.good()) {
+        return false;
+    }
+    // A key with other data is rejected without a record.
+    Node<Key, T> * node = this->tree.find(key);
+    if (node != NULL && !(node->getData() == data)) {
+        return false;
+    }
+    this->journal.begin(INSERT);
+    this->serializer.write(this->journal, key);
+    this->serializer.write(this->journal, data);
+    if (!this->journal.end()) {
+        return false;
+    }
+    if (node != NULL) {
+        this->tree.insert(node, key, data);
+    } else {
+        this->tree.insert(key, data);
+    }
+    this->compactIfLong();
+    return true;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc,
+    typename Serializer>
+template<typename Iterator>
+size_t JournaledRBTree<Key, T, Compare, Alloc, Serializer>::insert_batch(
+    Iterator first, Iterator last) {
+    typedef typename std::decay<decltype(*first)>::type Record;
+    typedef std::integral_constant<bool,
+        (std::tuple_size<Record>::value > 2)> HasMultiplicity;
+
+    if (!this->journal.good()) {
+        return 0;
+    }
+    uint32_t records = std::distance(first, last);
+    this->journal.begin(BATCH);
+    this->journal.write(&records, sizeof(records));
+    for (Iterator record = first; record != last; ++record) {
+        int32_t multiplicity = recordMultiplicity(*record, HasMultiplicity());
+        this->serializer.write(this->journal, std::get<0>(*record));
+        this->serializer.write(this->journal, std::get<1>(*record));
+        this->journal.write(&multiplicity, sizeof(multiplicity));
+    }
+    if (!this->journal.end()) {
+        return 0;
+    }
+    size_t inserted = this->tree.insert_batch(first, last);
+    this->compactIfLong();
+    return inserted;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc,
+    typename Serializer>
+T JournaledRBTree<Key, T, Compare, Alloc, Serializer>::extract(
+    const Key & key) {
+    Node<Key, T> * node = this->tree.find(key);
+    if (node == NULL || !this->journal.good()) {
+        return T();
+    }
+    this->journal.begin(EXTRACT);
+    this->serializer.write(this->journal, key);
+    if (!this->journal.end()) {
+        return T();
+    }
+    T data = this->tree.extract(node);
+    this->compactIfLong();
+    return data;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc,
+    typename Serializer>
+int JournaledRBTree<Key, T, Compare, Alloc, Serializer>::exists(
+    const Key & key) {
+    return this->tree.exists(key);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc,
+    typename Serializer>
+size_t JournaledRBTree<Key, T, Compare, Alloc, Serializer>::size(void) {
+    return this->tree.size();
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc,
+    typename Serializer>
+RBTree<Key, T, Compare, Alloc> &
+JournaledRBTree<Key, T, Compare, Alloc, Serializer>::getTree(void) {
+    return this->tree;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc,
+    typename Serializer>
+const JournalWriter &
+JournaledRBTree<Key, T, Compare, Alloc, Serializer>::getJournal(void) const {
+    return this->journal;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc,
+    typename Serializer>
+bool JournaledRBTree<Key, T, Compare, Alloc, Serializer>::commit(void) {
+    return this->journal.commit();
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc,
+    typename Serializer>
+bool JournaledRBTree<Key, T, Compare, Alloc, Serializer>::compact(void) {
+    // The records go first, so the snapshot holds everything the journal
+    // held by the time it's replaced.
+    uint64_t base;
+    if (!this->journal.commit() ||
+        !this->tree.save(this->snapshotPath.c_str(), this->serializer) ||
+        !snapshotChecksumOf(this->snapshotPath.c_str(), &base) ||
+        !syncDirectory(this->snapshotPath.c_str())) {
+        return false;
+    }
+    return this->journal.create(this->journalPath.c_str(), sizeof(Key),
+        sizeof(T), base);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc,
+    typename Serializer>
+template<typename R>
+int32_t JournaledRBTree<Key, T, Compare, Alloc, Serializer>::recordMultiplicity(
+    const R & record, std::true_type) {
+    return std::get<2>(record);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc,
+    typename Serializer>
+template<typename R>
+int32_t JournaledRBTree<Key, T, Compare, Alloc, Serializer>::recordMultiplicity(
+    const R &, std::false_type) {
+    return 1;
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef KEYCOMPARE_CLASS
+#define KEYCOMPARE_CLASS
+
+#include <type_traits>
+
+template<typename Compare,
+    bool Empty = std::is_empty<Compare>::value && !std::is_final<Compare>::value>
+/**
+ * @breif The KeyCompare holds the comparator of a tree. When the comparator
+ *        has no state it is inherited instead of kept as a member, so the
+ *        empty base optimization makes it take no space in the tree.
+ */
+class KeyCompare : private Compare{
+    public:
+        /**
+         * @breif Creates the holder.
+         * @param compare The comparator to keep.
+         */
+        KeyCompare(const Compare & compare = Compare()) : Compare(compare) {}
+
+        /**
+         * @breif Returns the comparator.
+         * @return The comparator.
+         */
+        const Compare & getCompare(void) const {
+            return *this;
+        }
+
+        /**
+         * @breif Determines wether a key goes before another one.
+         * @param a The first key.
+         * @param b The second key.
+         * @return True if a goes before b.
+         */
+        template<typename A, typename B>
+        bool less(const A & a, const B & b) const {
+            return static_cast<const Compare &>(*this)(a, b);
+        }
+};
+
+template<typename Compare>
+/**
+ * @breif The KeyCompare for comparators with state, or that can't be
+ *        inherited, which are kept as a member.
+ */
+class KeyCompare<Compare, false>{
+    private:
+        /**
+         * @breif The comparator.
+         */
+        Compare compare;
+
+    public:
+        /**
+         * @breif Creates the holder.
+         * @param compare The comparator to keep.
+         */
+        KeyCompare(const Compare & compare = Compare()) : compare(compare) {}
+
+        /**
+         * @breif Returns the comparator.
+         * @return The comparator.
+         */
+        const Compare & getCompare(void) const {
+            return this->compare;
+        }
+
+        /**
+         * @breif Determines wether a key goes before another one.
+         * @param a The first key.
+         * @param b The second key.
+         * @return True if a goes before b.
+         */
+        template<typename A, typename B>
+        bool less(const A & a, const B & b) const {
+            return this->compare(a, b);
+        }
+};
+
+#endif
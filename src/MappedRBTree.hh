@@ -0,0 +1,1089 @@
+#ifndef MAPPEDRBTREE_CLASS
+#define MAPPEDRBTREE_CLASS
+
+#include <stddef.h>//This gets NULL
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <functional>
+#include <type_traits>
+#include <vector>
+#include "Color.hh"
+#include "KeyCompare.hh"
+
+/**
+ * @breif The first bytes of a mapped tree, "RBTM" when read in the byte order
+ *        it was written in.
+ */
+const uint32_t MAPPED_MAGIC = 0x4d544252;
+
+/**
+ * @breif The version of the mapped tree format, a file of another one isn't
+ *        opened.
+ */
+const uint32_t MAPPED_VERSION = 1;
+
+template<typename Key, typename T, typename Compare = std::less<Key> >
+/**
+ * @breif The MappedRBTree is a red-black tree multiset that lives in a file
+ *        mapped in memory, so it can be larger than the memory and is there
+ *        again as soon as the file is opened.
+ *
+ * The nodes are linked by their offset in the file instead of pointers, so
+ * the file works wherever it's mapped. The file starts with a header that
+ * holds the root, the ends, the count and the free list of the tree, and
+ * grows in chunks as nodes are needed. Opening a file only maps it, nothing
+ * is read or rebuilt, the system pages the nodes in as they are touched.
+ *
+ * The keys and the data are stored as they are in memory, so they must be
+ * trivially copyable, and the file is only good for the machine and the types
+ * it was written with. Like in RBTree, elements with the same key and data
+ * share a node through its multiplicity, and an element with the key of
+ * another one but different data is rejected.
+ *
+ * Changes reach the file when the system writes the pages back, sync() and
+ * close() force them out. A file that was changed and not synced, as after a
+ * crash, is only opened again when asked to recover it: its tree is checked
+ * and kept if it holds, and the rest of the file is freed.
+ */
+class MappedRBTree : private KeyCompare<Compare>{
+    public:
+        /**
+         * @breif A node in the file, its links are offsets, 0 being NIL.
+         */
+        class MNode{
+            friend class MappedRBTree;
+
+            private:
+                uint64_t parent;
+                uint64_t left;
+                uint64_t right;
+                int32_t multiplicity;
+                uint8_t color;
+                Key key;
+                T data;
+
+            public:
+                const Key & getKey(void) const { return this->key; }
+                const T & getData(void) const { return this->data; }
+                int getMultiplicity(void) const { return this->multiplicity; }
+                Colors getColor(void) const { return (Colors) this->color; }
+        };
+
+    private:
+        /**
+         * @breif The header of the file, the nodes follow it.
+         */
+        struct alignas(64) Header {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t keySize;
+            uint32_t dataSize;
+            uint64_t nodeSize;
+            uint64_t length;///How long the file is.
+            uint64_t end;///Where the slots never used start.
+            uint64_t root;
+            uint64_t leftmost;
+            uint64_t rightmost;
+            uint64_t count;///The elements, multiplicities included.
+            uint64_t freeList;///The destroyed nodes, linked by left.
+            uint32_t clean;///1 if the file was synced since the last change.
+        };
+
+        static_assert(std::is_trivially_copyable<Key>::value &&
+            std::is_trivially_copyable<T>::value,
+            "a mapped tree stores trivially copyable keys and data only");
+
+        /**
+         * @breif The file, -1 if none is open.
+         */
+        int file = -1;
+
+        /**
+         * @breif Where the file is mapped.
+         */
+        char * base = NULL;
+
+        /**
+         * @breif How many bytes the file grows by.
+         */
+        uint64_t chunkBytes = 1 << 20;
+
+        /**
+         * @breif Returns the header of the file.
+         */
+        Header * header(void) const;
+
+        /**
+         * @breif Returns the node at an offset.
+         * @param offset The offset, 0 for NIL.
+         * @return The node, NULL for NIL.
+         */
+        MNode * at(uint64_t offset) const;
+
+        /**
+         * @breif Returns the offset of a node.
+         * @param node The node, NULL for NIL.
+         * @return The offset, 0 for NIL.
+         */
+        uint64_t offsetOf(const MNode * node) const;
+
+        /**
+         * @breif Makes the file longer and maps it again, every node moves.
+         * @return False if the file couldn't grow.
+         */
+        bool grow(void);
+
+        /**
+         * @breif Takes a node from the free list or from the end of the file.
+         *        The file may grow, so pointers to nodes are stale after.
+         * @return The offset of the node, 0 if the file couldn't grow.
+         */
+        uint64_t create(void);
+
+        /**
+         * @breif Puts a node in the free list.
+         * @param node The node.
+         */
+        void destroy(MNode * node);
+
+        /**
+         * @breif Marks the file as changed and not synced.
+         */
+        void touch(void);
+
+        MNode * parent(const MNode * node) const;
+        MNode * left(const MNode * node) const;
+        MNode * right(const MNode * node) const;
+        bool isLeft(const MNode * node) const;
+        MNode * sibling(const MNode * node) const;
+        Colors color(const MNode * node) const;
+
+        /**
+         * @breif Returns the node with the key, or the last node of the
+         *        search if there is none.
+         * @param key   The key to search for.
+         * @param found Where is written wether the key was found.
+         * @return The node, NULL if the tree is empty.
+         */
+        MNode * descend(const Key & key, bool * found) const;
+
+        /**
+         * @breif Puts a node where another one was, for its parent.
+         * @param oldNode The node that was there.
+         * @param newNode The node that goes there, may be NULL.
+         */
+        void replaceNode(MNode * oldNode, MNode * newNode);
+
+        void rotateLeft(MNode * node);
+        void rotateRight(MNode * node);
+        void insertCase1(MNode * node);
+        void insertCase2(MNode * node);
+        void insertCase3(MNode * node);
+        void insertCase4(MNode * node);
+        void insertCase5(MNode * node);
+
+        /**
+         * @breif Takes a node out of the tree and fixes it, see
+         *        RBTree::unlinkNode().
+         * @param node The node.
+         */
+        void unlinkNode(MNode * node);
+
+        /**
+         * @breif Swaps the place of a node with two children with the one of
+         *        its successor, see RBTree::swapWithSuccessor().
+         * @param node The node.
+         */
+        void swapWithSuccessor(MNode * node);
+
+        void deleteCase1(MNode * node);
+        void deleteCase2(MNode * node);
+        void deleteCase3(MNode * node);
+        void deleteCase4(MNode * node);
+        void deleteCase5(MNode * node);
+        void deleteCase6(MNode * node);
+
+        /**
+         * @breif Checks a subtree, see validate().
+         * @param node  The root of the subtree.
+         * @param black Where the black height is written.
+         * @param count Where the elements are added.
+         * @param depth How many levels the subtree may have at most, so a
+         *              broken file can't run down a chain of nodes.
+         * @return True if the subtree is right.
+         */
+        bool checkSubtree(const MNode * node, int * black,
+            uint64_t * count, int depth) const;
+
+        /**
+         * @breif Tells wether an offset is 0 or the one of a slot below the
+         *        end, so the node there can be read.
+         * @param offset The offset.
+         * @return True if it's NIL or a slot.
+         */
+        bool isSlot(uint64_t offset) const;
+
+        /**
+         * @breif Checks the tree of a file that was changed and not synced,
+         *        and if it holds, counts its elements, finds its ends and
+         *        puts every slot it doesn't use in the free list.
+         * @param length How long the file is, a crash while it grew leaves
+         *               it longer than the header says.
+         * @return False if the tree is broken, the file is left as it was.
+         */
+        bool recover(uint64_t length);
+
+    public:
+        /**
+         * @breif Creates a tree with no file, see open().
+         * @param compare The comparator of the keys.
+         */
+        explicit MappedRBTree(const Compare & compare = Compare());
+
+        MappedRBTree(const MappedRBTree & other) = delete;
+        MappedRBTree & operator=(const MappedRBTree & other) = delete;
+
+        /**
+         * @breif Closes the file.
+         */
+        ~MappedRBTree(void);
+
+        /**
+         * @breif Opens the file of a tree, or creates an empty one.
+         * @param path       The path of the file.
+         * @param chunkBytes How many bytes the file grows by, at least the
+         *                   size of a node.
+         * @param recover    Wether a file that was changed and not synced is
+         *                   opened if its tree holds, see recover(). Keys and
+         *                   data written when it crashed may be lost or half
+         *                   written, only the shape of the tree is checked.
+         * @return False if the file can't be mapped, isn't a tree of these
+         *         types, or was changed and not synced and isn't recovered.
+         */
+        bool open(const char * path, uint64_t chunkBytes = 1 << 20,
+            bool recover = false);
+
+        /**
+         * @breif Writes the changed pages to the disk.
+         * @return False if they couldn't be written.
+         */
+        bool sync(void);
+
+        /**
+         * @breif Syncs and closes the file.
+         * @return False if it couldn't be synced.
+         */
+        bool close(void);
+
+        /**
+         * @breif Tells wether a file is open.
+         * @return True if a file is open.
+         */
+        bool isOpen(void) const;
+
+        /**
+         * @breif Returns how long the file is.
+         * @return The number of bytes.
+         */
+        uint64_t length(void) const;
+
+        /**
+         * @breif Inserts a key-data pair, see RBTree::insert(). The nodes may
+         *        move, the ones taken before are stale after.
+         * @param key  The key value to insert.
+         * @param data The data to insert.
+         * @return True if the data was inserted, false if the key is there
+         *         with other data or the file couldn't grow.
+         */
+        bool insert(const Key & key, const T & data);
+
+        /**
+         * @breif Returns the multiplicity of a key.
+         * @param key The key to search for.
+         * @return The multiplicity, 0 if the key is not in the tree.
+         */
+        int exists(const Key & key) const;
+
+        /**
+         * @breif Finds the node of a key.
+         * @param key The key to search for.
+         * @return The node, NULL if the key is not in the tree.
+         */
+        const MNode * find(const Key & key) const;
+
+        /**
+         * @breif Extracts an element, see RBTree::extract().
+         * @param key The key to extract.
+         * @return The extracted data, a default constructed one if the key is
+         *         not in the tree.
+         */
+        T extract(const Key & key);
+
+        /**
+         * @breif Returns how many elements there are, multiplicities
+         *        included.
+         * @return The number of elements.
+         */
+        size_t size(void) const;
+
+        /**
+         * @breif Returns the node with the lowest key, in O(1).
+         * @return The node, NULL if the tree is empty.
+         */
+        const MNode * first(void) const;
+
+        /**
+         * @breif Returns the node with the highest key, in O(1).
+         * @return The node, NULL if the tree is empty.
+         */
+        const MNode * last(void) const;
+
+        /**
+         * @breif Returns the node that follows another one in key order.
+         * @param node The node.
+         * @return The next node, NULL if it's the last one.
+         */
+        const MNode * next(const MNode * node) const;
+
+        /**
+         * @breif Returns the node that goes before another one in key order.
+         * @param node The node.
+         * @return The previous node, NULL if it's the first one.
+         */
+        const MNode * previous(const MNode * node) const;
+
+        /**
+         * @breif Checks the red-black rules, the order of the keys, the
+         *        links, the ends and the count, in O(n).
+         * @return True if the tree is right.
+         */
+        bool validate(void) const;
+};
+
+/******************************************************************************
+ *                                                                           **
+ * CLASS IMPLEMENTATION                                                      **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare>
+MappedRBTree<Key, T, Compare>::MappedRBTree(const Compare & compare) :
+    KeyCompare<Compare>(compare) {}
+
+template<typename Key, typename T, typename Compare>
+MappedRBTree<Key, T, Compare>::~MappedRBTree(void) {
+    this->close();
+}
+
+template<typename Key, typename T, typename Compare>
+typename MappedRBTree<Key, T, Compare>::Header *
+MappedRBTree<Key, T, Compare>::header(void) const {
+    return reinterpret_cast<Header *>(this->base);
+}
+
+template<typename Key, typename T, typename Compare>
+typename MappedRBTree<Key, T, Compare>::MNode *
+MappedRBTree<Key, T, Compare>::at(uint64_t offset) const {
+    return offset == 0? NULL: reinterpret_cast<MNode *>(this->base + offset);
+}
+
+template<typename Key, typename T, typename Compare>
+uint64_t MappedRBTree<Key, T, Compare>::offsetOf(const MNode * node) const {
+    return node == NULL? 0: reinterpret_cast<const char *>(node) - this->base;
+}
+
+template<typename Key, typename T, typename Compare>
+bool MappedRBTree<Key, T, Compare>::open(const char * path,
+    uint64_t chunkBytes, bool recover) {
+    this->close();
+    this->chunkBytes = chunkBytes < sizeof(MNode)? sizeof(MNode): chunkBytes;
+    this->file = ::open(path, O_RDWR | O_CREAT, 0644);
+    struct stat status;
+    if (this->file < 0 || fstat(this->file, &status) != 0) {
+        this->close();
+        return false;
+    }
+    bool created = status.st_size == 0;
+    uint64_t length = created? sizeof(Header) + this->chunkBytes:
+        status.st_size;
+    if ((created && ftruncate(this->file, length) != 0) ||
+        length < sizeof(Header)) {
+        this->close();
+        return false;
+    }
+    void * mapped = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED,
+        this->file, 0);
+    if (mapped == MAP_FAILED) {
+        this->close();
+        return false;
+    }
+    this->base = static_cast<char *>(mapped);
+    Header * header = this->header();
+    if (created) {
+        memset(header, 0, sizeof(Header));
+        header->magic = MAPPED_MAGIC;
+        header->version = MAPPED_VERSION;
+        header->keySize = sizeof(Key);
+        header->dataSize = sizeof(T);
+        header->nodeSize = sizeof(MNode);
+        header->length = length;
+        header->end = sizeof(Header);
+        header->clean = 1;
+    } else if (header->magic != MAPPED_MAGIC ||
+        header->version != MAPPED_VERSION || header->keySize != sizeof(Key) ||
+        header->dataSize != sizeof(T) || header->nodeSize != sizeof(MNode) ||
+        (header->clean == 1? header->length != length: !recover ||
+        header->length > length || !this->recover(length))) {
+        // Leaves the file as it was.
+        munmap(this->base, length);
+        this->base = NULL;
+        this->close();
+        return false;
+    }
+    return true;
+}
+
+template<typename Key, typename T, typename Compare>
+bool MappedRBTree<Key, T, Compare>::sync(void) {
+    if (this->base == NULL) {
+        return false;
+    }
+    this->header()->clean = 1;
+    return msync(this->base, this->header()->length, MS_SYNC) == 0;
+}
+
+template<typename Key, typename T, typename Compare>
+bool MappedRBTree<Key, T, Compare>::close(void) {
+    bool synced = this->base != NULL;
+    if (this->base != NULL) {
+        synced = this->sync();
+        munmap(this->base, this->header()->length);
+        this->base = NULL;
+    }
+    if (this->file >= 0) {
+        ::close(this->file);
+        this->file = -1;
+    }
+    return synced;
+}
+
+template<typename Key, typename T, typename Compare>
+bool MappedRBTree<Key, T, Compare>::isOpen(void) const {
+    return this->base != NULL;
+}
+
+template<typename Key, typename T, typename Compare>
+uint64_t MappedRBTree<Key, T, Compare>::length(void) const {
+    return this->base == NULL? 0: this->header()->length;
+}
+
+template<typename Key, typename T, typename Compare>
+void MappedRBTree<Key, T, Compare>::touch(void) {
+    this->header()->clean = 0;
+}
+
+template<typename Key, typename T, typename Compare>
+bool MappedRBTree<Key, T, Compare>::grow(void) {
+    uint64_t length = this->header()->length;
+    uint64_t longer = length + this->chunkBytes;
+    if (ftruncate(this->file, longer) != 0) {
+        return false;
+    }
+    void * mapped = mmap(NULL, longer, PROT_READ | PROT_WRITE, MAP_SHARED,
+        this->file, 0);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    munmap(this->base, length);
+    this->base = static_cast<char *>(mapped);
+    this->header()->length = longer;
+    return true;
+}
+
+template<typename Key, typename T, typename Compare>
+uint64_t MappedRBTree<Key, T, Compare>::create(void) {
+    Header * header = this->header();
+    if (header->freeList != 0) {
+        uint64_t offset = header->freeList;
+        header->freeList = this->at(offset)->left;
+        return offset;
+    }
+    if (header->end + sizeof(MNode) > header->length) {
+        if (!this->grow()) {
+            return 0;
+        }
+        header = this->header();
+    }
+    uint64_t offset = header->end;
+    header->end += sizeof(MNode);
+    return offset;
+}
+
+template<typename Key, typename T, typename Compare>
+void MappedRBTree<Key, T, Compare>::destroy(MNode * node) {
+    node->left = this->header()->freeList;
+    this->header()->freeList = this->offsetOf(node);
+}
+
+template<typename Key, typename T, typename Compare>
+typename MappedRBTree<Key, T, Compare>::MNode *
+MappedRBTree<Key, T, Compare>::parent(const MNode * node) const {
+    return this->at(node->parent);
+}
+
+template<typename Key, typename T, typename Compare>
+typename MappedRBTree<Key, T, Compare>::MNode *
+MappedRBTree<Key, T, Compare>::left(const MNode * node) const {
+    return this->at(node->left);
+}
+
+template<typename Key, typename T, typename Compare>
+typename MappedRBTree<Key, T, Compare>::MNode *
+MappedRBTree<Key, T, Compare>::right(const MNode * node) const {
+    return this->at(node->right);
+}
+
+template<typename Key, typename T, typename Compare>
+bool MappedRBTree<Key, T, Compare>::isLeft(const MNode * node) const {
+    return node->parent != 0 &&
+        this->parent(node)->left == this->offsetOf(node);
+}
+
+template<typename Key, typename T, typename Compare>
+typename MappedRBTree<Key, T, Compare>::MNode *
+MappedRBTree<Key, T, Compare>::sibling(const MNode * node) const {
+    MNode * parent = this->parent(node);
+    return this->isLeft(node)? this->right(parent): this->left(parent);
+}
+
+template<typename Key, typename T, typename Compare>
+Colors MappedRBTree<Key, T, Compare>::color(const MNode * node) const {
+    return node == NULL? BLACK: (Colors) node->color;
+}
+
+template<typename Key, typename T, typename Compare>
+typename MappedRBTree<Key, T, Compare>::MNode *
+MappedRBTree<Key, T, Compare>::descend(const Key & key, bool * found) const {
+    MNode * node = this->at(this->header()->root);
+    MNode * parent = NULL;
+    *found = false;
+    while (node != NULL) {
+        parent = node;
+        if (this->less(key, node->key)) {
+            node = this->left(node);
+        } else if (this->less(node->key, key)) {
+            node = this->right(node);
+        } else {
+            *found = true;
+            return node;
+        }
+    }
+    return parent;
+}
+
+template<typename Key, typename T, typename Compare>
+void MappedRBTree<Key, T, Compare>::replaceNode(MNode * oldNode,
+    MNode * newNode) {
+    MNode * parent = this->parent(oldNode);
+    uint64_t offset = this->offsetOf(newNode);
+    if (parent == NULL) {
+        this->header()->root = offset;
+    } else if (parent->left == this->offsetOf(oldNode)) {
+        parent->left = offset;
+    } else {
+        parent->right = offset;
+    }
+    if (newNode != NULL) {
+        newNode->parent = oldNode->parent;
+    }
+}
+
+template<typename Key, typename T, typename Compare>
+void MappedRBTree<Key, T, Compare>::rotateLeft(MNode * node) {
+    MNode * right = this->right(node);
+    this->replaceNode(node, right);
+    node->right = right->left;
+    if (right->left != 0) {
+        this->left(right)->parent = this->offsetOf(node);
+    }
+    right->left = this->offsetOf(node);
+    node->parent = this->offsetOf(right);
+}
+
+template<typename Key, typename T, typename Compare>
+void MappedRBTree<Key, T, Compare>::rotateRight(MNode * node) {
+    MNode * left = this->left(node);
+    this->replaceNode(node, left);
+    node->left = left->right;
+    if (left->right != 0) {
+        this->right(left)->parent = this->offsetOf(node);
+    }
+    left->right = this->offsetOf(node);
+    node->parent = this->offsetOf(left);
+}
+
+/******************************************************************************
+ *                                                                           **
+ * INSERTION                                                                 **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare>
+bool MappedRBTree<Key, T, Compare>::insert(const Key & key, const T & data) {
+    if (this->base == NULL) {
+        return false;
+    }
+    bool found;
+    MNode * place = this->descend(key, &found);
+    if (found) {
+        if (!(place->data == data)) {
+            return false;
+        }
+        this->touch();
+        ++place->multiplicity;
+        ++this->header()->count;
+        return true;
+    }
+    // The file may grow and move, only offsets survive create().
+    uint64_t placeOffset = this->offsetOf(place);
+    uint64_t offset = this->create();
+    if (offset == 0) {
+        return false;
+    }
+    this->touch();
+    Header * header = this->header();
+    MNode * node = this->at(offset);
+    place = this->at(placeOffset);
+    node->parent = placeOffset;
+    node->left = 0;
+    node->right = 0;
+    node->multiplicity = 1;
+    node->color = RED;
+    node->key = key;
+    node->data = data;
+    if (place == NULL) {
+        header->root = offset;
+        header->leftmost = offset;
+        header->rightmost = offset;
+    } else if (this->less(key, place->key)) {
+        place->left = offset;
+        if (header->leftmost == placeOffset) header->leftmost = offset;
+    } else {
+        place->right = offset;
+        if (header->rightmost == placeOffset) header->rightmost = offset;
+    }
+    ++header->count;
+    this->insertCase1(node);
+    return true;
+}
+
+template<typename Key, typename T, typename Compare>
+void MappedRBTree<Key, T, Compare>::insertCase1(MNode * node) {
+    if (node->parent == 0) {
+        node->color = BLACK;
+    } else {
+        this->insertCase2(node);
+    }
+}
+
+template<typename Key, typename T, typename Compare>
+void MappedRBTree<Key, T, Compare>::insertCase2(MNode * node) {
+    if (this->parent(node)->color != BLACK) {
+        this->insertCase3(node);
+    }
+}
+
+template<typename Key, typename T, typename Compare>
+void MappedRBTree<Key, T, Compare>::insertCase3(MNode * node) {
+    MNode * parent = this->parent(node);
+    MNode * uncle = this->sibling(parent);
+    if (this->color(uncle) == RED) {
+        MNode * grandpa = this->parent(parent);
+        parent->color = BLACK;
+        uncle->color = BLACK;
+        grandpa->color = RED;
+        this->insertCase1(grandpa);
+    } else {
+        this->insertCase4(node);
+    }
+}
+
+template<typename Key, typename T, typename Compare>
+void MappedRBTree<Key, T, Compare>::insertCase4(MNode * node) {
+    MNode * parent = this->parent(node);
+    if (!this->isLeft(node) && this->isLeft(parent)) {
+        this->rotateLeft(parent);
+        node = parent;
+    } else if (this->isLeft(node) && !this->isLeft(parent)) {
+        this->rotateRight(parent);
+        node = parent;
+    }
+    this->insertCase5(node);
+}
+
+template<typename Key, typename T, typename Compare>
+void MappedRBTree<Key, T, Compare>::insertCase5(MNode * node) {
+    MNode * parent = this->parent(node);
+    MNode * grandpa = this->parent(parent);
+    parent->color = BLACK;
+    grandpa->color = RED;
+    if (this->isLeft(node) && this->isLeft(parent)) {
+        this->rotateRight(grandpa);
+    } else {
+        this->rotateLeft(grandpa);
+    }
+}
+
+/******************************************************************************
+ *                                                                           **
+ * SEARCH AND ORDER                                                          **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare>
+const typename MappedRBTree<Key, T, Compare>::MNode *
+MappedRBTree<Key, T, Compare>::find(const Key & key) const {
+    if (this->base == NULL) {
+        return NULL;
+    }
+    bool found;
+    MNode * node = this->descend(key, &found);
+    return found? node: NULL;
+}
+
+template<typename Key, typename T, typename Compare>
+int MappedRBTree<Key, T, Compare>::exists(const Key & key) const {
+    const MNode * node = this->find(key);
+    return node == NULL? 0: node->multiplicity;
+}
+
+template<typename Key, typename T, typename Compare>
+size_t MappedRBTree<Key, T, Compare>::size(void) const {
+    return this->base == NULL? 0: this->header()->count;
+}
+
+template<typename Key, typename T, typename Compare>
+const typename MappedRBTree<Key, T, Compare>::MNode *
+MappedRBTree<Key, T, Compare>::first(void) const {
+    return this->base == NULL? NULL: this->at(this->header()->leftmost);
+}
+
+template<typename Key, typename T, typename Compare>
+const typename MappedRBTree<Key, T, Compare>::MNode *
+MappedRBTree<Key, T, Compare>::last(void) const {
+    return this->base == NULL? NULL: this->at(this->header()->rightmost);
+}
+
+template<typename Key, typename T, typename Compare>
+const typename MappedRBTree<Key, T, Compare>::MNode *
+MappedRBTree<Key, T, Compare>::next(const MNode * node) const {
+    if (node->right != 0) {
+        node = this->right(node);
+        while (node->left != 0) {
+            node = this->left(node);
+        }
+        return node;
+    }
+    while (node->parent != 0 && !this->isLeft(node)) {
+        node = this->parent(node);
+    }
+    return this->parent(node);
+}
+
+template<typename Key, typename T, typename Compare>
+const typename MappedRBTree<Key, T, Compare>::MNode *
+MappedRBTree<Key, T, Compare>::previous(const MNode * node) const {
+    if (node->left != 0) {
+        node = this->left(node);
+        while (node->right != 0) {
+            node = this->right(node);
+        }
+        return node;
+    }
+    while (node->parent != 0 && this->isLeft(node)) {
+        node = this->parent(node);
+    }
+    return this->parent(node);
+}
+
+/******************************************************************************
+ *                                                                           **
+ * DELETION                                                                  **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare>
+T MappedRBTree<Key, T, Compare>::extract(const Key & key) {
+    MNode * node = const_cast<MNode *>(this->find(key));
+    if (node == NULL) {
+        return T();
+    }
+    this->touch();
+    T data = node->data;
+    --this->header()->count;
+    if (--node->multiplicity == 0) {
+        this->unlinkNode(node);
+        this->destroy(node);
+    }
+    return data;
+}
+
+template<typename Key, typename T, typename Compare>
+void MappedRBTree<Key, T, Compare>::unlinkNode(MNode * node) {
+    Header * header = this->header();
+    uint64_t offset = this->offsetOf(node);
+    if (header->leftmost == offset) {
+        header->leftmost = this->offsetOf(this->next(node));
+    }
+    if (header->rightmost == offset) {
+        header->rightmost = this->offsetOf(this->previous(node));
+    }
+    if (node->left != 0 && node->right != 0) {
+        this->swapWithSuccessor(node);
+    }
+    MNode * child = node->left != 0? this->left(node): this->right(node);
+    if (node->color == BLACK) {
+        if (this->color(child) == RED) {
+            child->color = BLACK;
+        } else {
+            // The node takes the place of its NIL child while the tree is
+            // fixed, it's unlinked afterwards.
+            this->deleteCase1(node);
+        }
+    }
+    this->replaceNode(node, child);
+}
+
+template<typename Key, typename T, typename Compare>
+void MappedRBTree<Key, T, Compare>::swapWithSuccessor(MNode * node) {
+    MNode * successor = this->right(node);
+    while (successor->left != 0) {
+        successor = this->left(successor);
+    }
+    uint64_t nodeOffset = this->offsetOf(node);
+    uint64_t successorOffset = this->offsetOf(successor);
+    uint64_t left = node->left;
+    uint64_t right = node->right;
+    MNode * successorParent = this->parent(successor);
+    uint64_t successorRight = successor->right;
+    uint8_t c = node->color;
+
+    this->replaceNode(node, successor);
+    successor->left = left;
+    this->at(left)->parent = successorOffset;
+    if (successorParent == node) {
+        successor->right = nodeOffset;
+        node->parent = successorOffset;
+    } else {
+        successor->right = right;
+        this->at(right)->parent = successorOffset;
+        successorParent->left = nodeOffset;
+        node->parent = this->offsetOf(successorParent);
+    }
+    node->left = 0;
+    node->right = successorRight;
+    if (successorRight != 0) {
+        this->at(successorRight)->parent = nodeOffset;
+    }
+    node->color = successor->color;
+    successor->color = c;
+}
+
+template<typename Key, typename T, typename Compare>
+void MappedRBTree<Key, T, Compare>::deleteCase1(MNode * node) {
+    if (node->parent != 0) {
+        this->deleteCase2(node);
+    }
+}
+
+template<typename Key, typename T, typename Compare>
+void MappedRBTree<Key, T, Compare>::deleteCase2(MNode * node) {
+    MNode * sibling = this->sibling(node);
+    if (this->color(sibling) == RED) {
+        this->parent(node)->color = RED;
+        sibling->color = BLACK;
+        if (this->isLeft(node)) {
+            this->rotateLeft(this->parent(node));
+        } else {
+            this->rotateRight(this->parent(node));
+        }
+    }
+    this->deleteCase3(node);
+}
+
+template<typename Key, typename T, typename Compare>
+void MappedRBTree<Key, T, Compare>::deleteCase3(MNode * node) {
+    MNode * sibling = this->sibling(node);
+    if (this->parent(node)->color == BLACK &&
+        this->color(sibling) == BLACK &&
+        this->color(this->left(sibling)) == BLACK &&
+        this->color(this->right(sibling)) == BLACK) {
+        sibling->color = RED;
+        this->deleteCase1(this->parent(node));
+    } else {
+        this->deleteCase4(node);
+    }
+}
+
+template<typename Key, typename T, typename Compare>
+void MappedRBTree<Key, T, Compare>::deleteCase4(MNode * node) {
+    MNode * sibling = this->sibling(node);
+    if (this->parent(node)->color == RED &&
+        this->color(sibling) == BLACK &&
+        this->color(this->left(sibling)) == BLACK &&
+        this->color(this->right(sibling)) == BLACK) {
+        sibling->color = RED;
+        this->parent(node)->color = BLACK;
+    } else {
+        this->deleteCase5(node);
+    }
+}
+
+template<typename Key, typename T, typename Compare>
+void MappedRBTree<Key, T, Compare>::deleteCase5(MNode * node) {
+    MNode * sibling = this->sibling(node);
+    // The sibling is black here, case 2 made sure of it.
+    if (this->isLeft(node) &&
+        this->color(this->right(sibling)) == BLACK &&
+        this->color(this->left(sibling)) == RED) {
+        sibling->color = RED;
+        this->left(sibling)->color = BLACK;
+        this->rotateRight(sibling);
+    } else if (!this->isLeft(node) &&
+        this->color(this->left(sibling)) == BLACK &&
+        this->color(this->right(sibling)) == RED) {
+        sibling->color = RED;
+        this->right(sibling)->color = BLACK;
+        this->rotateLeft(sibling);
+    }
+    this->deleteCase6(node);
+}
+
+template<typename Key, typename T, typename Compare>
+void MappedRBTree<Key, T, Compare>::deleteCase6(MNode * node) {
+    MNode * sibling = this->sibling(node);
+    MNode * parent = this->parent(node);
+    sibling->color = parent->color;
+    parent->color = BLACK;
+    if (this->isLeft(node)) {
+        this->right(sibling)->color = BLACK;
+        this->rotateLeft(parent);
+    } else {
+        this->left(sibling)->color = BLACK;
+        this->rotateRight(parent);
+    }
+}
+
+/******************************************************************************
+ *                                                                           **
+ * VALIDATION                                                                **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare>
+bool MappedRBTree<Key, T, Compare>::isSlot(uint64_t offset) const {
+    return offset == 0 || (offset >= sizeof(Header) &&
+        offset + sizeof(MNode) <= this->header()->end &&
+        (offset - sizeof(Header)) % sizeof(MNode) == 0);
+}
+
+template<typename Key, typename T, typename Compare>
+bool MappedRBTree<Key, T, Compare>::checkSubtree(const MNode * node,
+    int * black, uint64_t * count, int depth) const {
+    if (node == NULL) {
+        *black = 1;
+        return true;
+    }
+    if (depth == 0 || !this->isSlot(node->left) ||
+        !this->isSlot(node->right)) {
+        return false;
+    }
+    const MNode * left = this->left(node);
+    const MNode * right = this->right(node);
+    int leftBlack, rightBlack;
+    if ((left != NULL && (left->parent != this->offsetOf(node) ||
+        !this->less(left->key, node->key))) ||
+        (right != NULL && (right->parent != this->offsetOf(node) ||
+        !this->less(node->key, right->key))) ||
+        (node->color != RED && node->color != BLACK) ||
+        (node->color == RED && (this->color(left) == RED ||
+        this->color(right) == RED)) || node->multiplicity <= 0 ||
+        !this->checkSubtree(left, &leftBlack, count, depth - 1) ||
+        !this->checkSubtree(right, &rightBlack, count, depth - 1) ||
+        leftBlack != rightBlack) {
+        return false;
+    }
+    *black = leftBlack + (node->color == BLACK? 1: 0);
+    *count += node->multiplicity;
+    return true;
+}
+
+template<typename Key, typename T, typename Compare>
+bool MappedRBTree<Key, T, Compare>::validate(void) const {
+    if (this->base == NULL) {
+        return false;
+    }
+    const Header * header = this->header();
+    const MNode * root = this->at(header->root);
+    int black;
+    uint64_t count = 0;
+    // A red-black tree of 2^64 nodes is less than 128 levels deep.
+    if (!this->isSlot(header->root) ||
+        (root != NULL && (root->parent != 0 || root->color != BLACK)) ||
+        !this->checkSubtree(root, &black, &count, 128) ||
+        count != header->count) {
+        return false;
+    }
+    const MNode * first = root;
+    const MNode * last = root;
+    while (first != NULL && first->left != 0) first = this->left(first);
+    while (last != NULL && last->right != 0) last = this->right(last);
+    return this->offsetOf(first) == header->leftmost &&
+        this->offsetOf(last) == header->rightmost;
+}
+
+template<typename Key, typename T, typename Compare>
+bool MappedRBTree<Key, T, Compare>::recover(uint64_t length) {
+    Header * header = this->header();
+    if (header->end < sizeof(Header) || header->end > length ||
+        (header->end - sizeof(Header)) % sizeof(MNode) != 0) {
+        return false;
+    }
+    // The count and the ends may be stale, they are taken from the tree.
+    const MNode * root = this->at(header->root);
+    int black;
+    uint64_t count = 0;
+    if (!this->isSlot(header->root) ||
+        (root != NULL && (root->parent != 0 || root->color != BLACK)) ||
+        !this->checkSubtree(root, &black, &count, 128)) {
+        return false;
+    }
+    const MNode * first = root;
+    const MNode * last = root;
+    while (first != NULL && first->left != 0) first = this->left(first);
+    while (last != NULL && last->right != 0) last = this->right(last);
+    std::vector<bool> used((header->end - sizeof(Header)) / sizeof(MNode));
+    for (const MNode * node = first; node != NULL; node = this->next(node)) {
+        used[(this->offsetOf(node) - sizeof(Header)) / sizeof(MNode)] = true;
+    }
+    uint64_t freeList = 0;
+    for (size_t i = used.size(); i > 0; --i) {
+        if (!used[i - 1]) {
+            uint64_t offset = sizeof(Header) + (i - 1) * sizeof(MNode);
+            this->at(offset)->left = freeList;
+            freeList = offset;
+        }
+    }
+    header->length = length;
+    header->leftmost = this->offsetOf(first);
+    header->rightmost = this->offsetOf(last);
+    header->count = count;
+    header->freeList = freeList;
+    return this->sync();
+}
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef MULTIPLICITIES_ENUM
+#define MULTIPLICITIES_ENUM
+
+///How the set operations of the tree merge the multiplicities of a key that
+///is in both trees.
+enum Multiplicities {
+    SUM_MULTIPLICITY,///The multiplicities are added.
+    MAX_MULTIPLICITY,///The highest multiplicity is kept.
+    MIN_MULTIPLICITY///The lowest multiplicity is kept.
+};
+
+#endif
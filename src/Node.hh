@@ -2,9 +2,44 @@
 #define NODE_CLASS
 
 #include <stddef.h>//This gets NULL
+#include <stdint.h>
+#include <utility>
 #include "Color.hh"
 
-template<typename T>
+/**
+ * RBTREE_ORDER_STATISTICS gives every Node the weight of its subtree, the sum
+ * of the multiplicities of its nodes, so the tree can answer rank and select
+ * queries. It costs one field per node and the upkeep on every change, so it
+ * is off unless defined to 1 before including the tree.
+ */
+#ifndef RBTREE_ORDER_STATISTICS
+#define RBTREE_ORDER_STATISTICS 0
+#endif
+
+/**
+ * RBTREE_COMPACT_NODES makes every Node link to its parent and children with
+ * 32-bit indices of a NodeArena instead of pointers, and keeps the color in
+ * the top bit of the multiplicity. An int key and payload then take 28 bytes
+ * instead of 48, and the nodes of a pool sit in contiguous chunks. The nodes
+ * linked in a tree must come from a NodePool, the tree copies the ones made
+ * with new it's given. It is off unless defined to 1 before including the
+ * tree, and every file of a program must agree on it.
+ */
+#ifndef RBTREE_COMPACT_NODES
+#define RBTREE_COMPACT_NODES 0
+#endif
+
+#if RBTREE_COMPACT_NODES
+#include "NodeArena.hh"
+#endif
+
+/**
+ * @breif Tag that asks a Node to build its data in place, from the arguments
+ *        that follow it.
+ */
+struct InPlace {};
+
+template<typename Key, typename T>
 /**
  * @breif The node class defines a multiset element.
  *
@@ -13,25 +48,74 @@ template<typename T>
  * related to the multiset concept. It also contains the tree elements
  * which are, key, color, left child and right child. In addition, this
  * implementation will know it's parent Node, (kind of like a doubly
- * linked list).
+ * linked list). The key can be of any type Key the tree knows how to
+ * compare.
  */
 class Node{
     private:
         /* CLASS ATTRIBUTES
-        1    int     key
+        1    Key     key
         2    T       data
         3    int     multiplicity
         4    Node    * parent
         5    Node    * left
         6    Node    * right
         7    Colors  color
+        8    size_t  weight (only with RBTREE_ORDER_STATISTICS)
+
+        With RBTREE_COMPACT_NODES
+        1    Key       key
+        2    uint32_t  index
+        3    uint32_t  parent
+        4    uint32_t  left
+        5    uint32_t  right
+        6    uint32_t  multiplicity, the top bit is set when black
+        7    T         data
+        8    size_t    weight (only with RBTREE_ORDER_STATISTICS)
          */
 
         /**
          * @breif The key of the Node defines it's position in the tree.
          */
-        int key;
+        Key key;
+
+#if RBTREE_COMPACT_NODES
+        /**
+         * @breif The top bit of the multiplicity, set when the Node is black.
+         */
+        static const uint32_t blackBit = 1u << 31;
+
+        /**
+         * @breif The index of this Node in its NodeArena.
+         */
+        uint32_t index = 0;
+
+        /**
+         * @breif The index of the parent Node, 0 if there is none.
+         */
+        uint32_t parent = 0;
+
+        /**
+         * @breif The index of the left child Node, 0 if there is none.
+         */
+        uint32_t left = 0;
+
+        /**
+         * @breif The index of the right child Node, 0 if there is none.
+         */
+        uint32_t right = 0;
+
+        /**
+         * @breif How many elements the node contains in the lower 31 bits,
+         *        the color in the top one.
+         */
+        uint32_t multiplicity = 0;
 
+        /**
+         * @breif This is the data contained in the Node.
+         */
+        T data;
+#else
         /**
          * @breif This is the data contained in the Node. Keep in mind that
          *        this class should have a way to be compared in order to
@@ -43,7 +127,7 @@ class Node{
          * @breif This number indicates how many elements does the node contain
          *        (how many can it provide).
          */
-        int multiplicity;
+        int multiplicity = 0;
 
         /**
          * @breif Indicates the parent Node.
@@ -64,15 +148,37 @@ class Node{
          * @breif Indicates the color of the Node.
          */
         Colors color;
+#endif
+
+#if RBTREE_ORDER_STATISTICS
+        /**
+         * @breif The sum of the multiplicities of the subtree whose root is
+         *        this Node.
+         */
+        size_t weight = 0;
+#endif
 
     public:
         /**
          * @breif Creates a Node with data. By default, the Node's color is red.
          *        Also the multiplicity will be 1. This is the constructor for
          *        the root node.
+         * @param data The data which the node will contain, it's copied.
+         */
+        Node(const Key & key, const T & data);
+
+        /**
+         * @breif Creates a Node with data, which is moved into the node.
          * @param data The data which the node will contain.
          */
-        Node(int key, T data);
+        Node(const Key & key, T && data);
+
+        /**
+         * @breif Creates a Node building its data in place.
+         * @param args The arguments for the constructor of the data.
+         */
+        template<typename... Args>
+        Node(const Key & key, InPlace, Args &&... args);
 
         /**
          * @breif Creates a Node with data. By default, the Node's color is red.
@@ -80,7 +186,7 @@ class Node{
          * @param data The data which the node will contain.
          * @param parent The parent node.
          */
-        Node(int key, T data, Node<T> * parent);
+        Node(const Key & key, const T & data, Node<Key, T> * parent);
 
         /**
          * @breif Destructs the Node.
@@ -96,43 +202,80 @@ class Node{
          * @breif Returns the Nodes key.
          * @return The Nodes key.
          */
-        int getKey(void);
+        const Key & getKey(void) const;
 
         /**
-         * @breif Returns data in the node.
+         * @breif Returns data in the node, without copying it.
          * @return The data in the node.
          */
-        T getData(void);
+        const T & getData(void) const;
+
+        /**
+         * @breif Returns data in the node, so it can be changed in place.
+         *        Changing it doesn't move the node in the tree.
+         * @return The data in the node.
+         */
+        T & getData(void);
 
         /**
          * @breif Returns the multiplicity of the node.
          * @return The multiplicity of the node.
          */
-        int getMultiplicity(void);
+        int getMultiplicity(void) const;
+
+#if RBTREE_ORDER_STATISTICS
+        /**
+         * @breif Returns the sum of the multiplicities of the subtree whose
+         *        root is this Node.
+         * @return The weight of the subtree.
+         */
+        size_t getWeight(void) const;
+
+        /**
+         * @breif Computes the weight again from the multiplicity and the
+         *        weight of the children. Linking children doesn't do it, the
+         *        tree calls it on the nodes it moves.
+         */
+        void recount(void);
+#endif
 
         /**
          * @breif Returns the parent node.
          * @return The parent node.
          */
-        Node * getParent(void);
+        Node * getParent(void) const;
 
         /**
          * @breif Returns the left child node.
          * @return The left child node.
          */
-        Node * getLeft(void);
+        Node * getLeft(void) const;
 
         /**
          * @breif Returns right child node.
          * @return The right child node.
          */
-        Node * getRight(void);
+        Node * getRight(void) const;
 
         /**
          * @breif Returns the nodes color.
          * @return The color of the current node.
          */
-        Colors getColor(void);
+        Colors getColor(void) const;
+
+#if RBTREE_COMPACT_NODES
+        /**
+         * @breif Returns the index of the Node in its NodeArena.
+         * @return The index.
+         */
+        uint32_t getIndex(void) const;
+
+        /**
+         * @breif Sets the index of the Node, the pool that creates it does.
+         * @param index The index.
+         */
+        void setIndex(uint32_t index);
+#endif
 
         /**********************************************************************
          *                                                                   **
@@ -144,16 +287,23 @@ class Node{
           * @breif Sets the Node's key.
           * @param key The key to set.
           */
-         void setKey(int key);
+         void setKey(const Key & key);
 
          /**
-          * @breif Sets the Nodes's data.
+          * @breif Sets the Nodes's data, copying it.
           * @param data The data to set.
           */
-         void setData(T data);
+         void setData(const T & data);
 
          /**
-          * @breif Sets the Nodes's multiplicity.
+          * @breif Sets the Nodes's data, moving it.
+          * @param data The data to set.
+          */
+         void setData(T && data);
+
+         /**
+          * @breif Sets the Nodes's multiplicity. With order statistics, the
+          *        weight of the Node and its ancestors changes along.
           * @param data The multiplicity to set.
           */
          void setMultiplicity(int multiplicity);
@@ -162,21 +312,21 @@ class Node{
           * @breif Sets the parent node.
           * @param parent The pointer to the node to add.
           */
-         void setParent(Node<T> * node);
+         void setParent(Node<Key, T> * node);
 
          /**
           * @breif Sets the child node on the left side, and indicates that
           *        this Node is now it's parent.
           * @param left The pointer to the node to add.
           */
-         void setLeft(Node<T> * node);
+         void setLeft(Node<Key, T> * node);
 
          /**
           * @breif Sets the child node on the right side, and indicates that
           *        this Node is now it's parent.
           * @param right The pointer to the node to add.
           */
-         void setRight(Node<T> * node);
+         void setRight(Node<Key, T> * node);
 
         /**
          * @breif Changes the Node's color to a specific color.
@@ -208,39 +358,39 @@ class Node{
          *        right.
          * @return  True if parent Node.
          */
-        bool isParent(void);
+        bool isParent(void) const;
 
         /**
          * @breif Determines wheter Node is a left Node, it doesn't mean it's
          *        right.
          * @return  True if left Node.
          */
-        bool isLeft(void);
+        bool isLeft(void) const;
 
         /**
          * @breif Determines wheter Node is a right Node, it doesn't mean is
          *        left.
          * @return  True if right Node.
          */
-        bool isRight(void);
+        bool isRight(void) const;
 
         /**
          * @breif Determines wheter Node has a Parent Node.
          * @return  True if has parent Node.
          */
-        bool hasParent(void);
+        bool hasParent(void) const;
 
         /**
          * @breif Determines wheter Node has a left Node.
          * @return  True if has left Node.
          */
-        bool hasLeft(void);
+        bool hasLeft(void) const;
 
         /**
          * @breif Determines wheter Node has a right Node.
          * @return  True if has right Node.
          */
-        bool hasRight(void);
+        bool hasRight(void) const;
 };
 
 
@@ -250,28 +400,39 @@ class Node{
  *                                                                           **
  ******************************************************************************/
 
-template<typename T>
-Node<T>::Node(int key, T data) {
-    this->setKey(key);
-    this->setData(data);
+template<typename Key, typename T>
+Node<Key, T>::Node(const Key & key, const T & data) : key(key), data(data) {
+    this->setMultiplicity(1);
+    this->setColor(RED);
+}
 
+template<typename Key, typename T>
+Node<Key, T>::Node(const Key & key, T && data) :
+    key(key), data(std::move(data)) {
     this->setMultiplicity(1);
     this->setColor(RED);
 }
 
-template<typename T>
-Node<T>::Node(int key, T data, Node<T> * parent) {
-    this->setKey(key);
-    this->setData(data);
+template<typename Key, typename T>
+template<typename... Args>
+Node<Key, T>::Node(const Key & key, InPlace, Args &&... args) :
+    key(key), data(std::forward<Args>(args)...) {
+    this->setMultiplicity(1);
+    this->setColor(RED);
+}
+
+template<typename Key, typename T>
+Node<Key, T>::Node(const Key & key, const T & data, Node<Key, T> * parent) :
+    key(key), data(data) {
     this->setParent(parent);
 
-    this-setMultiplicity(1);
+    this->setMultiplicity(1);
     this->setColor(RED);
 }
 
 
-template<typename T>
-Node<T>::~Node(void) {
+template<typename Key, typename T>
+Node<Key, T>::~Node(void) {
     // REMOVE ALL REFERENCES
     this->setParent(NULL);
     this->setLeft(NULL);
@@ -286,41 +447,95 @@ Node<T>::~Node(void) {
  *                                                                           **
  ******************************************************************************/
 
-template<typename T>
-int Node<T>::getKey(void) {
+template<typename Key, typename T>
+const Key & Node<Key, T>::getKey(void) const {
     return this->key;
 }
 
-template<typename T>
-T Node<T>::getData(void) {
+template<typename Key, typename T>
+const T & Node<Key, T>::getData(void) const {
     return this->data;
 }
 
-template<typename T>
-int Node<T>::getMultiplicity(void) {
+template<typename Key, typename T>
+T & Node<Key, T>::getData(void) {
+    return this->data;
+}
+
+template<typename Key, typename T>
+int Node<Key, T>::getMultiplicity(void) const {
+#if RBTREE_COMPACT_NODES
+    return static_cast<int>(this->multiplicity & ~blackBit);
+#else
     return this->multiplicity;
+#endif
+}
+
+#if RBTREE_ORDER_STATISTICS
+template<typename Key, typename T>
+size_t Node<Key, T>::getWeight(void) const {
+    return this->weight;
+}
+
+template<typename Key, typename T>
+void Node<Key, T>::recount(void) {
+    this->weight = this->getMultiplicity();
+    if (this->hasLeft()) this->weight += this->getLeft()->weight;
+    if (this->hasRight()) this->weight += this->getRight()->weight;
+}
+#endif
+
+#if RBTREE_COMPACT_NODES
+template<typename Key, typename T>
+Node<Key, T> * Node<Key, T>::getParent(void) const {
+    return NodeArena<Node>::at(this->parent);
+}
+
+template<typename Key, typename T>
+Node<Key, T> * Node<Key, T>::getLeft(void) const {
+    return NodeArena<Node>::at(this->left);
+}
+
+template<typename Key, typename T>
+Node<Key, T> * Node<Key, T>::getRight(void) const {
+    return NodeArena<Node>::at(this->right);
+}
+
+template<typename Key, typename T>
+Colors Node<Key, T>::getColor(void) const {
+    return (this->multiplicity & blackBit) != 0? BLACK: RED;
+}
+
+template<typename Key, typename T>
+uint32_t Node<Key, T>::getIndex(void) const {
+    return this->index;
 }
 
-template<typename T>
-Node<T> * Node<T>::getParent(void) {
+template<typename Key, typename T>
+void Node<Key, T>::setIndex(uint32_t index) {
+    this->index = index;
+}
+#else
+template<typename Key, typename T>
+Node<Key, T> * Node<Key, T>::getParent(void) const {
     return this->parent;
 }
 
-template<typename T>
-Node<T> * Node<T>::getLeft(void) {
+template<typename Key, typename T>
+Node<Key, T> * Node<Key, T>::getLeft(void) const {
     return this->left;
 }
 
-template<typename T>
-Node<T> * Node<T>::getRight(void) {
+template<typename Key, typename T>
+Node<Key, T> * Node<Key, T>::getRight(void) const {
     return this->right;
 }
 
-template<typename T>
-Colors Node<T>::getColor(void) {
-    if (this == NULL) return BLACK;//it's a leaf, it's BLACKKKKKK
+template<typename Key, typename T>
+Colors Node<Key, T>::getColor(void) const {
     return this->color;
 }
+#endif
 
 /******************************************************************************
  *                                                                           **
@@ -328,23 +543,72 @@ Colors Node<T>::getColor(void) {
  *                                                                           **
  ******************************************************************************/
 
- template<typename T>
- void Node<T>::setKey(int key) {
+ template<typename Key, typename T>
+ void Node<Key, T>::setKey(const Key & key) {
      this->key = key;
  }
 
- template<typename T>
- void Node<T>::setData(T data) {
+ template<typename Key, typename T>
+ void Node<Key, T>::setData(const T & data) {
      this->data = data;
  }
 
- template<typename T>
- void Node<T>::setMultiplicity(int multiplicity) {
+ template<typename Key, typename T>
+ void Node<Key, T>::setData(T && data) {
+     this->data = std::move(data);
+ }
+
+ template<typename Key, typename T>
+ void Node<Key, T>::setMultiplicity(int multiplicity) {
+#if RBTREE_ORDER_STATISTICS
+     // Unsigned arithmetic wraps, so adding a negative change works.
+     size_t change = (size_t) multiplicity - (size_t) this->getMultiplicity();
+     for (Node<Key, T> * node = this; node != NULL; node = node->getParent()) {
+         node->weight += change;
+     }
+#endif
+#if RBTREE_COMPACT_NODES
+     this->multiplicity = (this->multiplicity & blackBit) |
+         static_cast<uint32_t>(multiplicity);
+#else
      this->multiplicity = multiplicity;
+#endif
  }
 
- template<typename T>
- void Node<T>::setParent(Node<T> * node) {
+ #if RBTREE_COMPACT_NODES
+ template<typename Key, typename T>
+ void Node<Key, T>::setParent(Node<Key, T> * node) {
+     this->parent = node == NULL? 0: node->index;
+ }
+
+ template<typename Key, typename T>
+ void Node<Key, T>::setLeft(Node<Key, T> * node) {
+     if (node == NULL) {
+         this->left = 0;
+         return;
+     }
+     node->setParent(this);
+     this->left = node->index;
+ }
+
+ template<typename Key, typename T>
+ void Node<Key, T>::setRight(Node<Key, T> * node) {
+     if (node == NULL) {
+         this->right = 0;
+         return;
+     }
+     node->setParent(this);
+     this->right = node->index;
+ }
+
+ template<typename Key, typename T>
+ void Node<Key, T>::setColor(Colors color) {
+     this->multiplicity = color == BLACK? this->multiplicity | blackBit:
+         this->multiplicity & ~blackBit;
+ }
+ #else
+ template<typename Key, typename T>
+ void Node<Key, T>::setParent(Node<Key, T> * node) {
      if (node == NULL) {
          this->parent = NULL;
          return;
@@ -352,8 +616,8 @@ Colors Node<T>::getColor(void) {
      this->parent = node;
  }
 
- template<typename T>
- void Node<T>::setLeft(Node<T> * node) {
+ template<typename Key, typename T>
+ void Node<Key, T>::setLeft(Node<Key, T> * node) {
      if (node == NULL) {
          this->left = NULL;
          return;
@@ -362,8 +626,8 @@ Colors Node<T>::getColor(void) {
      this->left = node;
  }
 
- template<typename T>
- void Node<T>::setRight(Node<T> * node) {
+ template<typename Key, typename T>
+ void Node<Key, T>::setRight(Node<Key, T> * node) {
      if (node == NULL) {
          this->right = NULL;
          return;
@@ -372,10 +636,11 @@ Colors Node<T>::getColor(void) {
      this->right = node;
  }
 
- template<typename T>
- void Node<T>::setColor(Colors color) {
+ template<typename Key, typename T>
+ void Node<Key, T>::setColor(Colors color) {
      this->color = color;
  }
+ #endif
 
 /******************************************************************************
  *                                                                           **
@@ -383,8 +648,8 @@ Colors Node<T>::getColor(void) {
  *                                                                           **
  ******************************************************************************/
 
-template<typename T>
-void Node<T>::add(void) {
+template<typename Key, typename T>
+void Node<Key, T>::add(void) {
     //this->setMultiplicity(this->getMultiplicity()+1);
     // Shouldn't be below 0, if lesser or equal to 0, then value after adding
     // is 1
@@ -392,8 +657,8 @@ void Node<T>::add(void) {
     this->setMultiplicity(value);
 }
 
-template<typename T>
-bool Node<T>::remove(void) {
+template<typename Key, typename T>
+bool Node<Key, T>::remove(void) {
     // Shouldn't be lesser than 0.
     int value = this->getMultiplicity() <= 0? 0: this->getMultiplicity() - 1;
     this->setMultiplicity(value);
@@ -401,13 +666,13 @@ bool Node<T>::remove(void) {
     return empty;
 }
 
-template<typename T>
-bool Node<T>::isParent(void) {
+template<typename Key, typename T>
+bool Node<Key, T>::isParent(void) const {
     return this->hasLeft() || this->hasRight();
 }
 
-template<typename T>
-bool Node<T>::isLeft(void) {
+template<typename Key, typename T>
+bool Node<Key, T>::isLeft(void) const {
     // Is neither left or right, then is-Not-Left, not meaning it's right
     if (this->getParent() == NULL) return false;
 
@@ -417,8 +682,8 @@ bool Node<T>::isLeft(void) {
     return this->getParent()->getLeft() == this;
 }
 
-template<typename T>
-bool Node<T>::isRight(void) {
+template<typename Key, typename T>
+bool Node<Key, T>::isRight(void) const {
     // Is neither left or right, then is-Not-Right, not meaning it's left
     if (this->getParent() == NULL) return false;
 
@@ -428,18 +693,18 @@ bool Node<T>::isRight(void) {
     return this->getParent()->getRight() == this;
 }
 
-template<typename T>
-bool Node<T>::hasParent(void) {
+template<typename Key, typename T>
+bool Node<Key, T>::hasParent(void) const {
     return this->getParent() != NULL;
 }
 
-template<typename T>
-bool Node<T>::hasLeft(void) {
+template<typename Key, typename T>
+bool Node<Key, T>::hasLeft(void) const {
     return this->getLeft() != NULL;
 }
 
-template<typename T>
-bool Node<T>::hasRight(void) {
+template<typename Key, typename T>
+bool Node<Key, T>::hasRight(void) const {
     return this->getRight() != NULL;
 }
 
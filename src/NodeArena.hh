@@ -0,0 +1,136 @@
+#ifndef NODEARENA_CLASS
+#define NODEARENA_CLASS
+
+#include <stddef.h>//This gets NULL
+#include <stdint.h>
+#include <stdlib.h>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+template<typename N>
+/**
+ * @breif The NodeArena gives a 32-bit index to every slot that can hold a
+ *        node of type N, so compact nodes link to each other with indices
+ *        instead of pointers.
+ *
+ * The slots come in chunks of chunkSlots contiguous nodes. The index of a
+ * slot is its chunk number followed by its place in the chunk, so finding
+ * the node of an index takes one look at the table of chunks. The index 0 is
+ * never given, it stands for NULL. Chunks don't move, so the pointers to the
+ * nodes stay valid while their chunk is held.
+ *
+ * There is one arena for each node type, shared by every pool of that type.
+ * Only taking and giving back chunks locks it, finding a node doesn't.
+ */
+class NodeArena{
+    private:
+        /**
+         * @breif Raw memory for one node.
+         */
+        typedef typename std::aligned_storage<sizeof(N), alignof(N)>::type Slot;
+
+        /**
+         * @breif The chunk of each chunk number, NULL if it's not held.
+         */
+        static inline Slot ** table = NULL;
+
+        /**
+         * @breif How many chunk numbers were ever given, the number 0 included.
+         */
+        static inline uint32_t used = 1;
+
+        /**
+         * @breif The chunk numbers given back, to be given again.
+         */
+        static inline std::vector<uint32_t> spare;
+
+        /**
+         * @breif Guards the table while chunks are taken or given back.
+         */
+        static inline std::mutex guard;
+
+    public:
+        /**
+         * @breif How many bits of an index tell the place in the chunk.
+         */
+        static const uint32_t chunkBits = 12;
+
+        /**
+         * @breif How many nodes a chunk holds.
+         */
+        static const uint32_t chunkSlots = 1u << chunkBits;
+
+        /**
+         * @breif How many chunks the 32-bit indices can tell apart.
+         */
+        static const uint32_t maxChunks = 1u << (32 - chunkBits);
+
+        /**
+         * @breif Returns the node of an index.
+         * @param index The index, 0 for NULL.
+         * @return The node, NULL for the index 0.
+         */
+        static N * at(uint32_t index) {
+            if (index == 0) return NULL;
+            return reinterpret_cast<N *>(table[index >> chunkBits] +
+                (index & (chunkSlots - 1)));
+        }
+
+        /**
+         * @breif Takes a new chunk.
+         * @return The index of its first slot.
+         */
+        static uint32_t acquire(void);
+
+        /**
+         * @breif Gives back a chunk, its memory goes back to the heap and its
+         *        number is kept for the next acquire().
+         * @param first The index of its first slot.
+         */
+        static void giveBack(uint32_t first);
+};
+
+/******************************************************************************
+ *                                                                           **
+ * CLASS IMPLEMENTATION                                                      **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename N>
+uint32_t NodeArena<N>::acquire(void) {
+    std::lock_guard<std::mutex> lock(guard);
+    if (table == NULL) {
+        // calloc hands zeroed pages, the unused part of the table costs no
+        // resident memory.
+        table = static_cast<Slot **>(calloc(maxChunks, sizeof(Slot *)));
+        if (table == NULL) throw std::bad_alloc();
+    }
+    uint32_t chunk;
+    if (!spare.empty()) {
+        chunk = spare.back();
+        spare.pop_back();
+    } else {
+        if (used == maxChunks) throw std::bad_alloc();
+        chunk = used++;
+    }
+    try {
+        table[chunk] = new Slot[chunkSlots];
+    } catch (...) {
+        spare.push_back(chunk);
+        throw;
+    }
+    return chunk << chunkBits;
+}
+
+template<typename N>
+void NodeArena<N>::giveBack(uint32_t first) {
+    std::lock_guard<std::mutex> lock(guard);
+    uint32_t chunk = first >> chunkBits;
+    delete[] table[chunk];
+    table[chunk] = NULL;
+    spare.push_back(chunk);
+}
+
+#endif
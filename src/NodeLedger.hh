@@ -0,0 +1,174 @@
+#ifndef NODELEDGER_CLASS
+#define NODELEDGER_CLASS
+
+#include <stddef.h>//This gets NULL
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include "Node.hh"
+
+template<typename N>
+/**
+ * @breif The NodeLedger holds the chunks of one or more allocators and
+ *        counts the nodes alive in them.
+ *
+ * An allocator starts with a ledger of its own. Allocators that hand nodes to
+ * each other, see NodePool::share(), end up on the same ledger, so a chunk
+ * stays while any of them may still hold a node in it, and the count is the
+ * one of all of them. The chunks go back when the last allocator lets go of
+ * the ledger.
+ *
+ * Merging two ledgers moves the chunks into one of them and leaves the other
+ * one forwarding to it. An allocator that still has the old one keeps
+ * counting its nodes there, which is cheaper than following the forward on
+ * every node, and total() adds up the counts of the ledgers merged. The
+ * chunks always go to the last ledger, see find().
+ */
+class NodeLedger{
+    public:
+#if RBTREE_COMPACT_NODES
+        /**
+         * @breif The index of the first slot of every chunk, the chunks come
+         *        from the NodeArena of N.
+         */
+        std::vector<uint32_t> chunks;
+#else
+        /**
+         * @breif The chunks, given by the heap.
+         */
+        std::vector<void *> chunks;
+#endif
+
+        /**
+         * @breif How many nodes the allocators on this ledger created minus
+         *        how many they destroyed. Nodes move between the allocators
+         *        of a merged ledger, so it can wrap, only total() counts.
+         */
+        size_t live = 0;
+
+        /**
+         * @breif How many slots the chunks have altogether.
+         */
+        size_t capacity = 0;
+
+        /**
+         * @breif The ledger this one was merged into, NULL if it wasn't.
+         */
+        std::shared_ptr<NodeLedger> forward;
+
+        /**
+         * @breif The ledgers merged into this one that are still held.
+         */
+        std::vector<NodeLedger *> merged;
+
+        NodeLedger(void) = default;
+        NodeLedger(const NodeLedger & other) = delete;
+        NodeLedger & operator=(const NodeLedger & other) = delete;
+
+        /**
+         * @breif Gives back the chunks, a merged ledger leaves its count to
+         *        the one it forwards to.
+         */
+        ~NodeLedger(void);
+
+        /**
+         * @breif Returns how many nodes are alive, in the ledgers merged into
+         *        this one too.
+         * @return The number of nodes alive.
+         */
+        size_t total(void) const;
+
+        /**
+         * @breif Returns the ledger an allocator counts on, following the
+         *        forwards and keeping the last one. An allocator without a
+         *        ledger gets a new one.
+         * @param ledger The ledger of the allocator.
+         * @return The ledger.
+         */
+        static NodeLedger & find(std::shared_ptr<NodeLedger> & ledger);
+
+        /**
+         * @breif Merges the ledgers of two allocators, both allocators end up
+         *        on the same ledger. The one with fewer chunks is merged into
+         *        the other.
+         * @param into The ledger of one allocator.
+         * @param from The ledger of the other one.
+         */
+        static void merge(std::shared_ptr<NodeLedger> & into,
+            std::shared_ptr<NodeLedger> & from);
+};
+
+/******************************************************************************
+ *                                                                           **
+ * CLASS IMPLEMENTATION                                                      **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename N>
+NodeLedger<N>::~NodeLedger(void) {
+    for (size_t i = 0; i < this->chunks.size(); ++i) {
+#if RBTREE_COMPACT_NODES
+        NodeArena<N>::giveBack(this->chunks[i]);
+#else
+        ::operator delete(this->chunks[i]);
+#endif
+    }
+    if (this->forward != NULL) {
+        this->forward->live += this->live;
+        std::vector<NodeLedger *> & siblings = this->forward->merged;
+        for (size_t i = 0; i < siblings.size(); ++i) {
+            if (siblings[i] == this) {
+                siblings[i] = siblings.back();
+                siblings.pop_back();
+                break;
+            }
+        }
+    }
+}
+
+template<typename N>
+size_t NodeLedger<N>::total(void) const {
+    size_t nodes = this->live;
+    for (size_t i = 0; i < this->merged.size(); ++i) {
+        nodes += this->merged[i]->total();
+    }
+    return nodes;
+}
+
+template<typename N>
+NodeLedger<N> & NodeLedger<N>::find(std::shared_ptr<NodeLedger> & ledger) {
+    if (ledger == NULL) {
+        ledger = std::make_shared<NodeLedger>();
+    }
+    while (ledger->forward != NULL) {
+        ledger = ledger->forward;
+    }
+    return *ledger;
+}
+
+template<typename N>
+void NodeLedger<N>::merge(std::shared_ptr<NodeLedger> & into,
+    std::shared_ptr<NodeLedger> & from) {
+    if (find(into).chunks.size() < find(from).chunks.size()) {
+        // The shorter list of chunks is the one copied, both allocators end
+        // up on the same ledger anyway.
+        std::swap(into, from);
+    }
+    NodeLedger & kept = find(into);
+    NodeLedger & merged = find(from);
+    if (&kept == &merged) {
+        return;
+    }
+    kept.chunks.insert(kept.chunks.end(), merged.chunks.begin(),
+        merged.chunks.end());
+    kept.live += merged.live;
+    kept.capacity += merged.capacity;
+    merged.chunks.clear();
+    merged.live = 0;
+    merged.capacity = 0;
+    merged.forward = into;
+    kept.merged.push_back(&merged);
+    from = into;
+}
+
+#endif
@@ -0,0 +1,473 @@
+#ifndef NODEPOOL_CLASS
+#define NODEPOOL_CLASS
+
+#include <stddef.h>//This gets NULL
+#include <string.h>
+#include <new>
+#include <vector>
+#include <utility>
+#include <type_traits>
+#include "Node.hh"
+#include "NodeLedger.hh"
+
+template<typename N>
+/**
+ * @breif The NodePool is the default allocator policy of the RBTree, it hands
+ *        out nodes from contiguous chunks instead of calling new on every
+ *        insertion.
+ *
+ * Each chunk holds a number of slots big enough for one node. Destroyed nodes
+ * are not given back to the heap, they are kept in a free list and reused by
+ * the next creation. All the chunks can be given back at once with release(),
+ * which is how a whole tree is thrown away in one step.
+ *
+ * With RBTREE_COMPACT_NODES the chunks come from the NodeArena of N, each
+ * chunk has NodeArena::chunkSlots slots, and the free list links the slots by
+ * their index.
+ *
+ * The chunks are kept in a NodeLedger. Pools whose trees hand nodes to each
+ * other share() their ledger, so each of them may destroy the nodes of the
+ * others, and the chunks stay until the last of them is released.
+ *
+ * Any allocator policy must provide create(), destroy(), release(), share()
+ * and the bulkRelease flag, which tells if release() frees the memory of the
+ * nodes that were never destroyed.
+ */
+class NodePool{
+    private:
+        /**
+         * @breif A slot of a chunk, while free it is a link of the free list,
+         *        else it holds a node.
+         */
+        union Slot {
+            Slot * next;
+            typename std::aligned_storage<sizeof(N), alignof(N)>::type node;
+        };
+
+        /**
+         * @breif Holds the chunks and counts the nodes alive.
+         */
+        std::shared_ptr<NodeLedger<N> > ledger;
+
+#if RBTREE_COMPACT_NODES
+        /**
+         * @breif The index of the first free slot, 0 if there is none. A free
+         *        slot starts with the index of the next one.
+         */
+        uint32_t freeList = 0;
+
+        /**
+         * @breif The index of the first slot of the newest chunk that was
+         *        never used.
+         */
+        uint32_t unused = 0;
+#else
+        /**
+         * @breif The first free slot, NULL if there is none.
+         */
+        Slot * freeList = NULL;
+
+        /**
+         * @breif The slots of the newest chunk that were never used.
+         */
+        Slot * unused = NULL;
+#endif
+
+        /**
+         * @breif How many slots of the newest chunk were never used.
+         */
+        size_t unusedCount = 0;
+
+        /**
+         * @breif How many slots the next chunk will have.
+         */
+        size_t chunkSize;
+
+        /**
+         * @breif Asks the heap for a new chunk. Chunks double their size until
+         *        they reach maxChunkSize slots.
+         */
+        void grow(void);
+
+#if RBTREE_COMPACT_NODES
+        /**
+         * @breif Gets a slot, from the free list if possible.
+         * @return The index of a slot ready to hold a node.
+         */
+        uint32_t take(void);
+#else
+        /**
+         * @breif Gets a slot, from the free list if possible.
+         * @return A slot ready to hold a node.
+         */
+        Slot * take(void);
+#endif
+
+    public:
+        /**
+         * @breif Tells that release() frees every node at once.
+         */
+        static const bool bulkRelease = true;
+
+        /**
+         * @breif The biggest chunk the pool will ask for, in slots.
+         */
+        static const size_t maxChunkSize = 4096;
+
+        /**
+         * @breif Creates an empty pool, no memory is asked until the first
+         *        node is created.
+         * @param chunkSize The number of slots of the first chunk.
+         */
+        NodePool(size_t chunkSize = 64);
+
+        /**
+         * @breif Destructs the pool, giving back all its chunks.
+         */
+        ~NodePool(void);
+
+        NodePool(const NodePool & other) = delete;
+        NodePool & operator=(const NodePool & other) = delete;
+
+        /**
+         * @breif Creates a pool taking the chunks of another one, which is
+         *        left empty.
+         * @param other The pool to take the chunks from.
+         */
+        NodePool(NodePool && other);
+
+        /**
+         * @breif Gives back the chunks of the pool and takes the ones of
+         *        another pool, which is left empty.
+         * @param other The pool to take the chunks from.
+         */
+        NodePool & operator=(NodePool && other);
+
+        /**
+         * @breif Exchanges the chunks of two pools.
+         * @param other The pool to exchange with.
+         */
+        void swap(NodePool & other);
+
+        /**
+         * @breif Creates a node inside the pool.
+         * @param args The arguments for the node's constructor.
+         * @return The created node.
+         */
+        template<typename... Args>
+        N * create(Args &&... args);
+
+        /**
+         * @breif Destructs a node and keeps its slot for the next creation.
+         * @param node The node to destroy.
+         */
+        void destroy(N * node);
+
+        /**
+         * @breif Gives back every chunk to the heap. The destructors of the
+         *        nodes still alive are not called. Chunks shared with other
+         *        pools stay until the last of them is released, and their
+         *        nodes are still counted until then.
+         */
+        void release(void);
+
+        /**
+         * @breif Shares the chunks of the pool with another one, from then on
+         *        each of them may destroy the nodes the other created.
+         * @param other The pool to share with.
+         */
+        void share(NodePool & other);
+
+        /**
+         * @breif Returns how many nodes are alive, in the pools the chunks
+         *        are shared with too.
+         * @return The number of nodes alive.
+         */
+        size_t getLive(void);
+
+        /**
+         * @breif Returns how many nodes fit in the chunks asked so far.
+         * @return The number of slots.
+         */
+        size_t getCapacity(void);
+
+        /**
+         * @breif Returns how many chunks were asked to the heap.
+         * @return The number of chunks.
+         */
+        size_t getChunks(void);
+};
+
+template<typename N>
+/**
+ * @breif The NewAllocator is the allocator policy that calls new and delete
+ *        for every node, just like the tree used to do.
+ */
+class NewAllocator{
+    private:
+        /**
+         * @breif Counts the nodes alive.
+         */
+        std::shared_ptr<NodeLedger<N> > ledger;
+
+    public:
+        /**
+         * @breif Tells that release() can't free the nodes, they must be
+         *        destroyed one by one.
+         */
+        static const bool bulkRelease = false;
+
+        /**
+         * @breif Creates a node in the heap.
+         * @param args The arguments for the node's constructor.
+         * @return The created node.
+         */
+        template<typename... Args>
+        N * create(Args &&... args);
+
+        /**
+         * @breif Deletes a node.
+         * @param node The node to delete.
+         */
+        void destroy(N * node);
+
+        /**
+         * @breif Does nothing, every node was already deleted.
+         */
+        void release(void);
+
+        /**
+         * @breif Counts the nodes of another allocator along with these ones,
+         *        any allocator may delete any node.
+         * @param other The allocator to share with.
+         */
+        void share(NewAllocator & other);
+
+        /**
+         * @breif Returns how many nodes are alive.
+         * @return The number of nodes alive.
+         */
+        size_t getLive(void);
+};
+
+/******************************************************************************
+ *                                                                           **
+ * CLASS IMPLEMENTATION                                                      **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename N>
+NodePool<N>::NodePool(size_t chunkSize) {
+    this->chunkSize = chunkSize > 0? chunkSize: 1;
+}
+
+template<typename N>
+NodePool<N>::~NodePool(void) {
+    this->release();
+}
+
+template<typename N>
+NodePool<N>::NodePool(NodePool && other) {
+    this->chunkSize = 1;
+    this->swap(other);
+}
+
+template<typename N>
+NodePool<N> & NodePool<N>::operator=(NodePool && other) {
+    if (this != &other) {
+        this->release();
+        this->swap(other);
+    }
+    return *this;
+}
+
+template<typename N>
+void NodePool<N>::swap(NodePool & other) {
+    std::swap(this->ledger, other.ledger);
+    std::swap(this->freeList, other.freeList);
+    std::swap(this->unused, other.unused);
+    std::swap(this->unusedCount, other.unusedCount);
+    std::swap(this->chunkSize, other.chunkSize);
+}
+
+#if RBTREE_COMPACT_NODES
+template<typename N>
+void NodePool<N>::grow(void) {
+    NodeLedger<N> & book = NodeLedger<N>::find(this->ledger);
+    uint32_t first = NodeArena<N>::acquire();
+    book.chunks.push_back(first);
+    this->unused = first;
+    this->unusedCount = NodeArena<N>::chunkSlots;
+    book.capacity += NodeArena<N>::chunkSlots;
+}
+
+template<typename N>
+uint32_t NodePool<N>::take(void) {
+    uint32_t index;
+    if (this->freeList != 0) {
+        index = this->freeList;
+        memcpy(&this->freeList, static_cast<void *>(NodeArena<N>::at(index)),
+            sizeof(uint32_t));
+    } else {
+        if (this->unusedCount == 0) {
+            this->grow();
+        }
+        index = this->unused++;
+        --this->unusedCount;
+    }
+    return index;
+}
+
+template<typename N>
+template<typename... Args>
+N * NodePool<N>::create(Args &&... args) {
+    uint32_t index = this->take();
+    N * node;
+    try {
+        node = new (NodeArena<N>::at(index)) N(std::forward<Args>(args)...);
+    } catch (...) {
+        memcpy(static_cast<void *>(NodeArena<N>::at(index)), &this->freeList,
+            sizeof(uint32_t));
+        this->freeList = index;
+        throw;
+    }
+    node->setIndex(index);
+    ++this->ledger->live;
+    return node;
+}
+
+template<typename N>
+void NodePool<N>::destroy(N * node) {
+    if (node == NULL) return;
+    uint32_t index = node->getIndex();
+    node->~N();
+    memcpy(static_cast<void *>(node), &this->freeList, sizeof(uint32_t));
+    this->freeList = index;
+    --this->ledger->live;
+}
+
+template<typename N>
+void NodePool<N>::release(void) {
+    this->ledger.reset();
+    this->freeList = 0;
+    this->unused = 0;
+    this->unusedCount = 0;
+}
+#else
+template<typename N>
+void NodePool<N>::grow(void) {
+    NodeLedger<N> & book = NodeLedger<N>::find(this->ledger);
+    Slot * chunk = static_cast<Slot *>(::operator new(this->chunkSize * sizeof(Slot)));
+    book.chunks.push_back(chunk);
+    this->unused = chunk;
+    this->unusedCount = this->chunkSize;
+    book.capacity += this->chunkSize;
+    if (this->chunkSize < maxChunkSize) {
+        this->chunkSize = this->chunkSize * 2 > maxChunkSize? maxChunkSize: this->chunkSize * 2;
+    }
+}
+
+template<typename N>
+typename NodePool<N>::Slot * NodePool<N>::take(void) {
+    Slot * slot;
+    if (this->freeList != NULL) {
+        slot = this->freeList;
+        this->freeList = slot->next;
+    } else {
+        if (this->unusedCount == 0) {
+            this->grow();
+        }
+        slot = this->unused++;
+        --this->unusedCount;
+    }
+    return slot;
+}
+
+template<typename N>
+template<typename... Args>
+N * NodePool<N>::create(Args &&... args) {
+    Slot * slot = this->take();
+    N * node;
+    try {
+        node = new (&slot->node) N(std::forward<Args>(args)...);
+    } catch (...) {
+        slot->next = this->freeList;
+        this->freeList = slot;
+        throw;
+    }
+    ++this->ledger->live;
+    return node;
+}
+
+template<typename N>
+void NodePool<N>::destroy(N * node) {
+    if (node == NULL) return;
+    node->~N();
+    Slot * slot = reinterpret_cast<Slot *>(node);
+    slot->next = this->freeList;
+    this->freeList = slot;
+    --this->ledger->live;
+}
+
+template<typename N>
+void NodePool<N>::release(void) {
+    this->ledger.reset();
+    this->freeList = NULL;
+    this->unused = NULL;
+    this->unusedCount = 0;
+}
+#endif
+
+template<typename N>
+void NodePool<N>::share(NodePool & other) {
+    NodeLedger<N>::merge(this->ledger, other.ledger);
+}
+
+template<typename N>
+size_t NodePool<N>::getLive(void) {
+    return NodeLedger<N>::find(this->ledger).total();
+}
+
+template<typename N>
+size_t NodePool<N>::getCapacity(void) {
+    return NodeLedger<N>::find(this->ledger).capacity;
+}
+
+template<typename N>
+size_t NodePool<N>::getChunks(void) {
+    return NodeLedger<N>::find(this->ledger).chunks.size();
+}
+
+template<typename N>
+template<typename... Args>
+N * NewAllocator<N>::create(Args &&... args) {
+    static_assert(sizeof(N) == 0 || !RBTREE_COMPACT_NODES,
+        "compact nodes link by their NodeArena index, use a NodePool");
+    N * node = new N(std::forward<Args>(args)...);
+    ++NodeLedger<N>::find(this->ledger).live;
+    return node;
+}
+
+template<typename N>
+void NewAllocator<N>::destroy(N * node) {
+    if (node == NULL) return;
+    delete node;
+    --NodeLedger<N>::find(this->ledger).live;
+}
+
+template<typename N>
+void NewAllocator<N>::release(void) {
+    this->ledger.reset();
+}
+
+template<typename N>
+void NewAllocator<N>::share(NewAllocator & other) {
+    NodeLedger<N>::merge(this->ledger, other.ledger);
+}
+
+template<typename N>
+size_t NewAllocator<N>::getLive(void) {
+    return NodeLedger<N>::find(this->ledger).total();
+}
+
+#endif
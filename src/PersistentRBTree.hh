@@ -0,0 +1,815 @@
+#ifndef PERSISTENTRBTREE_CLASS
+#define PERSISTENTRBTREE_CLASS
+
+#include <stddef.h>//This gets NULL
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "Color.hh"
+#include "KeyCompare.hh"
+
+template<typename Key, typename T, typename Compare = std::less<Key> >
+/**
+ * @breif The PersistentRBTree is a red-black tree multiset whose versions
+ *        never change once published, so readers can keep one while writers
+ *        go on.
+ *
+ * insert() and extract() copy only the nodes from the root to the place they
+ * change, plus the few siblings the fix-up recolors or rotates, and share the
+ * rest with the previous version. The copies are fixed with the same cases as
+ * RBTree::insertCase1..5 and RBTree::deleteCase1..6, but the nodes have no
+ * parent, the path of copies takes its place. The new root is then published
+ * atomically.
+ *
+ * snapshot() takes the published version with one atomic load, after that
+ * reading it needs no lock at all. The nodes are reference counted, so a
+ * version is freed when no snapshot and no newer version uses its nodes.
+ * Writers are serialized by a lock of their own, readers never take it.
+ *
+ * Like in RBTree, elements with the same key and data share a node through
+ * its multiplicity, and an element with the key of another one but different
+ * data is rejected.
+ */
+class PersistentRBTree{
+    public:
+        /**
+         * @breif A node of a version, it can't be changed through a snapshot.
+         */
+        class PNode{
+            friend class PersistentRBTree;
+
+            private:
+                Key key;
+                T data;
+                int multiplicity = 1;
+                Colors color = RED;
+                std::shared_ptr<PNode> left;
+                std::shared_ptr<PNode> right;
+
+                /**
+                 * @breif The update that created the node, only that update
+                 *        may change it.
+                 */
+                uint64_t stamp;
+
+            public:
+                template<typename D>
+                PNode(const Key & key, D && data, uint64_t stamp) :
+                    key(key), data(std::forward<D>(data)), stamp(stamp) {}
+
+                const Key & getKey(void) const { return this->key; }
+                const T & getData(void) const { return this->data; }
+                int getMultiplicity(void) const { return this->multiplicity; }
+                Colors getColor(void) const { return this->color; }
+                const PNode * getLeft(void) const { return this->left.get(); }
+                const PNode * getRight(void) const { return this->right.get(); }
+        };
+
+    private:
+        typedef std::shared_ptr<PNode> Link;
+
+        /**
+         * @breif A published version, its root and size never change.
+         */
+        struct Version : public KeyCompare<Compare> {
+            Link root;
+            size_t count;
+
+            Version(const Compare & compare, const Link & root, size_t count) :
+                KeyCompare<Compare>(compare), root(root), count(count) {}
+        };
+
+    public:
+        /**
+         * @breif A version of the tree held by a reader. It stays the same
+         *        whatever the writers do, and keeps its nodes alive.
+         */
+        class Snapshot{
+            private:
+                std::shared_ptr<const Version> version;
+
+            public:
+                Snapshot(const std::shared_ptr<const Version> & version) :
+                    version(version) {}
+
+                /**
+                 * @breif Returns the root node.
+                 * @return The root, NULL if the version is empty.
+                 */
+                const PNode * getRoot(void) const;
+
+                /**
+                 * @breif Returns how many elements the version has,
+                 *        multiplicities included.
+                 * @return The number of elements.
+                 */
+                size_t size(void) const;
+
+                /**
+                 * @breif Finds the node of a key.
+                 * @param key The key to search for.
+                 * @return The node, NULL if the key is not in the version.
+                 */
+                const PNode * find(const Key & key) const;
+
+                /**
+                 * @breif Returns the multiplicity of a key.
+                 * @param key The key to search for.
+                 * @return The multiplicity, 0 if the key is not there.
+                 */
+                int exists(const Key & key) const;
+
+                /**
+                 * @breif The first node, takes O(log n).
+                 * @return The node, NULL if the version is empty.
+                 */
+                const PNode * first(void) const;
+
+                /**
+                 * @breif The last node, takes O(log n).
+                 * @return The node, NULL if the version is empty.
+                 */
+                const PNode * last(void) const;
+
+                /**
+                 * @breif Calls a function on every node in key order.
+                 * @param fn The function, called with a const PNode &.
+                 * @return How many nodes were visited.
+                 */
+                template<typename Function>
+                size_t for_each(Function fn) const;
+
+                /**
+                 * @breif Runs the full audit of the version, the rules, the
+                 *        order and the size. Takes O(n).
+                 * @return True if the version is correct.
+                 */
+                bool validate(void) const;
+
+            private:
+                /**
+                 * @breif Checks a subtree, see validate().
+                 * @param node     The root of the subtree.
+                 * @param low      A node every key must go after, or NULL.
+                 * @param high     A node every key must go before, or NULL.
+                 * @param elements Where the multiplicities are added.
+                 * @return The black height, -1 if the subtree is broken.
+                 */
+                int check(const PNode * node, const PNode * low,
+                    const PNode * high, size_t * elements) const;
+        };
+
+    private:
+        /**
+         * @breif The published version.
+         */
+        std::shared_ptr<const Version> current;
+
+        /**
+         * @breif Serializes the writers.
+         */
+        std::mutex writer;
+
+        /**
+         * @breif The comparator of the keys.
+         */
+        Compare compare;
+
+        /**
+         * @breif The stamp of the update in course, nodes with it are copies
+         *        that no version shares yet.
+         */
+        uint64_t stamp = 0;
+
+        /**
+         * @breif The root of the version being built.
+         */
+        Link root;
+
+        /**
+         * @breif The copies from the root to the node being fixed, each one
+         *        the child of the one before.
+         */
+        std::vector<Link> path;
+
+        bool less(const Key & a, const Key & b) const;
+
+        /**
+         * @breif Makes sure the node of a link is a copy of this update.
+         * @param link The link, nothing is done if it's empty.
+         */
+        void own(Link & link);
+
+        /**
+         * @breif Returns the link that holds the node at a place of the path.
+         * @param i The place in the path.
+         * @return The root or the link of the parent.
+         */
+        Link & linkOf(size_t i);
+
+        /**
+         * @breif Returns the link of the sibling of the node at a place of
+         *        the path.
+         * @param i The place in the path, not 0.
+         * @return The link of the parent to the other child.
+         */
+        Link & siblingOf(size_t i);
+
+        /**
+         * @breif Tells wether the node at a place of the path is a left child.
+         * @param i The place in the path, not 0.
+         */
+        bool isLeft(size_t i);
+
+        /**
+         * @breif Returns the color of a node, NIL leaves are black.
+         */
+        static Colors color(const Link & node);
+
+        /**
+         * @breif Copies the path from the root to a key.
+         * @param key The key.
+         * @return True if a node has the key, it's the last one of the path.
+         */
+        bool copyPath(const Key & key);
+
+        /**
+         * @breif Publishes the version being built.
+         * @param count The size of the new version.
+         */
+        void publish(size_t count);
+
+        /**
+         * @breif Inserts a key-data pair, see insert().
+         */
+        template<typename D>
+        bool insertData(const Key & key, D && data);
+
+        /**
+         * @breif Makes a left rotation on the node of a link, its right child
+         *        takes its place. Both must be copies of this update.
+         * @param link The link that holds the pivot.
+         */
+        void rotateLeft(Link & link);
+
+        /**
+         * @breif Makes a right rotation on the node of a link, its left child
+         *        takes its place. Both must be copies of this update.
+         * @param link The link that holds the pivot.
+         */
+        void rotateRight(Link & link);
+
+        void insertCase1(size_t i);
+        void insertCase2(size_t i);
+        void insertCase3(size_t i);
+        void insertCase4(size_t i);
+        void insertCase5(size_t i);
+        void deleteCase1(size_t i);
+        void deleteCase2(size_t i);
+        void deleteCase3(size_t i);
+        void deleteCase4(size_t i);
+        void deleteCase5(size_t i);
+        void deleteCase6(size_t i);
+
+    public:
+        /**
+         * @breif Creates an empty tree.
+         * @param compare The comparator of the keys.
+         */
+        PersistentRBTree(const Compare & compare = Compare());
+
+        PersistentRBTree(const PersistentRBTree & other) = delete;
+        PersistentRBTree & operator=(const PersistentRBTree & other) = delete;
+
+        /**
+         * @breif Takes the published version, with no lock.
+         * @return The snapshot.
+         */
+        Snapshot snapshot(void) const;
+
+        /**
+         * @breif Inserts a key-data pair, publishing a new version. If the
+         *        pair is already in the tree its multiplicity grows.
+         * @param key  The key value to insert.
+         * @param data The data to insert.
+         * @return False if the key is in the tree with other data.
+         */
+        bool insert(const Key & key, const T & data);
+
+        /**
+         * @breif Inserts a key-data pair, moving the data.
+         */
+        bool insert(const Key & key, T && data);
+
+        /**
+         * @breif Extracts an element, publishing a new version. When the
+         *        multiplicity reaches 0 the node leaves the new version.
+         * @param key The key to extract.
+         * @return The extracted data, a default constructed one if the key is
+         *         not in the tree.
+         */
+        T extract(const Key & key);
+
+        /**
+         * @breif Returns the multiplicity of a key in the published version.
+         * @param key The key to search for.
+         * @return The multiplicity, 0 if the key is not in the tree.
+         */
+        int exists(const Key & key) const;
+
+        /**
+         * @breif Returns how many elements the published version has.
+         * @return The number of elements.
+         */
+        size_t size(void) const;
+};
+
+/******************************************************************************
+ *                                                                           **
+ * CLASS IMPLEMENTATION                                                      **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare>
+PersistentRBTree<Key, T, Compare>::PersistentRBTree(const Compare & compare) :
+    compare(compare) {
+    this->current = std::make_shared<const Version>(compare, Link(), 0);
+}
+
+template<typename Key, typename T, typename Compare>
+typename PersistentRBTree<Key, T, Compare>::Snapshot
+PersistentRBTree<Key, T, Compare>::snapshot(void) const {
+    return Snapshot(std::atomic_load(&this->current));
+}
+
+template<typename Key, typename T, typename Compare>
+int PersistentRBTree<Key, T, Compare>::exists(const Key & key) const {
+    return this->snapshot().exists(key);
+}
+
+template<typename Key, typename T, typename Compare>
+size_t PersistentRBTree<Key, T, Compare>::size(void) const {
+    return this->snapshot().size();
+}
+
+template<typename Key, typename T, typename Compare>
+bool PersistentRBTree<Key, T, Compare>::less(const Key & a, const Key & b) const {
+    return this->compare(a, b);
+}
+
+template<typename Key, typename T, typename Compare>
+void PersistentRBTree<Key, T, Compare>::own(Link & link) {
+    if (link && link->stamp != this->stamp) {
+        Link copy = std::make_shared<PNode>(*link);
+        copy->stamp = this->stamp;
+        link = copy;
+    }
+}
+
+template<typename Key, typename T, typename Compare>
+typename PersistentRBTree<Key, T, Compare>::Link &
+PersistentRBTree<Key, T, Compare>::linkOf(size_t i) {
+    if (i == 0) {
+        return this->root;
+    }
+    PNode * parent = this->path[i - 1].get();
+    return parent->left == this->path[i]? parent->left: parent->right;
+}
+
+template<typename Key, typename T, typename Compare>
+typename PersistentRBTree<Key, T, Compare>::Link &
+PersistentRBTree<Key, T, Compare>::siblingOf(size_t i) {
+    PNode * parent = this->path[i - 1].get();
+    return parent->left == this->path[i]? parent->right: parent->left;
+}
+
+template<typename Key, typename T, typename Compare>
+bool PersistentRBTree<Key, T, Compare>::isLeft(size_t i) {
+    return this->path[i - 1]->left == this->path[i];
+}
+
+template<typename Key, typename T, typename Compare>
+Colors PersistentRBTree<Key, T, Compare>::color(const Link & node) {
+    return node? node->color: BLACK;
+}
+
+template<typename Key, typename T, typename Compare>
+bool PersistentRBTree<Key, T, Compare>::copyPath(const Key & key) {
+    ++this->stamp;
+    this->root = this->current->root;
+    this->path.clear();
+    Link * link = &this->root;
+    while (*link) {
+        this->own(*link);
+        this->path.push_back(*link);
+        PNode * node = link->get();
+        if (this->less(key, node->key)) {
+            link = &node->left;
+        } else if (this->less(node->key, key)) {
+            link = &node->right;
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename Key, typename T, typename Compare>
+void PersistentRBTree<Key, T, Compare>::publish(size_t count) {
+    std::shared_ptr<const Version> version =
+        std::make_shared<const Version>(this->compare, this->root, count);
+    std::atomic_store(&this->current, version);
+    this->root.reset();
+    this->path.clear();
+}
+
+/******************************************************************************
+ *                                                                           **
+ * ROTATIONS                                                                 **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare>
+void PersistentRBTree<Key, T, Compare>::rotateLeft(Link & link) {
+    Link pivot = link;
+    Link right = pivot->right;
+    pivot->right = right->left;
+    right->left = pivot;
+    link = right;
+}
+
+template<typename Key, typename T, typename Compare>
+void PersistentRBTree<Key, T, Compare>::rotateRight(Link & link) {
+    Link pivot = link;
+    Link left = pivot->left;
+    pivot->left = left->right;
+    left->right = pivot;
+    link = left;
+}
+
+/******************************************************************************
+ *                                                                           **
+ * INSERTION                                                                 **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare>
+bool PersistentRBTree<Key, T, Compare>::insert(const Key & key, const T & data) {
+    return this->insertData(key, data);
+}
+
+template<typename Key, typename T, typename Compare>
+bool PersistentRBTree<Key, T, Compare>::insert(const Key & key, T && data) {
+    return this->insertData(key, std::move(data));
+}
+
+template<typename Key, typename T, typename Compare>
+template<typename D>
+bool PersistentRBTree<Key, T, Compare>::insertData(const Key & key, D && data) {
+    std::lock_guard<std::mutex> lock(this->writer);
+    const PNode * found = this->snapshot().find(key);
+    if (found != NULL && !(found->data == data)) {
+        return false;
+    }
+    if (this->copyPath(key)) {
+        ++this->path.back()->multiplicity;
+    } else {
+        Link node = std::make_shared<PNode>(key, std::forward<D>(data),
+            this->stamp);
+        if (this->path.empty()) {
+            this->root = node;
+        } else if (this->less(key, this->path.back()->key)) {
+            this->path.back()->left = node;
+        } else {
+            this->path.back()->right = node;
+        }
+        this->path.push_back(node);
+        this->insertCase1(this->path.size() - 1);
+    }
+    this->publish(this->current->count + 1);
+    return true;
+}
+
+template<typename Key, typename T, typename Compare>
+void PersistentRBTree<Key, T, Compare>::insertCase1(size_t i) {
+    if (i == 0) {
+        this->path[0]->color = BLACK;
+    } else {
+        this->insertCase2(i);
+    }
+}
+
+template<typename Key, typename T, typename Compare>
+void PersistentRBTree<Key, T, Compare>::insertCase2(size_t i) {
+    if (this->path[i - 1]->color == BLACK) {
+        return;
+    } else {
+        this->insertCase3(i);
+    }
+}
+
+template<typename Key, typename T, typename Compare>
+void PersistentRBTree<Key, T, Compare>::insertCase3(size_t i) {
+    // The parent is red, so it's not the root and there is a grandpa.
+    Link & uncle = this->siblingOf(i - 1);
+    if (color(uncle) == RED) {
+        this->own(uncle);
+        this->path[i - 1]->color = BLACK;
+        uncle->color = BLACK;
+        this->path[i - 2]->color = RED;
+        this->insertCase1(i - 2);
+    } else {
+        this->insertCase4(i);
+    }
+}
+
+template<typename Key, typename T, typename Compare>
+void PersistentRBTree<Key, T, Compare>::insertCase4(size_t i) {
+    if (!this->isLeft(i) && this->isLeft(i - 1)) {
+        this->rotateLeft(this->linkOf(i - 1));
+        std::swap(this->path[i - 1], this->path[i]);
+    } else if (this->isLeft(i) && !this->isLeft(i - 1)) {
+        this->rotateRight(this->linkOf(i - 1));
+        std::swap(this->path[i - 1], this->path[i]);
+    }
+    this->insertCase5(i);
+}
+
+template<typename Key, typename T, typename Compare>
+void PersistentRBTree<Key, T, Compare>::insertCase5(size_t i) {
+    this->path[i - 1]->color = BLACK;
+    this->path[i - 2]->color = RED;
+    if (this->isLeft(i) && this->isLeft(i - 1)) {
+        this->rotateRight(this->linkOf(i - 2));
+    } else {
+        this->rotateLeft(this->linkOf(i - 2));
+    }
+}
+
+/******************************************************************************
+ *                                                                           **
+ * DELETION                                                                  **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare>
+T PersistentRBTree<Key, T, Compare>::extract(const Key & key) {
+    std::lock_guard<std::mutex> lock(this->writer);
+    if (this->snapshot().find(key) == NULL) {
+        return T();
+    }
+    this->copyPath(key);
+    PNode * node = this->path.back().get();
+    if (--node->multiplicity > 0) {
+        T data(node->data);
+        this->publish(this->current->count - 1);
+        return data;
+    }
+    T data(std::move(node->data));
+    if (node->left && node->right) {
+        // The successor is copied along and takes the place of the node.
+        Link * link = &node->right;
+        do {
+            this->own(*link);
+            this->path.push_back(*link);
+            link = &(*link)->left;
+        } while (*link);
+        PNode * successor = this->path.back().get();
+        node->key = successor->key;
+        node->data = std::move(successor->data);
+        node->multiplicity = successor->multiplicity;
+    }
+    size_t i = this->path.size() - 1;
+    Link target = this->path[i];
+    Link & child = target->left? target->left: target->right;
+    if (target->color == BLACK) {
+        if (color(child) == RED) {
+            this->own(child);
+            child->color = BLACK;
+        } else {
+            // The target takes the place of its NIL child while the tree is
+            // fixed, it's unlinked afterwards.
+            this->deleteCase1(i);
+        }
+    }
+    // The fix-up only moves nodes above the target, it's still the last one
+    // of the path.
+    this->linkOf(this->path.size() - 1) = target->left? target->left:
+        target->right;
+    this->publish(this->current->count - 1);
+    return data;
+}
+
+template<typename Key, typename T, typename Compare>
+void PersistentRBTree<Key, T, Compare>::deleteCase1(size_t i) {
+    if (i > 0) {
+        this->deleteCase2(i);
+    }
+}
+
+template<typename Key, typename T, typename Compare>
+void PersistentRBTree<Key, T, Compare>::deleteCase2(size_t i) {
+    Link & sibling = this->siblingOf(i);
+    if (color(sibling) == RED) {
+        this->own(sibling);
+        Link lifted = sibling;
+        this->path[i - 1]->color = RED;
+        lifted->color = BLACK;
+        if (this->isLeft(i)) {
+            this->rotateLeft(this->linkOf(i - 1));
+        } else {
+            this->rotateRight(this->linkOf(i - 1));
+        }
+        // The sibling is now above the parent.
+        this->path.insert(this->path.begin() + (i - 1), lifted);
+        ++i;
+    }
+    this->deleteCase3(i);
+}
+
+template<typename Key, typename T, typename Compare>
+void PersistentRBTree<Key, T, Compare>::deleteCase3(size_t i) {
+    Link & sibling = this->siblingOf(i);
+    if (this->path[i - 1]->color == BLACK &&
+        color(sibling) == BLACK &&
+        color(sibling->left) == BLACK &&
+        color(sibling->right) == BLACK) {
+        this->own(sibling);
+        sibling->color = RED;
+        this->deleteCase1(i - 1);
+    } else {
+        this->deleteCase4(i);
+    }
+}
+
+template<typename Key, typename T, typename Compare>
+void PersistentRBTree<Key, T, Compare>::deleteCase4(size_t i) {
+    Link & sibling = this->siblingOf(i);
+    if (this->path[i - 1]->color == RED &&
+        color(sibling) == BLACK &&
+        color(sibling->left) == BLACK &&
+        color(sibling->right) == BLACK) {
+        this->own(sibling);
+        sibling->color = RED;
+        this->path[i - 1]->color = BLACK;
+    } else {
+        this->deleteCase5(i);
+    }
+}
+
+template<typename Key, typename T, typename Compare>
+void PersistentRBTree<Key, T, Compare>::deleteCase5(size_t i) {
+    Link & sibling = this->siblingOf(i);
+    // The sibling is black here, case 2 made sure of it.
+    if (this->isLeft(i) &&
+        color(sibling->right) == BLACK &&
+        color(sibling->left) == RED) {
+        this->own(sibling);
+        this->own(sibling->left);
+        sibling->color = RED;
+        sibling->left->color = BLACK;
+        this->rotateRight(sibling);
+    } else if (!this->isLeft(i) &&
+        color(sibling->left) == BLACK &&
+        color(sibling->right) == RED) {
+        this->own(sibling);
+        this->own(sibling->right);
+        sibling->color = RED;
+        sibling->right->color = BLACK;
+        this->rotateLeft(sibling);
+    }
+    this->deleteCase6(i);
+}
+
+template<typename Key, typename T, typename Compare>
+void PersistentRBTree<Key, T, Compare>::deleteCase6(size_t i) {
+    Link & sibling = this->siblingOf(i);
+    this->own(sibling);
+    sibling->color = this->path[i - 1]->color;
+    this->path[i - 1]->color = BLACK;
+    if (this->isLeft(i)) {
+        this->own(sibling->right);
+        sibling->right->color = BLACK;
+        this->rotateLeft(this->linkOf(i - 1));
+    } else {
+        this->own(sibling->left);
+        sibling->left->color = BLACK;
+        this->rotateRight(this->linkOf(i - 1));
+    }
+}
+
+/******************************************************************************
+ *                                                                           **
+ * SNAPSHOT                                                                  **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare>
+const typename PersistentRBTree<Key, T, Compare>::PNode *
+PersistentRBTree<Key, T, Compare>::Snapshot::getRoot(void) const {
+    return this->version->root.get();
+}
+
+template<typename Key, typename T, typename Compare>
+size_t PersistentRBTree<Key, T, Compare>::Snapshot::size(void) const {
+    return this->version->count;
+}
+
+template<typename Key, typename T, typename Compare>
+const typename PersistentRBTree<Key, T, Compare>::PNode *
+PersistentRBTree<Key, T, Compare>::Snapshot::find(const Key & key) const {
+    const PNode * node = this->getRoot();
+    while (node != NULL) {
+        if (this->version->less(key, node->getKey())) {
+            node = node->getLeft();
+        } else if (this->version->less(node->getKey(), key)) {
+            node = node->getRight();
+        } else {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+template<typename Key, typename T, typename Compare>
+int PersistentRBTree<Key, T, Compare>::Snapshot::exists(const Key & key) const {
+    const PNode * node = this->find(key);
+    return node == NULL? 0: node->getMultiplicity();
+}
+
+template<typename Key, typename T, typename Compare>
+const typename PersistentRBTree<Key, T, Compare>::PNode *
+PersistentRBTree<Key, T, Compare>::Snapshot::first(void) const {
+    const PNode * node = this->getRoot();
+    while (node != NULL && node->getLeft() != NULL) node = node->getLeft();
+    return node;
+}
+
+template<typename Key, typename T, typename Compare>
+const typename PersistentRBTree<Key, T, Compare>::PNode *
+PersistentRBTree<Key, T, Compare>::Snapshot::last(void) const {
+    const PNode * node = this->getRoot();
+    while (node != NULL && node->getRight() != NULL) node = node->getRight();
+    return node;
+}
+
+template<typename Key, typename T, typename Compare>
+template<typename Function>
+size_t PersistentRBTree<Key, T, Compare>::Snapshot::for_each(Function fn) const {
+    // There are no parents to climb back to, the way down is kept instead.
+    std::vector<const PNode *> stack;
+    size_t visited = 0;
+    const PNode * node = this->getRoot();
+    while (node != NULL || !stack.empty()) {
+        while (node != NULL) {
+            stack.push_back(node);
+            node = node->getLeft();
+        }
+        node = stack.back();
+        stack.pop_back();
+        fn(*node);
+        ++visited;
+        node = node->getRight();
+    }
+    return visited;
+}
+
+template<typename Key, typename T, typename Compare>
+bool PersistentRBTree<Key, T, Compare>::Snapshot::validate(void) const {
+    const PNode * root = this->getRoot();
+    if (root != NULL && root->getColor() != BLACK) {
+        return false;
+    }
+    size_t elements = 0;
+    return this->check(root, NULL, NULL, &elements) >= 0 &&
+        elements == this->size();
+}
+
+template<typename Key, typename T, typename Compare>
+int PersistentRBTree<Key, T, Compare>::Snapshot::check(const PNode * node,
+    const PNode * low, const PNode * high, size_t * elements) const {
+    if (node == NULL) {
+        return 1;
+    }
+    if ((low != NULL && !this->version->less(low->getKey(), node->getKey())) ||
+        (high != NULL && !this->version->less(node->getKey(), high->getKey()))) {
+        return -1;
+    }
+    if (node->getColor() == RED &&
+        ((node->getLeft() != NULL && node->getLeft()->getColor() == RED) ||
+        (node->getRight() != NULL && node->getRight()->getColor() == RED))) {
+        return -1;
+    }
+    *elements += node->getMultiplicity();
+    int left = this->check(node->getLeft(), low, node, elements);
+    int right = this->check(node->getRight(), node, high, elements);
+    if (left < 0 || left != right) {
+        return -1;
+    }
+    return left + (node->getColor() == BLACK? 1: 0);
+}
+
+#endif
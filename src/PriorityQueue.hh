@@ -0,0 +1,172 @@
+#ifndef PRIORITYQUEUE_CLASS
+#define PRIORITYQUEUE_CLASS
+
+#include <stddef.h>//This gets NULL
+#include "RBTree.hh"
+
+template<typename Key, typename T, typename Compare = std::less<Key>,
+    typename Alloc = NodePool<Node<Key, T> > >
+/**
+ * @breif The PriorityQueue is a double ended priority queue over a RBTree,
+ *        the key of each element is its priority.
+ *
+ * The keys are ordered by Compare, the lowest priority goes first. The tree
+ * keeps its first and last nodes, so peeking takes O(1) and popping
+ * goes straight to the node instead of descending from the root. Like in the
+ * tree, elements with the same key and data are counted through the
+ * multiplicity, and an element with the key of another one but different
+ * data is rejected.
+ */
+class PriorityQueue{
+    private:
+        /**
+         * @breif The tree that holds the elements.
+         */
+        RBTree<Key, T, Compare, Alloc> tree;
+
+    public:
+        /**
+         * @breif Creates an empty queue.
+         */
+        PriorityQueue(void);
+
+        /**
+         * @breif Adds an element to the queue.
+         * @param key  The priority of the element.
+         * @param data The data of the element.
+         * @return True if the element was added.
+         */
+        bool push(const Key & key, const T & data);
+
+        /**
+         * @breif Adds an element to the queue, moving its data.
+         * @param key  The priority of the element.
+         * @param data The data of the element.
+         * @return True if the element was added.
+         */
+        bool push(const Key & key, T && data);
+
+        /**
+         * @breif Adds an element to the queue, building its data in place.
+         * @param key  The priority of the element.
+         * @param args The arguments for the constructor of the data.
+         * @return True if the element was added.
+         */
+        template<typename... Args>
+        bool emplace(const Key & key, Args &&... args);
+
+        /**
+         * @breif Takes out one element with the lowest priority.
+         * @return The data of the element, a default constructed one if the
+         *         queue is empty.
+         */
+        T pop_min(void);
+
+        /**
+         * @breif Takes out one element with the highest priority.
+         * @return The data of the element, a default constructed one if the
+         *         queue is empty.
+         */
+        T pop_max(void);
+
+        /**
+         * @breif Returns the node with the lowest priority, in O(1).
+         * @return The node, NULL if the queue is empty.
+         */
+        Node<Key, T> * peek_min(void);
+
+        /**
+         * @breif Returns the node with the highest priority, in O(1).
+         * @return The node, NULL if the queue is empty.
+         */
+        Node<Key, T> * peek_max(void);
+
+        /**
+         * @breif Returns how many elements are in the queue, multiplicities
+         *        included.
+         * @return The number of elements.
+         */
+        size_t size(void);
+
+        /**
+         * @breif Determines wether the queue is empty.
+         * @return True if there are no elements.
+         */
+        bool empty(void);
+
+        /**
+         * @breif Gets the tree under the queue.
+         * @return The tree.
+         */
+        RBTree<Key, T, Compare, Alloc> & getTree(void);
+};
+
+/******************************************************************************
+ *                                                                           **
+ * CLASS IMPLEMENTATION                                                      **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+PriorityQueue<Key, T, Compare, Alloc>::PriorityQueue(void) {
+    ;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool PriorityQueue<Key, T, Compare, Alloc>::push(const Key & key, const T & data) {
+    return this->tree.insert(key, data);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool PriorityQueue<Key, T, Compare, Alloc>::push(const Key & key, T && data) {
+    return this->tree.insert(key, std::move(data));
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+template<typename... Args>
+bool PriorityQueue<Key, T, Compare, Alloc>::emplace(const Key & key, Args &&... args) {
+    return this->tree.emplace(key, std::forward<Args>(args)...);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+T PriorityQueue<Key, T, Compare, Alloc>::pop_min(void) {
+    if (this->empty()) {
+        return T();
+    }
+    return this->tree.extract(this->tree.first());
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+T PriorityQueue<Key, T, Compare, Alloc>::pop_max(void) {
+    if (this->empty()) {
+        return T();
+    }
+    return this->tree.extract(this->tree.last());
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+Node<Key, T> * PriorityQueue<Key, T, Compare, Alloc>::peek_min(void) {
+    return this->tree.first();
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+Node<Key, T> * PriorityQueue<Key, T, Compare, Alloc>::peek_max(void) {
+    return this->tree.last();
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+size_t PriorityQueue<Key, T, Compare, Alloc>::size(void) {
+    return this->tree.size();
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool PriorityQueue<Key, T, Compare, Alloc>::empty(void) {
+    return this->tree.size() == 0;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+RBTree<Key, T, Compare, Alloc> & PriorityQueue<Key, T, Compare, Alloc>::getTree(void) {
+    return this->tree;
+}
+
+#endif
@@ -2,12 +2,94 @@
 #define RBTREE_CLASS
 
 #include <stddef.h>//This gets NULL
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "BloomFilter.hh"
 #include "Node.hh"
+#include "NodePool.hh"
+#include "KeyCompare.hh"
+#include "FrozenTree.hh"
+#include "Multiplicity.hh"
+#include "TreeIterator.hh"
+#include "TreeSnapshot.hh"
+#include "TreeStats.hh"
+#include "WorkPool.hh"
+
+/**
+ * RBTREE_CHECKED selects the validation policy. When it is 1, every insertion
+ * checks the nodes its fix-up went through, which keeps the insertion in
+ * O(log n), and a broken tree aborts the program whether NDEBUG is defined or
+ * not. When it is 0 nothing is checked. By default it follows assert, on
+ * unless NDEBUG is defined. validate() always runs the full audit.
+ */
+#ifndef RBTREE_CHECKED
+#ifdef NDEBUG
+#define RBTREE_CHECKED 0
+#else
+#define RBTREE_CHECKED 1
+#endif
+#endif
+
+/**
+ * @breif Tells which check of RBTREE_CHECKED failed, and aborts.
+ * @param check The check, as written.
+ * @param file  The file it's in.
+ * @param line  The line it's at.
+ */
+inline void rbtreeCheckFailed(const char * check, const char * file,
+    int line) {
+    fprintf(stderr, "%s:%d: red-black tree check failed: %s\n", file, line,
+        check);
+    abort();
+}
+
+#if RBTREE_CHECKED
+#define RBTREE_CHECK(check) \
+    ((check)? (void) 0: rbtreeCheckFailed(#check, __FILE__, __LINE__))
+#else
+#define RBTREE_CHECK(check)
+#endif
+
+/**
+ * RBTREE_STATS makes every tree count what its hot paths do: rotations, the
+ * insert cases taken, recolors, the comparisons and depth of the descents,
+ * node allocations and frees and the inserts that only raised a
+ * multiplicity. One of every RBTREE_STATS_SAMPLE inserts, lookups and
+ * extracts is timed into a latency histogram. stats() reads them. It is off
+ * unless defined to 1 before including the tree, and then the counting is
+ * not compiled at all.
+ */
+#ifndef RBTREE_STATS
+#define RBTREE_STATS 0
+#endif
+
+#ifndef RBTREE_STATS_SAMPLE
+#define RBTREE_STATS_SAMPLE 64
+#endif
+
+#if RBTREE_STATS
+#define RBTREE_COUNT(field, n) (this->statistics.field += (n))
+#define RBTREE_SAMPLE(histogram) \
+    LatencySample latencySample(this->statistics.histogram, RBTREE_STATS_SAMPLE)
+#else
+#define RBTREE_COUNT(field, n)
+#define RBTREE_SAMPLE(histogram)
+#endif
 
 
 using namespace std;
 
-template<typename T>
+template<typename Key, typename T, typename Compare = std::less<Key>,
+    typename Alloc = NodePool<Node<Key, T> > >
 /**
  * @breif The RBTree(Red-Black Tree) defines a collection of ordered
  *        elements of a multiset, each element is a node, with a given
@@ -24,15 +106,448 @@ template<typename T>
  *  	the same number of black nodes. The uniform number of black nodes in the
  *   	paths from root to leaves is called the black-height of the red–black
  *   	tree.
+ *
+ * The keys are ordered by Compare, two keys are the same key when neither
+ * goes before the other. When Compare has an is_transparent type, like
+ * std::less<>, keys of other types can be looked up without building a Key.
+ * A comparator with no state takes no space, see KeyCompare.hh.
+ *
+ * The nodes are created and destroyed by the allocator policy Alloc, by
+ * default a NodePool, see NodePool.hh for what a policy must provide.
  */
-class RBTree{
+class RBTree : private KeyCompare<Compare>{
+    public:
+        typedef TreeIterator<RBTree, Node<Key, T> > iterator;
+        typedef TreeIterator<RBTree, const Node<Key, T> > const_iterator;
+        typedef std::reverse_iterator<iterator> reverse_iterator;
+        typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
     private:
         /**
          * @breif The root of the tree, this is, the first element,
          *        this is the only one that needs to be known, since
          *        all the other ones are derived from this.
          */
-        Node<T> * root;
+        Node<Key, T> * root = NULL;
+
+        /**
+         * @breif The first node of the tree, kept so first() takes O(1).
+         */
+        Node<Key, T> * leftmost = NULL;
+
+        /**
+         * @breif The last node of the tree, kept so last() takes O(1).
+         */
+        Node<Key, T> * rightmost = NULL;
+
+        /**
+         * @breif How many elements the tree has, multiplicities included.
+         */
+        size_t count = 0;
+
+        /**
+         * @breif Wether count is right. A split() without order statistics
+         *        can't tell how many elements went each way, size() counts
+         *        them again.
+         */
+        bool countKnown = true;
+
+        /**
+         * @breif The node the last insertion touched, NULL if it's gone.
+         */
+        Node<Key, T> * finger = NULL;
+
+        /**
+         * @breif Wether insert() starts from the finger instead of the root.
+         */
+        bool fingerSearch = false;
+
+        /**
+         * @breif The filter find() asks before it descends, see
+         *        setBloomFilter().
+         */
+        BloomFilter bloom;
+
+        /**
+         * @breif Wether the filter is on.
+         */
+        bool bloomFilter = false;
+
+        /**
+         * @breif Wether the filter lacks keys, or holds too many gone ones,
+         *        and must be built again before it's asked.
+         */
+        bool bloomStale = true;
+
+        /**
+         * @breif How many nodes went away since the filter was built.
+         */
+        size_t bloomRemoved = 0;
+
+        /**
+         * @breif The counts bloomStats() gives.
+         */
+        BloomStats bloomCounts;
+
+        /**
+         * @breif Creates and destroys the nodes of the tree.
+         */
+        Alloc allocator;
+
+#if RBTREE_STATS
+        /**
+         * @breif What the tree did, see stats().
+         */
+        TreeStats statistics;
+#endif
+
+        /**
+         * @breif Destroys every node of the subtree whose root is the given
+         *        node.
+         * @param node The root of the subtree.
+         */
+        void destroy(Node<Key, T> * node);
+
+        /**
+         * @breif Descends from the root looking for a key.
+         * @param  key   The key to search for.
+         * @param  found Set to true if a node has the key.
+         * @return       The node with the key, else the node under which it
+         *               would hang, NULL if the tree is empty.
+         */
+        template<typename K>
+        Node<Key, T> * descend(const K & key, bool * found);
+
+        /**
+         * @breif Returns the hash of a key the Bloom filter takes.
+         */
+        static uint64_t bloomHash(const Key & key);
+
+        /**
+         * @breif Builds the Bloom filter from the nodes, sized for twice as
+         *        many.
+         */
+        void buildBloom(void);
+
+        /**
+         * @breif Looks for a key starting from a node of the tree. It climbs
+         *        only until the subtree holds the place of the key, then
+         *        descends. A key after the last node, or before the first
+         *        one, takes O(1) from there.
+         * @param  start The node to start from.
+         * @param  key   The key to search for.
+         * @param  found Set to true if a node has the key.
+         * @return       The node with the key, else the node under which it
+         *               would hang.
+         */
+        Node<Key, T> * fingerDescend(Node<Key, T> * start, const Key & key,
+            bool * found);
+
+        /**
+         * @breif Links a new node under the node descend() gave for its key,
+         *        and fixes the tree.
+         * @param node   The node to link.
+         * @param parent The node to hang it from, NULL if the tree is empty.
+         */
+        void attach(Node<Key, T> * node, Node<Key, T> * parent);
+
+        /**
+         * @breif Cuts a subtree into pieces for the parallel walks, in key
+         *        order. Down to the given depth every node is a piece of its
+         *        own, under it every subtree is a whole piece.
+         * @param node   The root of the subtree, may be NULL.
+         * @param depth  How many levels are cut.
+         * @param pieces Where the pieces are added, each one a node and true
+         *               if its whole subtree goes with it.
+         */
+        void splitPieces(Node<Key, T> * node, int depth,
+            std::vector<std::pair<Node<Key, T> *, bool> > & pieces);
+
+        /**
+         * @breif Returns how many levels are cut to get about eight pieces
+         *        per worker, none if there is a single worker.
+         * @param workers How many workers the pieces are for.
+         * @return The depth of the cut.
+         */
+        static int splitDepth(size_t workers);
+
+        /**
+         * @breif Cuts the whole tree into about eight pieces per worker, or
+         *        one piece if there is a single worker.
+         * @param workers How many workers the pieces are for.
+         * @param pieces  Where the pieces are added.
+         */
+        void splitPieces(size_t workers,
+            std::vector<std::pair<Node<Key, T> *, bool> > & pieces);
+
+        /**
+         * @breif Returns the black-height of a subtree, the black nodes from
+         *        its root down to a NIL leaf. Takes O(log n).
+         * @param node The root of the subtree, may be NULL.
+         * @return The black-height, 0 for NULL.
+         */
+        int blackHeight(Node<Key, T> * node);
+
+        /**
+         * @breif Joins two subtrees with a node whose key goes between them.
+         *        The lower one hangs from the spine of the higher one, where
+         *        the black-height is the same, and the tree is fixed from
+         *        there, so it takes O(1 + the difference of black-heights).
+         *        The roots of the subtrees must be black. The root of the
+         *        tree is used while the result is fixed.
+         * @param left        The subtree with the lower keys, may be NULL.
+         * @param leftHeight  Its black-height.
+         * @param middle      The node between them, unlinked.
+         * @param right       The subtree with the higher keys, may be NULL.
+         * @param rightHeight Its black-height.
+         * @param height      Where the black-height of the result is written.
+         * @return The root of the result, black.
+         */
+        Node<Key, T> * joinNodes(Node<Key, T> * left, int leftHeight,
+            Node<Key, T> * middle, Node<Key, T> * right, int rightHeight,
+            int * height);
+
+        /**
+         * @breif Splits a subtree into the nodes whose keys go before a key
+         *        and the rest. Every node on the way down is joined with the
+         *        subtree it leaves aside, and the black-heights of those
+         *        joins add up to O(log n).
+         * @param node       The root of the subtree, black, may be NULL.
+         * @param height     Its black-height.
+         * @param key        The key to split at.
+         * @param low        Where the root of the lower part is written.
+         * @param lowHeight  Where its black-height is written.
+         * @param high       Where the root of the higher part is written.
+         * @param highHeight Where its black-height is written.
+         */
+        void splitNode(Node<Key, T> * node, int height, const Key & key,
+            Node<Key, T> ** low, int * lowHeight, Node<Key, T> ** high,
+            int * highHeight, Node<Key, T> ** match = NULL);
+
+        /**
+         * @breif Takes the root off a subtree, its children become roots of
+         *        their own and a red one turns black.
+         * @param node        The root, black.
+         * @param height      Its black-height.
+         * @param left        Where the left child is written.
+         * @param leftHeight  Where its black-height is written.
+         * @param right       Where the right child is written.
+         * @param rightHeight Where its black-height is written.
+         */
+        void expose(Node<Key, T> * node, int height, Node<Key, T> ** left,
+            int * leftHeight, Node<Key, T> ** right, int * rightHeight);
+
+        /**
+         * @breif Takes the last node off a subtree, in O(log n).
+         * @param node       The root of the subtree, black, not NULL.
+         * @param height     Its black-height.
+         * @param rest       Where the root of the rest is written.
+         * @param restHeight Where its black-height is written.
+         * @return The last node, unlinked.
+         */
+        Node<Key, T> * splitLast(Node<Key, T> * node, int height,
+            Node<Key, T> ** rest, int * restHeight);
+
+        /**
+         * @breif Joins two subtrees without a node between them, the last
+         *        node of the left one is taken off to be that node.
+         * @param left        The subtree with the lower keys, may be NULL.
+         * @param leftHeight  Its black-height.
+         * @param right       The subtree with the higher keys, may be NULL.
+         * @param rightHeight Its black-height.
+         * @param height      Where the black-height of the result is written.
+         * @return The root of the result.
+         */
+        Node<Key, T> * joinTwo(Node<Key, T> * left, int leftHeight,
+            Node<Key, T> * right, int rightHeight, int * height);
+
+        /**
+         * @breif The set operations mergeNodes() knows.
+         */
+        enum SetOperation {UNION, INTERSECTION, DIFFERENCE};
+
+        /**
+         * @breif Decides what is left of a key a set operation found in the
+         *        other tree, and maybe in this one.
+         * @param match    The node of this tree with the key, may be NULL.
+         * @param theirs   The node of the other tree.
+         * @param operation The set operation.
+         * @param policy   How the multiplicities are merged.
+         * @param dropped  Where the nodes left out are added.
+         * @return The node that stays, NULL if none does.
+         */
+        Node<Key, T> * mergeMiddle(Node<Key, T> * match, Node<Key, T> * theirs,
+            SetOperation operation, Multiplicities policy,
+            std::vector<Node<Key, T> *> & dropped);
+
+        /**
+         * @breif Merges a subtree of another tree into a subtree of this one.
+         *        The other subtree is taken apart node by node, this one is
+         *        split at their keys, and the parts are merged and joined
+         *        back, which takes O(m log(n / m + 1)) for subtrees of m and
+         *        n nodes, m <= n. The nodes left out are not destroyed, they
+         *        are added to a list. The root of the tree is used while
+         *        the result is fixed.
+         * @param mine         The subtree of this tree, may be NULL.
+         * @param mineHeight   Its black-height.
+         * @param theirs       The subtree of the other tree, may be NULL.
+         * @param theirsHeight Its black-height.
+         * @param operation    The set operation.
+         * @param policy       How the multiplicities are merged.
+         * @param height       Where the black-height of the result is written.
+         * @param dropped      Where the nodes left out are added.
+         * @return The root of the result.
+         */
+        Node<Key, T> * mergeNodes(Node<Key, T> * mine, int mineHeight,
+            Node<Key, T> * theirs, int theirsHeight, SetOperation operation,
+            Multiplicities policy, int * height,
+            std::vector<Node<Key, T> *> & dropped);
+
+        /**
+         * @breif Adds every node of a subtree to a list.
+         * @param node    The root of the subtree, may be NULL.
+         * @param dropped The list.
+         */
+        void dropSubtree(Node<Key, T> * node,
+            std::vector<Node<Key, T> *> & dropped);
+
+        /**
+         * @breif Takes a subtree apart down to a depth, see splitPieces().
+         * @param node   The root of the subtree, black, may be NULL.
+         * @param height Its black-height.
+         * @param depth  How many levels are taken apart.
+         * @param pieces Where the subtrees left are added, with their
+         *               black-heights, in key order.
+         * @param pivots Where the nodes taken off are added, pivot i goes
+         *               between the pieces i and i + 1.
+         */
+        void explode(Node<Key, T> * node, int height, int depth,
+            std::vector<std::pair<Node<Key, T> *, int> > & pieces,
+            std::vector<Node<Key, T> *> & pivots);
+
+        /**
+         * @breif Runs a set operation with the nodes of another tree, which
+         *        is left empty. The top of the other tree is taken apart,
+         *        this tree is split at the keys of the nodes taken off, and
+         *        the pairs of pieces are merged on a WorkPool, each on a
+         *        scratch tree so they don't share a root. The nodes left out
+         *        are destroyed afterwards, from this thread.
+         * @param other     The other tree.
+         * @param operation The set operation.
+         * @param policy    How the multiplicities are merged.
+         * @param pool      The pool the pieces are merged on.
+         */
+        void mergeTree(RBTree & other, SetOperation operation,
+            Multiplicities policy, WorkPool & pool);
+
+        /**
+         * @breif Calls a function on every node of a piece, in key order.
+         * @param piece The piece, see splitPieces().
+         * @param fn    The function, called with a Node<Key, T> &.
+         * @return How many nodes were visited.
+         */
+        template<typename Function>
+        size_t walkPiece(const std::pair<Node<Key, T> *, bool> & piece,
+            Function && fn);
+
+        /**
+         * @breif Finds the first node whose key doesn't go before a key.
+         * @param  key The reference key.
+         * @return     The node, NULL if there is none.
+         */
+        template<typename K>
+        Node<Key, T> * lowerNode(const K & key) const;
+
+        /**
+         * @breif Finds the first node whose key goes after a key.
+         * @param  key The reference key.
+         * @return     The node, NULL if there is none.
+         */
+        template<typename K>
+        Node<Key, T> * upperNode(const K & key) const;
+
+        /**
+         * @breif Computes the weight of a node again, with order statistics,
+         *        else does nothing.
+         * @param node The node whose children changed.
+         */
+        void recount(Node<Key, T> * node);
+
+        /**
+         * @breif Computes the weight of every node of a subtree again, with
+         *        order statistics, else does nothing.
+         * @param node The root of the subtree.
+         */
+        void recountSubtree(Node<Key, T> * node);
+
+        /**
+         * @breif Returns the weight of a subtree, 0 for a NIL leaf.
+         * @param node The root of the subtree, may be NULL.
+         */
+        size_t weight(Node<Key, T> * node);
+
+        /**
+         * @breif Links a range of sorted nodes as a perfectly balanced
+         *        subtree.
+         * @param nodes The nodes, sorted by key.
+         * @param low   The first node of the range.
+         * @param high  Past the last node of the range.
+         * @param depth The depth of the root of the subtree.
+         * @param red   The depth whose nodes are red, -1 if none.
+         * @return The root of the subtree.
+         */
+        static Node<Key, T> * buildBalanced(std::vector<Node<Key, T> *> & nodes,
+            size_t low, size_t high, int depth, int red);
+
+        /**
+         * @breif Makes an empty tree of sorted nodes, laid as a perfectly
+         *        balanced tree whose incomplete lowest level is red, in O(n)
+         *        and without comparing keys.
+         * @param nodes The nodes, sorted by key, black and with their
+         *              multiplicities set.
+         */
+        void layBalanced(std::vector<Node<Key, T> *> & nodes);
+
+        /**
+         * @breif Returns the multiplicity of a record given to build_sorted,
+         *        which is its third field.
+         */
+        template<typename R>
+        static int recordMultiplicity(const R & record, std::true_type);
+
+        /**
+         * @breif Returns the multiplicity of a record with no third field,
+         *        which is 1.
+         */
+        template<typename R>
+        static int recordMultiplicity(const R & record, std::false_type);
+
+        /**
+         * @breif Inserts a key-data pair, the node is only created, copying
+         *        or moving the data, when the pair is not in the tree.
+         * @param hint The node to start looking from, NULL for the root, or
+         *             for the last node in finger search.
+         * @param key  The key value to insert.
+         * @param data The data to insert.
+         */
+        template<typename D>
+        bool insertData(Node<Key, T> * hint, const Key & key, D && data);
+
+        /**
+         * @breif Inserts a node of the allocator, which is destroyed when
+         *        it's not linked into the tree.
+         * @param node The node to insert.
+         */
+        bool insertNode(Node<Key, T> * node);
+
+        /**
+         * @breif Tells wether Compare allows looking up keys of type K.
+         */
+        template<typename K, typename C>
+        using Transparent = typename std::enable_if<
+            !std::is_same<K, Key>::value &&
+            !std::is_convertible<K, Node<Key, T> *>::value,
+            typename C::is_transparent>::type;
 
     public:
         /**
@@ -41,13 +556,15 @@ class RBTree{
          * @param key The root nodes key.
          * @param data The root nodes data.
          */
-        RBTree(int key, T data);
+        RBTree(const Key & key, const T & data);
 
         /**
-         * @breif Creates a red-black tree with the root Node being the given.
+         * @breif Creates a red-black tree with the key and data of the given
+         *        Node at the root. The node must be made with new, its key
+         *        and data go into a node of the allocator and it's deleted.
          * @param node The root nodes.
          */
-        RBTree(Node<T> * node);
+        RBTree(Node<Key, T> * node);
 
         /**
          * @breif Creates a red-black tree with empty root Node.
@@ -55,47 +572,259 @@ class RBTree{
         RBTree(void);
 
         /**
-         * @breif Destructs the Tree.
+         * @breif Creates an empty red-black tree with a given comparator.
+         * @param compare The comparator of the keys.
+         */
+        explicit RBTree(const Compare & compare);
+
+        /**
+         * @breif Returns the comparator of the keys.
+         * @return The comparator.
+         */
+        const Compare & getCompare(void) const;
+
+        /**
+         * @breif Destructs the Tree and all of its nodes.
          */
         ~RBTree(void);
 
+        RBTree(const RBTree & other) = delete;
+        RBTree & operator=(const RBTree & other) = delete;
+
+        /**
+         * @breif Creates a tree taking the nodes of another one, which is left
+         *        empty.
+         * @param other The tree to take the nodes from.
+         */
+        RBTree(RBTree && other);
+
+        /**
+         * @breif Removes the nodes of the tree and takes the ones of another
+         *        tree, which is left empty.
+         * @param other The tree to take the nodes from.
+         */
+        RBTree & operator=(RBTree && other);
+
+        /**
+         * @breif Builds a tree from records sorted by key, in O(n). The
+         *        records are std::pair<Key, T> or std::tuple<Key, T, int>,
+         *        the third field being the multiplicity. Adjacent records
+         *        with the same key and data are collapsed into one node, a
+         *        record with the key of the previous one but other data is
+         *        dropped, as insert() would reject it. The nodes are laid as
+         *        a perfectly balanced tree whose incomplete lowest level is
+         *        red. Records out of order are inserted one by one after the
+         *        build.
+         * @param first   The first record.
+         * @param last    Past the last record.
+         * @param compare The comparator of the keys.
+         * @return The built tree.
+         */
+        template<typename Iterator>
+        static RBTree build_sorted(Iterator first, Iterator last,
+            const Compare & compare = Compare());
+
+        /**
+         * @breif Splits the tree at a key, in O(log n). The nodes whose keys
+         *        go before the key stay, the rest are moved to the returned
+         *        tree, both trees are valid red-black trees. No node is
+         *        copied, the allocators of both trees share their nodes from
+         *        then on. Without order statistics the size of each part is
+         *        counted by the next size().
+         * @param key The key to split at, it goes to the returned tree.
+         * @return The tree with the keys from the given one on.
+         */
+        RBTree split(const Key & key);
+
+        /**
+         * @breif Moves the nodes of a tree whose keys all go after the ones
+         *        of this tree to the end of this one, in O(log n). The other
+         *        tree is left empty and its allocator shares its nodes with
+         *        this one.
+         * @param right The tree to take the nodes from.
+         * @return False, and both trees left as they are, if the keys of
+         *         the trees overlap.
+         */
+        bool join(RBTree & right);
+
+        /**
+         * @breif Adds the elements of another tree. A key of both trees keeps
+         *        the node of this one, with the multiplicities merged by the
+         *        policy, a key of one tree keeps its node. When the data of
+         *        a key differs between the trees, the element of the other
+         *        tree is rejected like insert() does, and this one is kept as
+         *        it was. The nodes of the
+         *        other tree are moved, it's left empty. Takes
+         *        O(m log(n / m + 1)) for trees of m and n nodes, m <= n, the
+         *        top of the work is cut in pieces that run on several
+         *        threads, see parallel_for_each().
+         * @param other   The other tree.
+         * @param policy  How the multiplicities of a key of both trees are
+         *                merged.
+         * @param threads How many threads, 0 for one per hardware thread.
+         *                They are started and joined by the call, pass a
+         *                WorkPool instead to keep them between calls.
+         * @return False, and nothing done, if the other tree is this one.
+         */
+        bool union_with(RBTree & other,
+            Multiplicities policy = SUM_MULTIPLICITY, size_t threads = 0);
+
+        /**
+         * @breif Adds the elements of another tree from the threads of a
+         *        pool, see union_with().
+         * @param other  The other tree.
+         * @param policy How the multiplicities of a key of both trees are
+         *               merged.
+         * @param pool   The pool, which runs one batch at a time, so no other
+         *               thread may use it until the call returns.
+         * @return False, and nothing done, if the other tree is this one.
+         */
+        bool union_with(RBTree & other, Multiplicities policy,
+            WorkPool & pool);
+
+        /**
+         * @breif Keeps only the keys that are in another tree too, with the
+         *        multiplicities merged by the policy, see union_with(). A
+         *        key whose data differs between the trees is not the same
+         *        element, so it goes away. The other tree is left empty.
+         * @param other   The other tree.
+         * @param policy  How the multiplicities of a key of both trees are
+         *                merged.
+         * @param threads How many threads, 0 for one per hardware thread.
+         * @return False, and nothing done, if the other tree is this one.
+         */
+        bool intersect_with(RBTree & other,
+            Multiplicities policy = MIN_MULTIPLICITY, size_t threads = 0);
+
+        /**
+         * @breif Keeps only the keys that are in another tree too, from the
+         *        threads of a pool, see intersect_with() and union_with().
+         * @param other  The other tree.
+         * @param policy How the multiplicities of a key of both trees are
+         *               merged.
+         * @param pool   The pool.
+         * @return False, and nothing done, if the other tree is this one.
+         */
+        bool intersect_with(RBTree & other, Multiplicities policy,
+            WorkPool & pool);
+
+        /**
+         * @breif Takes away the elements of another tree, the multiplicity
+         *        of a key of both trees is reduced by the one in the other
+         *        tree and the node goes away if nothing is left, see
+         *        union_with(). A key whose data differs between the trees is
+         *        not the same element, so it's left as it is. The other tree
+         *        is left empty.
+         * @param other   The other tree.
+         * @param threads How many threads, 0 for one per hardware thread.
+         * @return False, and nothing done, if the other tree is this one.
+         */
+        bool difference_with(RBTree & other, size_t threads = 0);
+
+        /**
+         * @breif Takes away the elements of another tree, from the threads
+         *        of a pool, see difference_with() and union_with().
+         * @param other The other tree.
+         * @param pool  The pool.
+         * @return False, and nothing done, if the other tree is this one.
+         */
+        bool difference_with(RBTree & other, WorkPool & pool);
+
+        /**
+         * @breif Writes the tree to a file: a versioned header with the
+         *        number of elements, every node in key order as its key,
+         *        multiplicity and data, and a checksum. The file is written aside and renamed over the
+         *        path, a failed save leaves the old file as it was.
+         * @param path       The path of the file.
+         * @param serializer Writes the keys and the data, see RawSerializer,
+         *                   which takes trivially copyable types only.
+         * @return False if the file couldn't be written.
+         */
+        template<typename Serializer = RawSerializer>
+        bool save(const char * path, Serializer serializer = Serializer());
+
+        /**
+         * @breif Replaces the nodes of the tree with the ones of a file
+         *        written by save(). The nodes are read in key order and laid
+         *        in O(n), without comparing keys or rebalancing. Key and T
+         *        must be default constructible.
+         * @param path       The path of the file.
+         * @param serializer Reads the keys and the data, it must match the
+         *                   one that wrote the file.
+         * @return False, and the tree left as it was, if the file can't be
+         *         read, isn't a tree of these types, or its checksum is
+         *         wrong.
+         */
+        template<typename Serializer = RawSerializer>
+        bool load(const char * path, Serializer serializer = Serializer());
+
+        /**
+         * @breif Copies the tree to a FrozenTree, an immutable array laid
+         *        out for lookups that answers them faster than the nodes, in
+         *        O(n). The tree is left as it is.
+         * @return The frozen copy, with the multiplicities of the tree.
+         */
+        template<int Width = frozenWidth<Key>()>
+        FrozenTree<Key, T, Compare, Width> freeze(void) const;
+
+        /**
+         * @breif Removes every node of the tree. When the allocator can free
+         *        all of its nodes in one step and the data doesn't need to be
+         *        destructed, the nodes are not visited at all.
+         */
+        void clear(void);
+
+        /**
+         * @breif Gets the allocator which creates the nodes of the tree.
+         * @return The tree's allocator.
+         */
+        Alloc & getAllocator(void);
+
         /**
          * @breif Gets the root node.
          * @return The tree's root node.
          */
-        Node<T> * getRoot(void);
+        Node<Key, T> * getRoot(void);
 
         /**
-         * @breif Sets the root node.
+         * @breif Sets the root node. The first and last nodes and the size
+         *        are found again, which takes O(n).
          * @param rootNode The tree's root node.
          */
-        void setRoot(Node<T> * rootNode);
+        void setRoot(Node<Key, T> * rootNode);
+
+        /**
+         * @breif Returns how many elements the tree has, this is, the sum of
+         *        the multiplicities of its nodes.
+         * @return The number of elements.
+         */
+        size_t size(void);
 
         /**
          * Replaces a node.
          * @param oldNode The node to remove.
          * @param newNode The node to place.
          */
-        void replaceNode(Node<T> *oldNode, Node<T> * newNode);
+        void replaceNode(Node<Key, T> *oldNode, Node<Key, T> * newNode);
 
         /**
          * @breif Makes a left rotation on a given node.
          * @param node The pivot.
          */
-        void rotateLeft(Node<T> * rootPivot);
+        void rotateLeft(Node<Key, T> * rootPivot);
 
         /**
          * @breif Makes a right rotation on a given node.
          * @param rbt The tree to rotate.
          * @param node The pivot.
          */
-        void rotateRight(Node<T> * rootPivot);
+        void rotateRight(Node<Key, T> * rootPivot);
 
         /**
          * Checks 1st rbtree rule on a node.
          * @param  node Node to check.
          */
-        bool rule1(Node<T> * node);
+        bool rule1(Node<Key, T> * node);
 
         /**
          * Checks 1st rbtree rule on the tree.
@@ -111,7 +840,7 @@ class RBTree{
          * Checks 4th rbtree rule on a node.
          * @param  node Node to check.
          */
-        bool rule4(Node<T> * node);
+        bool rule4(Node<Key, T> * node);
 
         /**
          * Checks 4th rbtree rule on the tree.
@@ -122,7 +851,7 @@ class RBTree{
          * Checks 5th rbtree rule on a node.
          * @param  node Node to check.
          */
-        bool rule5(Node<T> * rootNode);
+        bool rule5(Node<Key, T> * rootNode);
 
         /**
          * Checks 5th rbtree rule on a node.
@@ -130,7 +859,7 @@ class RBTree{
          * @param  blackCount how many black nodes.
          * @param  pathCount The black nodes height.
          */
-        bool rule5(Node<T> * rootNode, int blackCount, int * pathCount);
+        bool rule5(Node<Key, T> * rootNode, int blackCount, int * pathCount);
 
         /**
          * Checks 5th rbtree rule on the tree.
@@ -144,98 +873,345 @@ class RBTree{
         bool rules(void);
 
         /**
-         * @breif Determines wether an element exists in the tree, if
-         *        it does, the function returns the multiplicity of the
-         *        element, else it will return 0.
-         * @param  data The data to search for.
-         * @return      The multiplicity of the element, 0 meaning the
-         *              element was not found.
+         * @breif Checks that the keys grow from first() to last(), that
+         *        every child knows its parent and that the first and last
+         *        nodes and the size kept by the tree are right.
+         * @return  True if the tree is ordered.
          */
-        int exists(int key);
+        bool ordered(void);
 
         /**
-         * @breif Extracts an element from the tree if it's found.
-         * @param  data The data to extract.
-         * @return      The extracted data.
+         * @breif Runs the full audit of the tree, all the rules and the
+         *        order. Takes O(n).
+         * @return  True if the tree is correct.
          */
-        T extract(int key);
+        bool validate(void);
 
         /**
-         * @breif Returns the next element in the tree.
-         * @param node  The reference node.
-         * @return      The node following the reference node.
+         * @breif Checks the nodes an insertion fix-up may have touched, that
+         *        is, the nodes from the given one to the root, their children
+         *        and grandchildren. Takes O(log n).
+         * @param node The inserted node.
+         * @return  True if no broken rule was found around the path.
          */
-        Node<T> * next(Node<T> * node);
+        bool checkPath(Node<Key, T> * node);
+
         /**
-         * @breif Returns the previous element in the tree.
-         * @param node  The reference node.
-         * @return      The node preceding the reference node.
+         * @breif Checks a node against its children, red nodes must have
+         *        black children, the children must know their parent and
+         *        be on the right side of the key.
+         * @param node The node to check, may be NULL.
+         * @return  True if the node is correct.
          */
-        Node<T> * previous(Node<T> * node);
+        bool checkNode(Node<Key, T> * node);
 
         /**
-         * @breif The first element of the subtree whose root is the given node.
-         * @param node The root of the subtree.
-         * @return The first node of the subtree.
+         * @breif Finds the node of a given key.
+         * @param  key The key to search for.
+         * @return     The node with the key, NULL if it's not in the tree.
          */
-        Node<T> * first(Node<T> * node);
+        Node<Key, T> * find(const Key & key);
 
         /**
-         * @breif The first element of the tree.
-         * @return The first node of the tree.
+         * @breif Finds the node of a key of another type, only when Compare
+         *        is transparent. No Key is built.
+         * @param  key The key to search for.
+         * @return     The node with the key, NULL if it's not in the tree.
          */
-        Node<T> * first();
+        template<typename K, typename C = Compare, typename = Transparent<K, C> >
+        Node<Key, T> * find(const K & key);
 
         /**
-         * @breif The last element of the subtree whose root is the given node.
-         * @param node The root of the subtree.
-         * @return The last node of the subtree.
+         * @breif Determines wether an element exists in the tree, if
+         *        it does, the function returns the multiplicity of the
+         *        element, else it will return 0.
+         * @param  data The data to search for.
+         * @return      The multiplicity of the element, 0 meaning the
+         *              element was not found.
          */
-        Node<T> * last(Node<T> * node);
+        int exists(const Key & key);
 
         /**
-         * @breif The last element of the tree.
-         * @return The last node of the tree.
+         * @breif Determines wether a key of another type exists in the
+         *        tree, only when Compare is transparent.
+         * @param  key The key to search for.
+         * @return     The multiplicity of the element, 0 if not found.
          */
-        Node<T> * last();
+        template<typename K, typename C = Compare, typename = Transparent<K, C> >
+        int exists(const K & key);
+
+        /**
+         * @breif Extracts an element from the tree if it's found. When the
+         *        multiplicity of the element reaches 0 its node is deleted
+         *        and given back to the allocator.
+         * @param  data The data to extract.
+         * @return      The extracted data, a default constructed one if the
+         *              key is not in the tree.
+         */
+        T extract(const Key & key);
+
+        /**
+         * @breif Extracts an element given a key of another type, only when
+         *        Compare is transparent.
+         * @param  key The key to search for.
+         * @return     The extracted data, a default constructed one if the
+         *             key is not in the tree.
+         */
+        template<typename K, typename C = Compare, typename = Transparent<K, C> >
+        T extract(const K & key);
+
+        /**
+         * @breif Extracts an element from a given node of the tree, no search
+         *        is needed. When the multiplicity reaches 0 the node is
+         *        deleted.
+         * @param  node The node to extract from.
+         * @return      The extracted data.
+         */
+        T extract(Node<Key, T> * node);
+
+#if RBTREE_ORDER_STATISTICS
+        /**
+         * @breif Returns how many elements have a key that goes before the
+         *        given one, multiplicities included. Takes O(log n).
+         * @param  key The reference key.
+         * @return     The number of elements before the key.
+         */
+        size_t rank(const Key & key);
+
+        /**
+         * @breif Returns the node that holds the i-th element, counting from
+         *        0 and including multiplicities. Takes O(log n).
+         * @param  i The position of the element.
+         * @return   The node, NULL if i is not lesser than size().
+         */
+        Node<Key, T> * select(size_t i);
+
+        /**
+         * @breif Returns how many elements have a key from low, included, to
+         *        high, not included. Takes O(log n).
+         * @param  low  The lowest key of the range.
+         * @param  high The key after the range.
+         * @return      The number of elements in the range.
+         */
+        size_t count_range(const Key & low, const Key & high);
+#endif
+
+        /**
+         * @breif Returns the next element in the tree.
+         * @param node  The reference node.
+         * @return      The node following the reference node.
+         */
+        Node<Key, T> * next(Node<Key, T> * node) const;
+        /**
+         * @breif Returns the previous element in the tree.
+         * @param node  The reference node.
+         * @return      The node preceding the reference node.
+         */
+        Node<Key, T> * previous(Node<Key, T> * node) const;
+
+        /**
+         * @breif The first element of the subtree whose root is the given node.
+         * @param node The root of the subtree.
+         * @return The first node of the subtree.
+         */
+        Node<Key, T> * first(Node<Key, T> * node) const;
+
+        /**
+         * @breif The first element of the tree, takes O(1).
+         * @return The first node of the tree.
+         */
+        Node<Key, T> * first() const;
+
+        /**
+         * @breif The last element of the subtree whose root is the given node.
+         * @param node The root of the subtree.
+         * @return The last node of the subtree.
+         */
+        Node<Key, T> * last(Node<Key, T> * node) const;
+
+        /**
+         * @breif The last element of the tree, takes O(1).
+         * @return The last node of the tree.
+         */
+        Node<Key, T> * last() const;
+
+        /**
+         * @breif Returns an iterator on the first node.
+         */
+        iterator begin(void);
+        const_iterator begin(void) const;
+        const_iterator cbegin(void) const;
+
+        /**
+         * @breif Returns the past the end iterator.
+         */
+        iterator end(void);
+        const_iterator end(void) const;
+        const_iterator cend(void) const;
+
+        /**
+         * @breif Returns a reverse iterator on the last node.
+         */
+        reverse_iterator rbegin(void);
+        const_reverse_iterator rbegin(void) const;
+
+        /**
+         * @breif Returns the reverse iterator past the first node.
+         */
+        reverse_iterator rend(void);
+        const_reverse_iterator rend(void) const;
+
+        /**
+         * @breif Returns an iterator on the first node whose key doesn't go
+         *        before the given one. Takes O(log n).
+         * @param  key The reference key.
+         * @return     The iterator, end() if there is no such node.
+         */
+        iterator lower_bound(const Key & key);
+        const_iterator lower_bound(const Key & key) const;
+
+        /**
+         * @breif Returns an iterator on the first node whose key goes after
+         *        the given one. Takes O(log n).
+         * @param  key The reference key.
+         * @return     The iterator, end() if there is no such node.
+         */
+        iterator upper_bound(const Key & key);
+        const_iterator upper_bound(const Key & key) const;
+
+        /**
+         * @breif Returns the range of nodes with the given key, that is, at
+         *        most one node since equal keys share their node.
+         * @param  key The reference key.
+         * @return     The lower and upper bounds of the key.
+         */
+        std::pair<iterator, iterator> equal_range(const Key & key);
+        std::pair<const_iterator, const_iterator> equal_range(
+            const Key & key) const;
+
+        /**
+         * @breif Calls a function on every node whose key is from low,
+         *        included, to high, not included. The tree is descended once
+         *        to find low, then walked from node to node.
+         * @param low  The lowest key of the range.
+         * @param high The key after the range.
+         * @param fn   The function, called with a Node<Key, T> &.
+         * @return How many nodes were visited.
+         */
+        template<typename Function>
+        size_t for_each_in_range(const Key & low, const Key & high,
+            Function fn);
+
+        /**
+         * @breif Calls a function on every node from several threads. The
+         *        levels near the root are cut into about eight pieces per
+         *        thread, each a node or a whole subtree, and the pieces are
+         *        run on a WorkPool, so a thread that ends early steals the
+         *        pieces of the others. fn runs on many nodes at once and in
+         *        no given order, it may change the data but not the tree.
+         * @param fn      The function, called with a Node<Key, T> &.
+         * @param threads How many threads, 0 for one per hardware thread.
+         *                They are started and joined by the call, pass a
+         *                WorkPool instead to keep them between calls.
+         * @return How many nodes were visited.
+         */
+        template<typename Function>
+        size_t parallel_for_each(Function fn, size_t threads = 0);
+
+        /**
+         * @breif Calls a function on every node from the threads of a pool,
+         *        see parallel_for_each().
+         * @param fn   The function, called with a Node<Key, T> &.
+         * @param pool The pool, which runs one batch at a time, so no other
+         *             thread may use it until the call returns.
+         * @return How many nodes were visited.
+         */
+        template<typename Function>
+        size_t parallel_for_each(Function fn, WorkPool & pool);
+
+        /**
+         * @breif Maps every node to a value and combines the values, from
+         *        several threads, cutting the tree as parallel_for_each()
+         *        does. combine must be associative. When ordered is true
+         *        the values are combined in key order, as a walk from
+         *        first() to last() would, else in any order, which lets
+         *        every thread fold its pieces into one value and needs a
+         *        commutative combine.
+         * @param init    The value the values of the nodes are combined to.
+         * @param map     The function that gives the value of a node, called
+         *                with a const Node<Key, T> &.
+         * @param combine The function that combines two values.
+         * @param ordered True to combine in key order.
+         * @param threads How many threads, 0 for one per hardware thread.
+         *                They are started and joined by the call, pass a
+         *                WorkPool instead to keep them between calls.
+         * @return init combined with the value of every node.
+         */
+        template<typename Result, typename Map, typename Combine>
+        Result parallel_reduce(Result init, Map map, Combine combine,
+            bool ordered = true, size_t threads = 0);
+
+        /**
+         * @breif Maps every node to a value and combines the values, from the
+         *        threads of a pool, see parallel_reduce().
+         * @param init    The value the values of the nodes are combined to.
+         * @param map     The function that gives the value of a node.
+         * @param combine The function that combines two values.
+         * @param ordered True to combine in key order.
+         * @param pool    The pool, which runs one batch at a time, so no
+         *                other thread may use it until the call returns.
+         * @return init combined with the value of every node.
+         */
+        template<typename Result, typename Map, typename Combine>
+        Result parallel_reduce(Result init, Map map, Combine combine,
+            bool ordered, WorkPool & pool);
 
         /**
          * @breif Returns the other parents child.
          * @param node The reference node.
          * @return The reference nodes sibling.
          */
-        Node<T> * sibling(Node<T> * node);
+        Node<Key, T> * sibling(Node<Key, T> * node);
+
+        /**
+         * @breif Returns the color of a node, NIL leaves are black.
+         * @param node The reference node, may be NULL.
+         * @return The color of the node.
+         */
+        Colors color(Node<Key, T> * node);
 
         /**
          * @breif Returns nodes parent.
          * @param node The reference node.
          * @return The reference nodes parent.
          */
-        Node<T> * parent(Node<T> * node);
+        Node<Key, T> * parent(Node<Key, T> * node);
 
         /**
          * @breif Returns nodes grandparent.
          * @param node The reference node.
          * @return The reference nodes grandparent.
          */
-        Node<T> * grandpa(Node<T> * node);
+        Node<Key, T> * grandpa(Node<Key, T> * node);
 
         /**
          * @breif Returns nodes uncle, ie, the parents sibling.
          * @param node The reference node.
          * @return The reference nodes uncle.
          */
-        Node<T> * uncle(Node<T> * node);
+        Node<Key, T> * uncle(Node<Key, T> * node);
 
 
         /**
          * @breif Inserts an element into the tree, indicates if
          *        data was inserted correctly by returning true.
          *        If element is already in the tree, the multiplicity
-         *        of the element will be increased.
+         *        of the element will be increased. The node must be made
+         *        with new, its key and data go into a node of the allocator
+         *        and it's deleted.
          * @param  node The node to insert.
          */
-        bool insert(Node<T> * node);
+        bool insert(Node<Key, T> * node);
 
         /**
          * @breif Inserts a key-data pair into the tree, indicates if
@@ -244,14 +1220,155 @@ class RBTree{
          *        of the element will be increased(according to comparator
          *        overload).
          * @param key The key value to insert.
+         * @param data The data to insert, it's only copied if a new node is
+         *             needed.
+         */
+        bool insert(const Key & key, const T & data);
+
+        /**
+         * @breif Inserts a key-data pair into the tree, moving the data into
+         *        the new node if one is needed.
+         * @param key The key value to insert.
+         * @param data The data to insert.
+         */
+        bool insert(const Key & key, T && data);
+
+        /**
+         * @breif Inserts a key-data pair looking for its place from a hint
+         *        instead of the root, see fingerDescend(). The closer the
+         *        hint is to the key, the less it climbs.
+         * @param hint A node of the tree, NULL for the last one.
+         * @param key  The key value to insert.
+         * @param data The data to insert.
+         */
+        bool insert(Node<Key, T> * hint, const Key & key, const T & data);
+
+        /**
+         * @breif Inserts a key-data pair from a hint, moving the data.
+         * @param hint A node of the tree, NULL for the last one.
+         * @param key  The key value to insert.
          * @param data The data to insert.
          */
-        bool insert(int key, T data);
-        void insertCase1(Node<T> * node);
-        void insertCase2(Node<T> * node);
-        void insertCase3(Node<T> * node);
-        void insertCase4(Node<T> * node);
-        void insertCase5(Node<T> * node);
+        bool insert(Node<Key, T> * hint, const Key & key, T && data);
+
+        /**
+         * @breif Turns the finger search on or off. When it's on, insert()
+         *        starts from the node the last insertion touched, or from the
+         *        last node, so streams of growing keys insert in amortized
+         *        O(1).
+         * @param enabled Wether to use the finger.
+         */
+        void setFingerSearch(bool enabled);
+
+        /**
+         * @breif Tells wether the finger search is on.
+         * @return True if insert() starts from the finger.
+         */
+        bool getFingerSearch(void) const;
+
+        /**
+         * @breif Turns the Bloom filter on or off. When it's on, find(),
+         *        exists() and extract() ask a blocked Bloom filter of the keys
+         *        before they descend, and most keys that aren't in the tree
+         *        are answered without touching a node. The filter is sized
+         *        for twice the nodes, built again once they outgrow it or
+         *        half of them are gone, and costs about 20 bits per node.
+         *        The transparent find() and exists() that take keys of other
+         *        types skip the filter.
+         * @param enabled Wether to use the filter.
+         * @return False if Compare isn't known to take for the same only
+         *         keys with the same std::hash, see BloomConsistent, the
+         *         filter stays off.
+         */
+        bool setBloomFilter(bool enabled);
+
+        /**
+         * @breif Tells wether the Bloom filter is on.
+         * @return True if lookups ask the filter first.
+         */
+        bool getBloomFilter(void) const;
+
+        /**
+         * @breif Returns the memory of the Bloom filter and how well it did
+         *        since it was turned on: the lookups it answered and the
+         *        missing keys it let through.
+         * @return The counts.
+         */
+        BloomStats bloomStats(void) const;
+
+        /**
+         * @breif Returns what this tree did since it was created or
+         *        resetStats() was called, when RBTREE_STATS is 1. Moving a
+         *        tree doesn't move them, they belong to the tree object.
+         * @return The counts, all 0 when RBTREE_STATS is 0.
+         */
+        TreeStats stats(void) const;
+
+        /**
+         * @breif Sets every count of stats() back to 0.
+         */
+        void resetStats(void);
+
+        /**
+         * @breif Inserts an element whose data is built in place inside its
+         *        node. The data must be built to be compared, so the node is
+         *        created even if the element is already in the tree.
+         * @param key The key value to insert.
+         * @param args The arguments for the constructor of the data.
+         */
+        template<typename... Args>
+        bool emplace(const Key & key, Args &&... args);
+
+        /**
+         * @breif Inserts a batch of records in one ordered pass. The records
+         *        are std::pair<Key, T> or std::tuple<Key, T, int>, like in
+         *        build_sorted(). They are sorted by key, the caller's order
+         *        is left as is, and the records of each key are counted
+         *        before any node is created, so one key costs at most one
+         *        node and one fix-up. Each key is looked for from the node
+         *        of the one before, see fingerDescend(). As with insert(),
+         *        a record with the key of a node but other data is rejected,
+         *        and among new records of one key the first one gives the
+         *        data.
+         * @param first The first record, a forward iterator.
+         * @param last  Past the last record.
+         * @return How many elements were inserted, multiplicities included.
+         */
+        template<typename Iterator>
+        size_t insert_batch(Iterator first, Iterator last);
+        void insertCase1(Node<Key, T> * node);
+        void insertCase2(Node<Key, T> * node);
+        void insertCase3(Node<Key, T> * node);
+        void insertCase4(Node<Key, T> * node);
+        void insertCase5(Node<Key, T> * node);
+
+        /**
+         * @breif Deletes a node from the tree, whatever its multiplicity is,
+         *        and gives it back to the allocator.
+         * @param node The node to delete.
+         */
+        void deleteNode(Node<Key, T> * node);
+
+        /**
+         * @breif Takes a node out of the tree, whatever its multiplicity is,
+         *        and fixes the tree. The node keeps pointing to where it was.
+         * @param node The node to unlink.
+         */
+        void unlinkNode(Node<Key, T> * node);
+
+        /**
+         * @breif Swaps the place in the tree of a node with two children and
+         *        its successor, colors included, so the node ends up with at
+         *        most one child.
+         * @param node The node to move down.
+         */
+        void swapWithSuccessor(Node<Key, T> * node);
+        void deleteCase1(Node<Key, T> * node);
+        void deleteCase2(Node<Key, T> * node);
+        void deleteCase3(Node<Key, T> * node);
+        void deleteCase4(Node<Key, T> * node);
+        void deleteCase5(Node<Key, T> * node);
+        void deleteCase6(Node<Key, T> * node);
 };
 
 /******************************************************************************
@@ -260,44 +1377,170 @@ class RBTree{
  *                                                                           **
  ******************************************************************************/
 
-template<typename T>
-RBTree<T>::RBTree(int key, T data) {
-    Node<T> * node = new Node<T>(key, data);
+template<typename Key, typename T, typename Compare, typename Alloc>
+RBTree<Key, T, Compare, Alloc>::RBTree(const Key & key, const T & data) {
+    Node<Key, T> * node = this->allocator.create(key, data);
+    RBTREE_COUNT(allocations, 1);
     node->setColor(BLACK);//root element is BLACK
     this->setRoot(node);
 }
 
-template<typename T>
-RBTree<T>::RBTree(Node<T> * node) {
-    node->setColor(BLACK);//root element is BLACK
-    this->setRoot(node);
+template<typename Key, typename T, typename Compare, typename Alloc>
+RBTree<Key, T, Compare, Alloc>::RBTree(Node<Key, T> * node) {
+    Node<Key, T> * root = this->allocator.create(node->getKey(),
+        std::move(node->getData()));
+    RBTREE_COUNT(allocations, 1);
+    delete node;
+    root->setColor(BLACK);//root element is BLACK
+    this->setRoot(root);
 }
 
-template<typename T>
-RBTree<T>::RBTree(void) {
+template<typename Key, typename T, typename Compare, typename Alloc>
+RBTree<Key, T, Compare, Alloc>::RBTree(void) {
     ;
 }
 
-template<typename T>
-RBTree<T>::~RBTree(void) {
+template<typename Key, typename T, typename Compare, typename Alloc>
+RBTree<Key, T, Compare, Alloc>::RBTree(const Compare & compare) :
+    KeyCompare<Compare>(compare) {
     ;
 }
 
-template<typename T>
-Node<T> * RBTree<T>::getRoot(void) {
+template<typename Key, typename T, typename Compare, typename Alloc>
+const Compare & RBTree<Key, T, Compare, Alloc>::getCompare(void) const {
+    return KeyCompare<Compare>::getCompare();
+}
+
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+RBTree<Key, T, Compare, Alloc>::~RBTree(void) {
+    this->clear();
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+RBTree<Key, T, Compare, Alloc>::RBTree(RBTree && other) :
+    KeyCompare<Compare>(other.getCompare()),
+    allocator(std::move(other.allocator)) {
+    this->root = other.root;
+    this->leftmost = other.leftmost;
+    this->rightmost = other.rightmost;
+    this->count = other.count;
+    this->countKnown = other.countKnown;
+    this->finger = other.finger;
+    this->fingerSearch = other.fingerSearch;
+    this->bloom = std::move(other.bloom);
+    this->bloomFilter = other.bloomFilter;
+    this->bloomStale = other.bloomStale;
+    this->bloomRemoved = other.bloomRemoved;
+    this->bloomCounts = other.bloomCounts;
+    other.bloomStale = true;
+    other.root = NULL;
+    other.leftmost = NULL;
+    other.rightmost = NULL;
+    other.count = 0;
+    other.countKnown = true;
+    other.finger = NULL;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+RBTree<Key, T, Compare, Alloc> & RBTree<Key, T, Compare, Alloc>::operator=(
+    RBTree && other) {
+    if (this != &other) {
+        this->clear();
+        KeyCompare<Compare>::operator=(other);
+        this->allocator = std::move(other.allocator);
+        this->root = other.root;
+        this->leftmost = other.leftmost;
+        this->rightmost = other.rightmost;
+        this->count = other.count;
+        this->countKnown = other.countKnown;
+        this->finger = other.finger;
+        this->fingerSearch = other.fingerSearch;
+        this->bloom = std::move(other.bloom);
+        this->bloomFilter = other.bloomFilter;
+        this->bloomStale = other.bloomStale;
+        this->bloomRemoved = other.bloomRemoved;
+        this->bloomCounts = other.bloomCounts;
+        other.bloomStale = true;
+        other.root = NULL;
+        other.leftmost = NULL;
+        other.rightmost = NULL;
+        other.count = 0;
+        other.countKnown = true;
+        other.finger = NULL;
+    }
+    return *this;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::destroy(Node<Key, T> * node) {
+    while (node != NULL) {
+        // Only the left subtree recurses, so the depth is bounded by the
+        // height of the tree.
+        this->destroy(node->getLeft());
+        Node<Key, T> * right = node->getRight();
+        this->allocator.destroy(node);
+        RBTREE_COUNT(frees, 1);
+        node = right;
+    }
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::clear(void) {
+    if (!Alloc::bulkRelease || !std::is_trivially_destructible<T>::value) {
+        this->destroy(this->root);
+    }
+    this->allocator.release();
+    RBTREE_COUNT(releases, 1);
+    this->root = NULL;
+    this->leftmost = NULL;
+    this->rightmost = NULL;
+    this->count = 0;
+    this->countKnown = true;
+    this->finger = NULL;
+    this->bloomStale = true;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+Alloc & RBTree<Key, T, Compare, Alloc>::getAllocator(void) {
+    return this->allocator;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+Node<Key, T> * RBTree<Key, T, Compare, Alloc>::getRoot(void) {
     return this->root;
 }
 
-template<typename T>
-void RBTree<T>::setRoot(Node<T> * node) {
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::setRoot(Node<Key, T> * node) {
     this->root = node;
+    this->finger = NULL;
+    this->leftmost = node == NULL? NULL: this->first(node);
+    this->rightmost = node == NULL? NULL: this->last(node);
+    this->count = 0;
+    for (Node<Key, T> * n = this->leftmost; n != NULL; n = this->next(n)) {
+        this->count += n->getMultiplicity();
+    }
+    this->countKnown = true;
+    this->recountSubtree(node);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+size_t RBTree<Key, T, Compare, Alloc>::size(void) {
+    if (!this->countKnown) {
+        this->count = 0;
+        for (Node<Key, T> * n = this->leftmost; n != NULL; n = this->next(n)) {
+            this->count += n->getMultiplicity();
+        }
+        this->countKnown = true;
+    }
+    return this->count;
 }
 
-template<typename T>
-void RBTree<T>::replaceNode(Node<T> * oldNode, Node<T> * newNode) {
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::replaceNode(Node<Key, T> * oldNode, Node<Key, T> * newNode) {
     if (!oldNode->hasParent()) {
-        this->setRoot(newNode);
-        newNode->setParent(NULL);
+        this->root = newNode;
     } else {
         if (oldNode->isLeft()) {
             oldNode->getParent()->setLeft(newNode);
@@ -317,9 +1560,10 @@ void RBTree<T>::replaceNode(Node<T> * oldNode, Node<T> * newNode) {
  *                                                                           **
  ******************************************************************************/
 
-template<typename T>
-void RBTree<T>::rotateLeft(Node<T> * rootPivot) {
-    Node<T> * right = rootPivot->getRight();
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::rotateLeft(Node<Key, T> * rootPivot) {
+    RBTREE_COUNT(rotateLeft, 1);
+    Node<Key, T> * right = rootPivot->getRight();
     this->replaceNode(rootPivot, right);
     rootPivot->setRight(right->getLeft());
     if (right->hasLeft()) {
@@ -327,11 +1571,14 @@ void RBTree<T>::rotateLeft(Node<T> * rootPivot) {
     }
     right->setLeft(rootPivot);
     rootPivot->setParent(right);
+    this->recount(rootPivot);
+    this->recount(right);
 }
 
-template<typename T>
-void RBTree<T>::rotateRight(Node<T> * rootPivot) {
-    Node<T> * left = rootPivot->getLeft();
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::rotateRight(Node<Key, T> * rootPivot) {
+    RBTREE_COUNT(rotateRight, 1);
+    Node<Key, T> * left = rootPivot->getLeft();
     this->replaceNode(rootPivot, left);
     rootPivot->setLeft(left->getRight());
     if (left->hasRight()) {
@@ -339,6 +1586,8 @@ void RBTree<T>::rotateRight(Node<T> * rootPivot) {
     }
     left->setRight(rootPivot);
     rootPivot->setParent(left);
+    this->recount(rootPivot);
+    this->recount(left);
 }
 
 /******************************************************************************
@@ -357,8 +1606,8 @@ void RBTree<T>::rotateRight(Node<T> * rootPivot) {
  *                                                                           **
  ******************************************************************************/
 
-template<typename T>
-bool RBTree<T>::rule1(Node<T> * node) {
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::rule1(Node<Key, T> * node) {
     bool a, b, c;
     a = node->getColor() == RED || node->getColor() == BLACK;
     b = true;
@@ -368,27 +1617,32 @@ bool RBTree<T>::rule1(Node<T> * node) {
     return a && b && c;
 }
 
-template<typename T>
-bool RBTree<T>::rule1() {
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::rule1() {
+    if (this->getRoot() == NULL) {
+        return true;//an empty tree has only a NIL leaf
+    }
     return this->rule1(this->getRoot());
 }
 
-template<typename T>
-bool RBTree<T>::rule2() {
-    return this->getRoot()->getColor() == BLACK;
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::rule2() {
+    return this->color(this->getRoot()) == BLACK;
 }
 
-template<typename T>
-bool RBTree<T>::rule4(Node<T> * node) {
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::rule4(Node<Key, T> * node) {
     if (node == NULL) {
         return true;//pretty basic
     }
     bool a, b, c;
     a = true;
+    b = true;
+    c = true;
     if (node->getColor() == RED) {
-        a = a && node->getLeft()->getColor() == BLACK;
-        a = a && node->getRight()->getColor() == BLACK;
-        a = a && node->getParent()->getColor() == BLACK;
+        a = a && this->color(node->getLeft()) == BLACK;
+        a = a && this->color(node->getRight()) == BLACK;
+        a = a && this->color(node->getParent()) == BLACK;
     }
     if (node->hasLeft()) {
         b = this->rule4(node->getLeft());
@@ -399,24 +1653,24 @@ bool RBTree<T>::rule4(Node<T> * node) {
     return a && b && c;
 }
 
-template<typename T>
-bool RBTree<T>::rule4(void) {
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::rule4(void) {
     return this->rule4(this->getRoot());
 }
 
-template<typename T>
-bool RBTree<T>::rule5(Node<T> * node) {
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::rule5(Node<Key, T> * node) {
     int pathCount = -1;//the number of black nodes to get '+here+'
     return this->rule5(node, 0, &pathCount);
 }
 
-template<typename T>
-bool RBTree<T>::rule5(Node<T> * node, int blackCount, int * pathCount) {
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::rule5(Node<Key, T> * node, int blackCount, int * pathCount) {
     bool a, b, c;
     a = true;
     b = true;
     c = true;
-    if (node->getColor() == BLACK) {
+    if (this->color(node) == BLACK) {
         ++blackCount;
     }
     if (node == NULL) {
@@ -433,89 +1687,561 @@ bool RBTree<T>::rule5(Node<T> * node, int blackCount, int * pathCount) {
     return a && b && c;
 }
 
-template<typename T>
-bool RBTree<T>::rule5(void) {
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::rule5(void) {
     return this->rule5(this->getRoot());
 }
 
-template<typename T>
-bool RBTree<T>::rules(void) {
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::rules(void) {
     return this->rule1() && this->rule2() && this->rule4() && this->rule5();
 }
 
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::ordered(void) {
+    if (this->getRoot() == NULL) {
+        return this->leftmost == NULL && this->rightmost == NULL &&
+            this->size() == 0;
+    }
+    if (this->getRoot()->hasParent()) {
+        return false;
+    }
+    if (this->leftmost != this->first(this->getRoot()) ||
+        this->rightmost != this->last(this->getRoot())) {
+        return false;
+    }
+    size_t elements = 0;
+    Node<Key, T> * node = this->first();
+    while (node != NULL) {
+        if (!this->checkNode(node)) {
+            return false;
+        }
+        elements += node->getMultiplicity();
+#if RBTREE_ORDER_STATISTICS
+        if (node->getWeight() != node->getMultiplicity() +
+            this->weight(node->getLeft()) + this->weight(node->getRight())) {
+            return false;
+        }
+#endif
+        Node<Key, T> * following = this->next(node);
+        if (following != NULL && !this->less(node->getKey(), following->getKey())) {
+            return false;
+        }
+        node = following;
+    }
+    return elements == this->size();
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::validate(void) {
+    return this->rules() && this->ordered();
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::checkNode(Node<Key, T> * node) {
+    if (node == NULL) {
+        return true;
+    }
+    Node<Key, T> * left = node->getLeft();
+    Node<Key, T> * right = node->getRight();
+    if (left != NULL) {
+        if (left->getParent() != node || !this->less(left->getKey(), node->getKey())) {
+            return false;
+        }
+    }
+    if (right != NULL) {
+        if (right->getParent() != node || !this->less(node->getKey(), right->getKey())) {
+            return false;
+        }
+    }
+    if (node->getColor() == RED) {
+        return this->color(left) == BLACK && this->color(right) == BLACK;
+    }
+    return true;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::checkPath(Node<Key, T> * node) {
+    while (node != NULL) {
+        if (!this->checkNode(node)) {
+            return false;
+        }
+        // Rotations leave touched nodes one or two levels below the path.
+        Node<Key, T> * children[2] = {node->getLeft(), node->getRight()};
+        for (int i = 0; i < 2; ++i) {
+            if (children[i] == NULL) continue;
+            if (!this->checkNode(children[i]) ||
+                !this->checkNode(children[i]->getLeft()) ||
+                !this->checkNode(children[i]->getRight())) {
+                return false;
+            }
+        }
+        if (!node->hasParent() && node != this->getRoot()) {
+            return false;//lost its way to the root
+        }
+        node = node->getParent();
+    }
+    return this->rule2();
+}
 /******************************************************************************
  *                                                                           **
  * MISC                                                                      **
  *                                                                           **
  ******************************************************************************/
 
-template<typename T>
-int RBTree<T>::exists(int key) {
-    Node<T> * node = this->root;
+template<typename Key, typename T, typename Compare, typename Alloc>
+Node<Key, T> * RBTree<Key, T, Compare, Alloc>::find(const Key & key) {
+    RBTREE_SAMPLE(lookups);
+    if (this->bloomFilter) {
+        if (this->bloomStale) {
+            this->buildBloom();
+        }
+        ++this->bloomCounts.probes;
+        if (!this->bloom.mayContain(bloomHash(key))) {
+            ++this->bloomCounts.rejected;
+            return NULL;
+        }
+    }
+    bool found;
+    Node<Key, T> * node = this->descend(key, &found);
+    if (this->bloomFilter && !found) {
+        ++this->bloomCounts.falsePositives;
+    }
+    return found? node: NULL;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+template<typename K, typename C, typename>
+Node<Key, T> * RBTree<Key, T, Compare, Alloc>::find(const K & key) {
+    bool found;
+    Node<Key, T> * node = this->descend(key, &found);
+    return found? node: NULL;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+int RBTree<Key, T, Compare, Alloc>::exists(const Key & key) {
+    Node<Key, T> * node = this->find(key);
+    return node == NULL? 0: node->getMultiplicity();
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+template<typename K, typename C, typename>
+int RBTree<Key, T, Compare, Alloc>::exists(const K & key) {
+    Node<Key, T> * node = this->find(key);
+    return node == NULL? 0: node->getMultiplicity();
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+T RBTree<Key, T, Compare, Alloc>::extract(const Key & key) {
+    RBTREE_SAMPLE(extracts);
+    Node<Key, T> * node = this->find(key);
+    if (node == NULL) {
+        return T();
+    }
+    return this->extract(node);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+template<typename K, typename C, typename>
+T RBTree<Key, T, Compare, Alloc>::extract(const K & key) {
+    Node<Key, T> * node = this->find(key);
+    if (node == NULL) {
+        return T();
+    }
+    return this->extract(node);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+T RBTree<Key, T, Compare, Alloc>::extract(Node<Key, T> * node) {
+    --this->count;
+    if (node->remove()) {
+        // The node goes away, so its data can be moved out.
+        T data(std::move(node->getData()));
+        this->deleteNode(node);
+        return data;
+    }
+    return node->getData();
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::recount(Node<Key, T> * node) {
+#if RBTREE_ORDER_STATISTICS
+    node->recount();
+#else
+    (void) node;
+#endif
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::recountSubtree(Node<Key, T> * node) {
+#if RBTREE_ORDER_STATISTICS
+    if (node == NULL) {
+        return;
+    }
+    this->recountSubtree(node->getLeft());
+    this->recountSubtree(node->getRight());
+    node->recount();
+#endif
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+size_t RBTree<Key, T, Compare, Alloc>::weight(Node<Key, T> * node) {
+#if RBTREE_ORDER_STATISTICS
+    return node == NULL? 0: node->getWeight();
+#else
+    return 0;
+#endif
+}
+
+#if RBTREE_ORDER_STATISTICS
+template<typename Key, typename T, typename Compare, typename Alloc>
+size_t RBTree<Key, T, Compare, Alloc>::rank(const Key & key) {
+    size_t before = 0;
+    Node<Key, T> * node = this->root;
     while (node != NULL) {
-        if (node->getKey() == key) {
-            break;
-        } else if (node->getKey() < key) {
-            node = node->getLeft();
-        } else {
+        if (this->less(node->getKey(), key)) {
+            before += this->weight(node->getLeft()) + node->getMultiplicity();
             node = node->getRight();
+        } else {
+            node = node->getLeft();
         }
     }
-    return node->getMultiplicity();
+    return before;
 }
 
-template<typename T>
-T RBTree<T>::extract(int key) {
-    Node<T> * node = this->root;
+template<typename Key, typename T, typename Compare, typename Alloc>
+Node<Key, T> * RBTree<Key, T, Compare, Alloc>::select(size_t i) {
+    Node<Key, T> * node = this->root;
     while (node != NULL) {
-        if (node->getKey() == key) {
-            break;
-        } else if (node->getKey() == key < 0) {
-            node = node->left;
+        size_t left = this->weight(node->getLeft());
+        if (i < left) {
+            node = node->getLeft();
+        } else if (i < left + node->getMultiplicity()) {
+            return node;
         } else {
-            node = node->right;
+            i -= left + node->getMultiplicity();
+            node = node->getRight();
         }
     }
-    T data = node->getData();
-    if (node->remove()) {
-        //this->delete(key);
+    return NULL;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+size_t RBTree<Key, T, Compare, Alloc>::count_range(const Key & low,
+    const Key & high) {
+    if (!this->less(low, high)) {
+        return 0;
     }
-    return data;
+    return this->rank(high) - this->rank(low);
 }
+#endif
 
 /******************************************************************************
  *                                                                           **
- * RELATIONS                                                                 **
+ * ITERATION                                                                 **
  *                                                                           **
  ******************************************************************************/
 
- template<typename T>
- Node<T> * RBTree<T>::next(Node<T> * node) {
-     if (node == NULL) {
-         return NULL;
-     }
-     if (node->hasRight()) {
-         return this->first(node->getRight());
-     }
-     Node<T> * a = node->getParent();
-     Node<T> * b = node;
-     while (a != NULL && b == a->getRight()) {
-         b = a;
-         a = a->getParent();
+template<typename Key, typename T, typename Compare, typename Alloc>
+typename RBTree<Key, T, Compare, Alloc>::iterator
+RBTree<Key, T, Compare, Alloc>::begin(void) {
+    return iterator(this, this->leftmost);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+typename RBTree<Key, T, Compare, Alloc>::const_iterator
+RBTree<Key, T, Compare, Alloc>::begin(void) const {
+    return const_iterator(this, this->leftmost);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+typename RBTree<Key, T, Compare, Alloc>::const_iterator
+RBTree<Key, T, Compare, Alloc>::cbegin(void) const {
+    return const_iterator(this, this->leftmost);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+typename RBTree<Key, T, Compare, Alloc>::iterator
+RBTree<Key, T, Compare, Alloc>::end(void) {
+    return iterator(this, NULL);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+typename RBTree<Key, T, Compare, Alloc>::const_iterator
+RBTree<Key, T, Compare, Alloc>::end(void) const {
+    return const_iterator(this, NULL);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+typename RBTree<Key, T, Compare, Alloc>::const_iterator
+RBTree<Key, T, Compare, Alloc>::cend(void) const {
+    return const_iterator(this, NULL);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+typename RBTree<Key, T, Compare, Alloc>::reverse_iterator
+RBTree<Key, T, Compare, Alloc>::rbegin(void) {
+    return reverse_iterator(this->end());
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+typename RBTree<Key, T, Compare, Alloc>::const_reverse_iterator
+RBTree<Key, T, Compare, Alloc>::rbegin(void) const {
+    return const_reverse_iterator(this->end());
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+typename RBTree<Key, T, Compare, Alloc>::reverse_iterator
+RBTree<Key, T, Compare, Alloc>::rend(void) {
+    return reverse_iterator(this->begin());
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+typename RBTree<Key, T, Compare, Alloc>::const_reverse_iterator
+RBTree<Key, T, Compare, Alloc>::rend(void) const {
+    return const_reverse_iterator(this->begin());
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+template<typename K>
+Node<Key, T> * RBTree<Key, T, Compare, Alloc>::lowerNode(const K & key) const {
+    Node<Key, T> * node = this->root;
+    Node<Key, T> * bound = NULL;
+    while (node != NULL) {
+        if (this->less(node->getKey(), key)) {
+            node = node->getRight();
+        } else {
+            bound = node;
+            node = node->getLeft();
+        }
+    }
+    return bound;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+template<typename K>
+Node<Key, T> * RBTree<Key, T, Compare, Alloc>::upperNode(const K & key) const {
+    Node<Key, T> * node = this->root;
+    Node<Key, T> * bound = NULL;
+    while (node != NULL) {
+        if (this->less(key, node->getKey())) {
+            bound = node;
+            node = node->getLeft();
+        } else {
+            node = node->getRight();
+        }
+    }
+    return bound;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+typename RBTree<Key, T, Compare, Alloc>::iterator
+RBTree<Key, T, Compare, Alloc>::lower_bound(const Key & key) {
+    return iterator(this, this->lowerNode(key));
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+typename RBTree<Key, T, Compare, Alloc>::const_iterator
+RBTree<Key, T, Compare, Alloc>::lower_bound(const Key & key) const {
+    return const_iterator(this, this->lowerNode(key));
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+typename RBTree<Key, T, Compare, Alloc>::iterator
+RBTree<Key, T, Compare, Alloc>::upper_bound(const Key & key) {
+    return iterator(this, this->upperNode(key));
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+typename RBTree<Key, T, Compare, Alloc>::const_iterator
+RBTree<Key, T, Compare, Alloc>::upper_bound(const Key & key) const {
+    return const_iterator(this, this->upperNode(key));
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+std::pair<typename RBTree<Key, T, Compare, Alloc>::iterator,
+    typename RBTree<Key, T, Compare, Alloc>::iterator>
+RBTree<Key, T, Compare, Alloc>::equal_range(const Key & key) {
+    Node<Key, T> * low = this->lowerNode(key);
+    Node<Key, T> * high = low;
+    if (low != NULL && !this->less(key, low->getKey())) {
+        high = this->next(low);//equal keys share one node
+    }
+    return std::make_pair(iterator(this, low), iterator(this, high));
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+std::pair<typename RBTree<Key, T, Compare, Alloc>::const_iterator,
+    typename RBTree<Key, T, Compare, Alloc>::const_iterator>
+RBTree<Key, T, Compare, Alloc>::equal_range(const Key & key) const {
+    Node<Key, T> * low = this->lowerNode(key);
+    Node<Key, T> * high = low;
+    if (low != NULL && !this->less(key, low->getKey())) {
+        high = this->next(low);//equal keys share one node
+    }
+    return std::make_pair(const_iterator(this, low), const_iterator(this, high));
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+template<typename Function>
+size_t RBTree<Key, T, Compare, Alloc>::for_each_in_range(const Key & low,
+    const Key & high, Function fn) {
+    size_t visited = 0;
+    Node<Key, T> * node = this->lowerNode(low);
+    while (node != NULL && this->less(node->getKey(), high)) {
+        // The successor is taken first, so fn may change the data.
+        Node<Key, T> * following = this->next(node);
+        fn(*node);
+        ++visited;
+        node = following;
+    }
+    return visited;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::splitPieces(Node<Key, T> * node,
+    int depth, std::vector<std::pair<Node<Key, T> *, bool> > & pieces) {
+    if (node == NULL) {
+        return;
+    }
+    if (depth == 0) {
+        pieces.push_back(std::make_pair(node, true));
+        return;
+    }
+    this->splitPieces(node->getLeft(), depth - 1, pieces);
+    pieces.push_back(std::make_pair(node, false));
+    this->splitPieces(node->getRight(), depth - 1, pieces);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::splitPieces(size_t workers,
+    std::vector<std::pair<Node<Key, T> *, bool> > & pieces) {
+    this->splitPieces(this->root, this->splitDepth(workers), pieces);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+int RBTree<Key, T, Compare, Alloc>::splitDepth(size_t workers) {
+    int depth = 0;
+    while (workers > 1 && (size_t(1) << depth) < 8 * workers) {
+        ++depth;
+    }
+    return depth;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+template<typename Function>
+size_t RBTree<Key, T, Compare, Alloc>::walkPiece(
+    const std::pair<Node<Key, T> *, bool> & piece, Function && fn) {
+    if (!piece.second) {
+        fn(*piece.first);
+        return 1;
+    }
+    size_t visited = 0;
+    Node<Key, T> * node = this->first(piece.first);
+    Node<Key, T> * end = this->next(this->last(piece.first));
+    while (node != end) {
+        Node<Key, T> * following = this->next(node);
+        fn(*node);
+        ++visited;
+        node = following;
+    }
+    return visited;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+template<typename Function>
+size_t RBTree<Key, T, Compare, Alloc>::parallel_for_each(Function fn,
+    size_t threads) {
+    WorkPool pool(threads);
+    return this->parallel_for_each(fn, pool);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+template<typename Function>
+size_t RBTree<Key, T, Compare, Alloc>::parallel_for_each(Function fn,
+    WorkPool & pool) {
+    std::vector<std::pair<Node<Key, T> *, bool> > pieces;
+    this->splitPieces(pool.size(), pieces);
+    std::vector<size_t> visited(pool.size(), 0);
+    pool.run(pieces.size(), [&](size_t task, size_t worker) {
+        visited[worker] += this->walkPiece(pieces[task], fn);
+    });
+    size_t total = 0;
+    for (size_t v : visited) {
+        total += v;
+    }
+    return total;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+template<typename Result, typename Map, typename Combine>
+Result RBTree<Key, T, Compare, Alloc>::parallel_reduce(Result init, Map map,
+    Combine combine, bool ordered, size_t threads) {
+    WorkPool pool(threads);
+    return this->parallel_reduce(std::move(init), map, combine, ordered, pool);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+template<typename Result, typename Map, typename Combine>
+Result RBTree<Key, T, Compare, Alloc>::parallel_reduce(Result init, Map map,
+    Combine combine, bool ordered, WorkPool & pool) {
+    std::vector<std::pair<Node<Key, T> *, bool> > pieces;
+    this->splitPieces(pool.size(), pieces);
+    // A piece or a thread may get no node at all, so the partial values
+    // start empty instead of asking combine for an identity.
+    std::vector<std::optional<Result> > partial(ordered? pieces.size():
+        pool.size());
+    pool.run(pieces.size(), [&](size_t task, size_t worker) {
+        std::optional<Result> & value = partial[ordered? task: worker];
+        this->walkPiece(pieces[task], [&](const Node<Key, T> & node) {
+            if (value) {
+                value = combine(std::move(*value), map(node));
+            } else {
+                value = map(node);
+            }
+        });
+    });
+    for (std::optional<Result> & value : partial) {
+        if (value) {
+            init = combine(std::move(init), std::move(*value));
+        }
+    }
+    return init;
+}
+
+/******************************************************************************
+ *                                                                           **
+ * RELATIONS                                                                 **
+ *                                                                           **
+ ******************************************************************************/
+
+ template<typename Key, typename T, typename Compare, typename Alloc>
+ Node<Key, T> * RBTree<Key, T, Compare, Alloc>::next(Node<Key, T> * node) const {
+     if (node == NULL) {
+         return NULL;
+     }
+     if (node->hasRight()) {
+         return this->first(node->getRight());
+     }
+     Node<Key, T> * a = node->getParent();
+     Node<Key, T> * b = node;
+     while (a != NULL && b == a->getRight()) {
+         b = a;
+         a = a->getParent();
      }
      return a;
  }
 
- template<typename T>
- Node<T> * RBTree<T>::previous(Node<T> * node) {
+ template<typename Key, typename T, typename Compare, typename Alloc>
+ Node<Key, T> * RBTree<Key, T, Compare, Alloc>::previous(Node<Key, T> * node) const {
      if (node == NULL) {
          return NULL;
      }
      if (node->getLeft() != NULL) {
          return this->last(node->getLeft());
      }
-     Node<T> * a = node->getParent();
-     Node<T> * b = node;
+     Node<Key, T> * a = node->getParent();
+     Node<Key, T> * b = node;
     while (a != NULL && b == a->getLeft()) {
         b = a;
         a = a->getParent();
@@ -523,51 +2249,56 @@ T RBTree<T>::extract(int key) {
     return a;
  }
 
- template<typename T>
- Node<T> * RBTree<T>::first(Node<T> * node) {
+ template<typename Key, typename T, typename Compare, typename Alloc>
+ Node<Key, T> * RBTree<Key, T, Compare, Alloc>::first(Node<Key, T> * node) const {
      return node->hasLeft()? this->first(node->getLeft()): node;
  }
 
- template<typename T>
- Node<T> * RBTree<T>::first() {
-     return this->first(this->getRoot());
+ template<typename Key, typename T, typename Compare, typename Alloc>
+ Node<Key, T> * RBTree<Key, T, Compare, Alloc>::first() const {
+     return this->leftmost;
  }
 
- template<typename T>
- Node<T> * RBTree<T>::last(Node<T> * node) {
+ template<typename Key, typename T, typename Compare, typename Alloc>
+ Node<Key, T> * RBTree<Key, T, Compare, Alloc>::last(Node<Key, T> * node) const {
      return node->hasRight()? this->last(node->getRight()): node;
  }
 
- template<typename T>
- Node<T> * RBTree<T>::last() {
-     return this->last(this->getRoot());
+ template<typename Key, typename T, typename Compare, typename Alloc>
+ Node<Key, T> * RBTree<Key, T, Compare, Alloc>::last() const {
+     return this->rightmost;
  }
 
- template<typename T>
- Node<T> * RBTree<T>::sibling(Node<T> * node) {
-     Node<T> * sibling = NULL;
-     if (node->isLeft()) sibling = node->getParent()->getLeft();
-     if (node->isRight()) sibling = node->getParent()->getRight();
+ template<typename Key, typename T, typename Compare, typename Alloc>
+ Node<Key, T> * RBTree<Key, T, Compare, Alloc>::sibling(Node<Key, T> * node) {
+     Node<Key, T> * sibling = NULL;
+     if (node->isLeft()) sibling = node->getParent()->getRight();
+     if (node->isRight()) sibling = node->getParent()->getLeft();
      return sibling;
  }
 
- template<typename T>
- Node<T> * RBTree<T>::parent(Node<T> * node) {
+ template<typename Key, typename T, typename Compare, typename Alloc>
+ Colors RBTree<Key, T, Compare, Alloc>::color(Node<Key, T> * node) {
+     return node == NULL? BLACK: node->getColor();
+ }
+
+ template<typename Key, typename T, typename Compare, typename Alloc>
+ Node<Key, T> * RBTree<Key, T, Compare, Alloc>::parent(Node<Key, T> * node) {
      return node->getParent();
  }
 
- template<typename T>
- Node<T> * RBTree<T>::grandpa(Node<T> * node) {
-     Node<T> * grandpa = NULL;
+ template<typename Key, typename T, typename Compare, typename Alloc>
+ Node<Key, T> * RBTree<Key, T, Compare, Alloc>::grandpa(Node<Key, T> * node) {
+     Node<Key, T> * grandpa = NULL;
      if (node->hasParent() && node->getParent()->hasParent()) {
         grandpa = node->getParent()->getParent();
      }
      return grandpa;
  }
 
- template<typename T>
- Node<T> * RBTree<T>::uncle(Node<T> * node) {
-     Node<T> * uncle = NULL;
+ template<typename Key, typename T, typename Compare, typename Alloc>
+ Node<Key, T> * RBTree<Key, T, Compare, Alloc>::uncle(Node<Key, T> * node) {
+     Node<Key, T> * uncle = NULL;
      if (node->hasParent() && node->getParent()->hasParent()) {
          if (node->getParent()->isLeft()) {
              uncle = this->grandpa(node)->getRight();
@@ -584,65 +2315,308 @@ T RBTree<T>::extract(int key) {
  *                                                                           **
  ******************************************************************************/
 
- template<typename T>
- bool RBTree<T>::insert(int key, T data) {
-     return this->insert(new Node<T>(key,data));
+ template<typename Key, typename T, typename Compare, typename Alloc>
+ bool RBTree<Key, T, Compare, Alloc>::insert(const Key & key, const T & data) {
+     if (this->fingerSearch) {
+         return this->insertData(this->finger, key, data);
+     }
+     return this->insertData(NULL, key, data);
  }
 
-template<typename T>
-bool RBTree<T>::insert(Node<T> * node) {
-    if (this->root == NULL) {
-        this->root = node;
+ template<typename Key, typename T, typename Compare, typename Alloc>
+ bool RBTree<Key, T, Compare, Alloc>::insert(const Key & key, T && data) {
+     if (this->fingerSearch) {
+         return this->insertData(this->finger, key, std::move(data));
+     }
+     return this->insertData(NULL, key, std::move(data));
+ }
+
+ template<typename Key, typename T, typename Compare, typename Alloc>
+ bool RBTree<Key, T, Compare, Alloc>::insert(Node<Key, T> * hint,
+     const Key & key, const T & data) {
+     return this->insertData(hint == NULL? this->rightmost: hint, key, data);
+ }
+
+ template<typename Key, typename T, typename Compare, typename Alloc>
+ bool RBTree<Key, T, Compare, Alloc>::insert(Node<Key, T> * hint,
+     const Key & key, T && data) {
+     return this->insertData(hint == NULL? this->rightmost: hint, key,
+         std::move(data));
+ }
+
+ template<typename Key, typename T, typename Compare, typename Alloc>
+ void RBTree<Key, T, Compare, Alloc>::setFingerSearch(bool enabled) {
+     this->fingerSearch = enabled;
+ }
+
+ template<typename Key, typename T, typename Compare, typename Alloc>
+ bool RBTree<Key, T, Compare, Alloc>::getFingerSearch(void) const {
+     return this->fingerSearch;
+ }
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::setBloomFilter(bool enabled) {
+    if (!BloomConsistent<Key, Compare>::value) {
+        return !enabled;
+    }
+    if (enabled && !this->bloomFilter) {
+        this->bloomStale = true;
+        this->bloomCounts = BloomStats();
+    }
+    if (!enabled) {
+        this->bloom = BloomFilter();
+    }
+    this->bloomFilter = enabled;
+    return true;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::getBloomFilter(void) const {
+    return this->bloomFilter;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+BloomStats RBTree<Key, T, Compare, Alloc>::bloomStats(void) const {
+    BloomStats stats = this->bloomCounts;
+    stats.bytes = this->bloom.bytes();
+    stats.capacity = this->bloom.getCapacity();
+    size_t missing = stats.rejected + stats.falsePositives;
+    stats.falsePositiveRate = missing == 0? 0:
+        (double) stats.falsePositives / missing;
+    return stats;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+TreeStats RBTree<Key, T, Compare, Alloc>::stats(void) const {
+#if RBTREE_STATS
+    return this->statistics;
+#else
+    return TreeStats();
+#endif
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::resetStats(void) {
+#if RBTREE_STATS
+    this->statistics = TreeStats();
+#endif
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+uint64_t RBTree<Key, T, Compare, Alloc>::bloomHash(const Key & key) {
+    if constexpr (BloomConsistent<Key, Compare>::value) {
+        return bloomMix(std::hash<Key>()(key));
     } else {
-        Node<T> * root = this->getRoot();
-
-        //add where it belongs as if this was a bst
-        while (true) {
-            if (node->getKey() == root->getKey()) {
-                if (node->getData() == root->getData()) {
-                    root->add();
-                    return true;
-                } else {
-                    return false;
-                }
-            } else if (node->getKey() < root->getKey()) {
-                if (root->hasLeft()) {
-                    root = root->getLeft();
-                } else {
-                    root->setLeft(node);
-                    break;
-                }
-            } else {
-                if (root->hasRight()) {
-                    root = root->getRight();
-                } else {
-                    root->setRight(node);
-                    break;
-                }
-            }
+        return 0;
+    }
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::buildBloom(void) {
+    size_t nodes = 0;
+    for (Node<Key, T> * n = this->leftmost; n != NULL; n = this->next(n)) {
+        ++nodes;
+    }
+    // Room for as many nodes again before it's built anew.
+    this->bloom.reset(nodes < 512? 1024: 2 * nodes);
+    for (Node<Key, T> * n = this->leftmost; n != NULL; n = this->next(n)) {
+        this->bloom.add(bloomHash(n->getKey()));
+    }
+    this->bloomCounts.keys = nodes;
+    ++this->bloomCounts.rebuilds;
+    this->bloomRemoved = 0;
+    this->bloomStale = false;
+}
+
+ template<typename Key, typename T, typename Compare, typename Alloc>
+ template<typename... Args>
+ bool RBTree<Key, T, Compare, Alloc>::emplace(const Key & key, Args &&... args) {
+     RBTREE_COUNT(allocations, 1);
+     return this->insertNode(this->allocator.create(key, InPlace(),
+         std::forward<Args>(args)...));
+ }
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+template<typename D>
+bool RBTree<Key, T, Compare, Alloc>::insertData(Node<Key, T> * hint,
+    const Key & key, D && data) {
+    RBTREE_SAMPLE(inserts);
+    bool found;
+    Node<Key, T> * place;
+    if (this->fingerSearch && hint == NULL) {
+        hint = this->rightmost;//no finger yet, the last node is the best bet
+    }
+    if (hint == NULL) {
+        place = this->descend(key, &found);
+    } else {
+        place = this->fingerDescend(hint, key, &found);
+    }
+    if (found) {
+        if (place->getData() == data) {
+            place->add();
+            RBTREE_COUNT(multiplicityHits, 1);
+            ++this->count;
+            this->finger = place;
+            return true;
+        }
+        return false;
+    }
+    Node<Key, T> * node = this->allocator.create(key, std::forward<D>(data));
+    RBTREE_COUNT(allocations, 1);
+    this->attach(node, place);
+    this->finger = node;
+    return true;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::insert(Node<Key, T> * node) {
+    // Nodes made with new have no place in the allocator, nor an index in
+    // the arena of compact nodes, so only their key and data are kept.
+    bool inserted = this->insert(node->getKey(), std::move(node->getData()));
+    delete node;
+    return inserted;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::insertNode(Node<Key, T> * node) {
+    RBTREE_SAMPLE(inserts);
+    bool found;
+    Node<Key, T> * place = this->descend(node->getKey(), &found);
+    if (found) {
+        bool same = node->getData() == place->getData();
+        if (same) {
+            place->add();
+            RBTREE_COUNT(multiplicityHits, 1);
+            ++this->count;
+        }
+        // The node is not linked, so it goes back to the allocator.
+        this->allocator.destroy(node);
+        RBTREE_COUNT(frees, 1);
+        return same;
+    }
+    this->attach(node, place);
+    return true;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+template<typename K>
+Node<Key, T> * RBTree<Key, T, Compare, Alloc>::descend(const K & key, bool * found) {
+    Node<Key, T> * node = this->root;
+    Node<Key, T> * parent = NULL;
+    *found = false;
+    //go where it belongs as if this was a bst
+    RBTREE_COUNT(descents, 1);
+    while (node != NULL) {
+        parent = node;
+        RBTREE_COUNT(depth, 1);
+        RBTREE_COUNT(comparisons, 1);
+        if (this->less(key, node->getKey())) {
+            node = node->getLeft();
+        } else if (this->less(node->getKey(), key)) {
+            RBTREE_COUNT(comparisons, 1);
+            node = node->getRight();
+        } else {
+            RBTREE_COUNT(comparisons, 1);
+            *found = true;
+            return node;
+        }
+    }
+    return parent;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+Node<Key, T> * RBTree<Key, T, Compare, Alloc>::fingerDescend(
+    Node<Key, T> * start, const Key & key, bool * found) {
+    *found = false;
+    Node<Key, T> * node = start;
+    if (this->less(start->getKey(), key)) {
+        if (start == this->rightmost) {
+            return start;//a new last node, the most common case
+        }
+        // Every ancestor's lower bound is below the start, so only the upper
+        // bound is looked for: the first ancestor reached from its left.
+        while (node->hasParent() &&
+            !(node->isLeft() && this->less(key, node->getParent()->getKey()))) {
+            node = node->getParent();
+        }
+    } else if (this->less(key, start->getKey())) {
+        if (start == this->leftmost) {
+            return start;
+        }
+        while (node->hasParent() &&
+            !(node->isRight() && this->less(node->getParent()->getKey(), key))) {
+            node = node->getParent();
         }
+    } else {
+        *found = true;
+        return start;
+    }
+    Node<Key, T> * parent = node;
+    RBTREE_COUNT(descents, 1);
+    while (node != NULL) {
+        parent = node;
+        RBTREE_COUNT(depth, 1);
+        RBTREE_COUNT(comparisons, 1);
+        if (this->less(key, node->getKey())) {
+            node = node->getLeft();
+        } else if (this->less(node->getKey(), key)) {
+            RBTREE_COUNT(comparisons, 1);
+            node = node->getRight();
+        } else {
+            RBTREE_COUNT(comparisons, 1);
+            *found = true;
+            return node;
+        }
+    }
+    return parent;
+}
 
-        if (node->getParent()->isLeft()) {
-            this->grandpa(node)->setLeft(root);
-        } else if (node->getParent()->isRight()) {
-            this->grandpa(node)->setRight(root);
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::attach(Node<Key, T> * node, Node<Key, T> * parent) {
+    if (this->bloomFilter && !this->bloomStale) {
+        if (this->bloomCounts.keys == this->bloom.getCapacity()) {
+            this->bloomStale = true;
+        } else {
+            this->bloom.add(bloomHash(node->getKey()));
+            ++this->bloomCounts.keys;
         }
     }
+    if (parent == NULL) {
+        this->root = node;
+        this->leftmost = node;
+        this->rightmost = node;
+    } else if (this->less(node->getKey(), parent->getKey())) {
+        parent->setLeft(node);
+        if (parent == this->leftmost) this->leftmost = node;
+    } else {
+        parent->setRight(node);
+        if (parent == this->rightmost) this->rightmost = node;
+    }
+    for (Node<Key, T> * n = parent; n != NULL; n = n->getParent()) {
+        this->recount(n);
+    }
+    this->count += node->getMultiplicity();
+    // Rotations keep the order, so they never change the first and last.
     this->insertCase1(node);
-    return rules();
+#if RBTREE_CHECKED
+    RBTREE_CHECK(this->checkPath(node));
+#endif
 }
 
-template<typename T>
-void RBTree<T>::insertCase1(Node<T> * node) {
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::insertCase1(Node<Key, T> * node) {
+    RBTREE_COUNT(insertCases[0], 1);
     if (!node->hasParent()) {
         node->setColor(BLACK);
+        RBTREE_COUNT(recolors, 1);
     } else {
         this->insertCase2(node);
     }
 }
 
-template<typename T>
-void RBTree<T>::insertCase2(Node<T> * node) {
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::insertCase2(Node<Key, T> * node) {
+    RBTREE_COUNT(insertCases[1], 1);
     if (node->getParent()->getColor() == BLACK) {
         return;
     } else {
@@ -650,20 +2624,23 @@ void RBTree<T>::insertCase2(Node<T> * node) {
     }
 }
 
-template<typename T>
-void RBTree<T>::insertCase3(Node<T> * node) {
-    if (this->uncle(node)->getColor() == RED) {
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::insertCase3(Node<Key, T> * node) {
+    RBTREE_COUNT(insertCases[2], 1);
+    if (this->color(this->uncle(node)) == RED) {
         node->getParent()->setColor(BLACK);
         this->uncle(node)->setColor(BLACK);
         this->grandpa(node)->setColor(RED);
+        RBTREE_COUNT(recolors, 3);
         this->insertCase1(this->grandpa(node));
     } else {
         insertCase4(node);
     }
 }
 
-template<typename T>
-void RBTree<T>::insertCase4(Node<T> * node) {
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::insertCase4(Node<Key, T> * node) {
+    RBTREE_COUNT(insertCases[3], 1);
     if (node->isRight() && node->getParent()->isLeft()) {
         rotateLeft(node->getParent());
         node = node->getLeft();
@@ -674,14 +2651,991 @@ void RBTree<T>::insertCase4(Node<T> * node) {
     insertCase5(node);
 }
 
-template<typename T>
-void RBTree<T>::insertCase5(Node<T> * node) {
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::insertCase5(Node<Key, T> * node) {
+    RBTREE_COUNT(insertCases[4], 1);
     node->getParent()->setColor(BLACK);
     this->grandpa(node)->setColor(RED);
+    RBTREE_COUNT(recolors, 2);
     if (node->isLeft() && node->getParent()->isLeft()) {
         rotateRight(this->grandpa(node));
     } else {
         rotateLeft(this->grandpa(node));
     }
 }
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+template<typename Iterator>
+size_t RBTree<Key, T, Compare, Alloc>::insert_batch(Iterator first,
+    Iterator last) {
+    typedef typename std::decay<decltype(*first)>::type Record;
+    typedef std::integral_constant<bool,
+        (std::tuple_size<Record>::value > 2)> HasMultiplicity;
+
+    std::vector<Iterator> order;
+    for (; first != last; ++first) {
+        order.push_back(first);
+    }
+    std::stable_sort(order.begin(), order.end(),
+        [this](const Iterator & a, const Iterator & b) {
+            return this->less(std::get<0>(*a), std::get<0>(*b));
+        });
+
+    size_t inserted = 0;
+    Node<Key, T> * previous = NULL;
+    size_t i = 0;
+    while (i < order.size()) {
+        const Key & key = std::get<0>(*order[i]);
+        size_t end = i + 1;
+        while (end < order.size() && !this->less(key, std::get<0>(*order[end]))) {
+            ++end;
+        }
+        bool found;
+        Node<Key, T> * place = previous == NULL? this->descend(key, &found):
+            this->fingerDescend(previous, key, &found);
+        // The data of the node, or else of the first record, is the one
+        // every record of the key must have.
+        const T * data = found? &place->getData(): NULL;
+        size_t lead = i;
+        int multiplicity = 0;
+        for (size_t j = i; j < end; ++j) {
+            auto && record = *order[j];
+            int m = recordMultiplicity(record, HasMultiplicity());
+            if (m <= 0) {
+                continue;
+            }
+            if (data == NULL) {
+                data = &std::get<1>(record);
+                lead = j;
+            }
+            if (std::get<1>(record) == *data) {
+                multiplicity += m;
+            }
+        }
+        if (multiplicity > 0) {
+            if (found) {
+                place->setMultiplicity(place->getMultiplicity() + multiplicity);
+                this->count += multiplicity;
+                previous = place;
+            } else {
+                Node<Key, T> * node = this->allocator.create(key,
+                    std::get<1>(*order[lead]));
+                RBTREE_COUNT(allocations, 1);
+                node->setMultiplicity(multiplicity);
+                this->attach(node, place);
+                previous = node;
+            }
+            inserted += multiplicity;
+        }
+        i = end;
+    }
+    if (previous != NULL) {
+        this->finger = previous;
+    }
+    return inserted;
+}
+
+/******************************************************************************
+ *                                                                           **
+ * DELETION                                                                  **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::deleteNode(Node<Key, T> * node) {
+    this->unlinkNode(node);
+    this->allocator.destroy(node);
+    RBTREE_COUNT(frees, 1);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::unlinkNode(Node<Key, T> * node) {
+    if (node == this->finger) this->finger = NULL;
+    // A gone key left in the filter only costs a false positive.
+    if (++this->bloomRemoved > this->bloomCounts.keys / 2) {
+        this->bloomStale = true;
+    }
+    if (node == this->leftmost) this->leftmost = this->next(node);
+    if (node == this->rightmost) this->rightmost = this->previous(node);
+    this->count -= node->getMultiplicity();
+    // From here on the node weighs nothing, so taking it out of its subtree
+    // doesn't change the weight of its ancestors.
+    node->setMultiplicity(0);
+    if (node->hasLeft() && node->hasRight()) {
+        this->swapWithSuccessor(node);
+    }
+    Node<Key, T> * child = node->hasLeft()? node->getLeft(): node->getRight();
+    if (node->getColor() == BLACK) {
+        if (this->color(child) == RED) {
+            child->setColor(BLACK);
+            RBTREE_COUNT(recolors, 1);
+        } else {
+            // The node takes the place of its NIL child while the tree is
+            // fixed, it's unlinked afterwards.
+            this->deleteCase1(node);
+        }
+    }
+#if RBTREE_CHECKED
+    Node<Key, T> * parent = node->getParent();
+#endif
+    this->replaceNode(node, child);
+#if RBTREE_CHECKED
+    RBTREE_CHECK(parent == NULL? this->rule2(): this->checkPath(parent));
+#endif
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::swapWithSuccessor(Node<Key, T> * node) {
+    Node<Key, T> * successor = this->first(node->getRight());
+    Node<Key, T> * left = node->getLeft();
+    Node<Key, T> * right = node->getRight();
+    Node<Key, T> * successorParent = successor->getParent();
+    Node<Key, T> * successorRight = successor->getRight();
+    Colors c = node->getColor();
+
+    this->replaceNode(node, successor);
+    successor->setLeft(left);
+    if (successorParent == node) {
+        successor->setRight(node);
+    } else {
+        successor->setRight(right);
+        successorParent->setLeft(node);
+    }
+    node->setLeft(NULL);
+    node->setRight(successorRight);
+    node->setColor(successor->getColor());
+    successor->setColor(c);
+    // The nodes between lost the successor and got the empty node.
+    for (Node<Key, T> * n = node; n != successor; n = n->getParent()) {
+        this->recount(n);
+    }
+    this->recount(successor);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::deleteCase1(Node<Key, T> * node) {
+    if (node->hasParent()) {
+        this->deleteCase2(node);
+    }
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::deleteCase2(Node<Key, T> * node) {
+    Node<Key, T> * sibling = this->sibling(node);
+    if (this->color(sibling) == RED) {
+        node->getParent()->setColor(RED);
+        sibling->setColor(BLACK);
+        RBTREE_COUNT(recolors, 2);
+        if (node->isLeft()) {
+            this->rotateLeft(node->getParent());
+        } else {
+            this->rotateRight(node->getParent());
+        }
+    }
+    this->deleteCase3(node);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::deleteCase3(Node<Key, T> * node) {
+    Node<Key, T> * sibling = this->sibling(node);
+    if (node->getParent()->getColor() == BLACK &&
+        this->color(sibling) == BLACK &&
+        this->color(sibling->getLeft()) == BLACK &&
+        this->color(sibling->getRight()) == BLACK) {
+        sibling->setColor(RED);
+        RBTREE_COUNT(recolors, 1);
+        this->deleteCase1(node->getParent());
+    } else {
+        this->deleteCase4(node);
+    }
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::deleteCase4(Node<Key, T> * node) {
+    Node<Key, T> * sibling = this->sibling(node);
+    if (node->getParent()->getColor() == RED &&
+        this->color(sibling) == BLACK &&
+        this->color(sibling->getLeft()) == BLACK &&
+        this->color(sibling->getRight()) == BLACK) {
+        sibling->setColor(RED);
+        node->getParent()->setColor(BLACK);
+        RBTREE_COUNT(recolors, 2);
+    } else {
+        this->deleteCase5(node);
+    }
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::deleteCase5(Node<Key, T> * node) {
+    Node<Key, T> * sibling = this->sibling(node);
+    // The sibling is black here, case 2 made sure of it.
+    if (node->isLeft() &&
+        this->color(sibling->getRight()) == BLACK &&
+        this->color(sibling->getLeft()) == RED) {
+        sibling->setColor(RED);
+        sibling->getLeft()->setColor(BLACK);
+        RBTREE_COUNT(recolors, 2);
+        this->rotateRight(sibling);
+    } else if (node->isRight() &&
+        this->color(sibling->getLeft()) == BLACK &&
+        this->color(sibling->getRight()) == RED) {
+        sibling->setColor(RED);
+        sibling->getRight()->setColor(BLACK);
+        RBTREE_COUNT(recolors, 2);
+        this->rotateLeft(sibling);
+    }
+    this->deleteCase6(node);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::deleteCase6(Node<Key, T> * node) {
+    Node<Key, T> * sibling = this->sibling(node);
+    sibling->setColor(node->getParent()->getColor());
+    node->getParent()->setColor(BLACK);
+    RBTREE_COUNT(recolors, 3);
+    if (node->isLeft()) {
+        sibling->getRight()->setColor(BLACK);
+        this->rotateLeft(node->getParent());
+    } else {
+        sibling->getLeft()->setColor(BLACK);
+        this->rotateRight(node->getParent());
+    }
+}
+
+/******************************************************************************
+ *                                                                           **
+ * SPLIT AND JOIN                                                            **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+int RBTree<Key, T, Compare, Alloc>::blackHeight(Node<Key, T> * node) {
+    int height = 0;
+    for (; node != NULL; node = node->getLeft()) {
+        if (node->getColor() == BLACK) ++height;
+    }
+    return height;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+Node<Key, T> * RBTree<Key, T, Compare, Alloc>::joinNodes(Node<Key, T> * left,
+    int leftHeight, Node<Key, T> * middle, Node<Key, T> * right,
+    int rightHeight, int * height) {
+    middle->setParent(NULL);
+    middle->setLeft(NULL);
+    middle->setRight(NULL);
+    if (leftHeight == rightHeight) {
+        middle->setLeft(left);
+        middle->setRight(right);
+        middle->setColor(BLACK);
+        this->recount(middle);
+        *height = leftHeight + 1;
+        return middle;
+    }
+    // Down the spine of the higher subtree that faces the other one, to the
+    // first black node as high as the lower subtree, which takes its place
+    // under the middle node.
+    Node<Key, T> * spot;
+    Node<Key, T> * parent = NULL;
+    int lower;
+    if (leftHeight > rightHeight) {
+        spot = left;
+        for (int h = leftHeight; h > rightHeight || this->color(spot) == RED;
+            spot = spot->getRight()) {
+            if (this->color(spot) == BLACK) --h;
+            parent = spot;
+        }
+        parent->setRight(middle);
+        middle->setLeft(spot);
+        middle->setRight(right);
+        this->root = left;
+        lower = rightHeight;
+    } else {
+        spot = right;
+        for (int h = rightHeight; h > leftHeight || this->color(spot) == RED;
+            spot = spot->getLeft()) {
+            if (this->color(spot) == BLACK) --h;
+            parent = spot;
+        }
+        parent->setLeft(middle);
+        middle->setLeft(left);
+        middle->setRight(spot);
+        this->root = right;
+        lower = leftHeight;
+    }
+    middle->setColor(RED);
+    for (Node<Key, T> * n = middle; n != NULL; n = n->getParent()) {
+        this->recount(n);
+    }
+    this->insertCase1(middle);
+    // The fix-up never recolors the spot, nor moves it out of its subtree,
+    // so the black nodes above it give the new black-height.
+    *height = lower;
+    for (Node<Key, T> * n = spot != NULL? spot->getParent(): middle; n != NULL;
+        n = n->getParent()) {
+        if (n->getColor() == BLACK) ++*height;
+    }
+    return this->root;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::splitNode(Node<Key, T> * node,
+    int height, const Key & key, Node<Key, T> ** low, int * lowHeight,
+    Node<Key, T> ** high, int * highHeight, Node<Key, T> ** match) {
+    if (node == NULL) {
+        *low = NULL;
+        *high = NULL;
+        *lowHeight = 0;
+        *highHeight = 0;
+        if (match != NULL) *match = NULL;
+        return;
+    }
+    Node<Key, T> * left;
+    Node<Key, T> * right;
+    int leftHeight, rightHeight;
+    this->expose(node, height, &left, &leftHeight, &right, &rightHeight);
+    Node<Key, T> * middle;
+    int middleHeight;
+    if (this->less(node->getKey(), key)) {
+        this->splitNode(right, rightHeight, key, &middle, &middleHeight, high,
+            highHeight, match);
+        *low = this->joinNodes(left, leftHeight, node, middle, middleHeight,
+            lowHeight);
+    } else if (match != NULL && !this->less(key, node->getKey())) {
+        *low = left;
+        *lowHeight = leftHeight;
+        *high = right;
+        *highHeight = rightHeight;
+        *match = node;
+    } else {
+        this->splitNode(left, leftHeight, key, low, lowHeight, &middle,
+            &middleHeight, match);
+        *high = this->joinNodes(middle, middleHeight, node, right,
+            rightHeight, highHeight);
+    }
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::expose(Node<Key, T> * node, int height,
+    Node<Key, T> ** left, int * leftHeight, Node<Key, T> ** right,
+    int * rightHeight) {
+    *left = node->getLeft();
+    *right = node->getRight();
+    *leftHeight = height - 1;
+    *rightHeight = height - 1;
+    // A red child turns black and gains a level.
+    if (*left != NULL) {
+        (*left)->setParent(NULL);
+        if ((*left)->getColor() == RED) {
+            (*left)->setColor(BLACK);
+            ++*leftHeight;
+        }
+    }
+    if (*right != NULL) {
+        (*right)->setParent(NULL);
+        if ((*right)->getColor() == RED) {
+            (*right)->setColor(BLACK);
+            ++*rightHeight;
+        }
+    }
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+Node<Key, T> * RBTree<Key, T, Compare, Alloc>::splitLast(Node<Key, T> * node,
+    int height, Node<Key, T> ** rest, int * restHeight) {
+    Node<Key, T> * left;
+    Node<Key, T> * right;
+    int leftHeight, rightHeight;
+    this->expose(node, height, &left, &leftHeight, &right, &rightHeight);
+    if (right == NULL) {
+        *rest = left;
+        *restHeight = leftHeight;
+        return node;
+    }
+    Node<Key, T> * middle;
+    int middleHeight;
+    Node<Key, T> * last = this->splitLast(right, rightHeight, &middle,
+        &middleHeight);
+    *rest = this->joinNodes(left, leftHeight, node, middle, middleHeight,
+        restHeight);
+    return last;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+Node<Key, T> * RBTree<Key, T, Compare, Alloc>::joinTwo(Node<Key, T> * left,
+    int leftHeight, Node<Key, T> * right, int rightHeight, int * height) {
+    if (right == NULL) {
+        *height = leftHeight;
+        return left;
+    }
+    if (left == NULL) {
+        *height = rightHeight;
+        return right;
+    }
+    Node<Key, T> * rest;
+    int restHeight;
+    Node<Key, T> * last = this->splitLast(left, leftHeight, &rest, &restHeight);
+    return this->joinNodes(rest, restHeight, last, right, rightHeight, height);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+RBTree<Key, T, Compare, Alloc> RBTree<Key, T, Compare, Alloc>::split(
+    const Key & key) {
+    RBTree high(this->getCompare());
+    high.fingerSearch = this->fingerSearch;
+    high.bloomFilter = this->bloomFilter;
+    if (this->root == NULL) {
+        return high;
+    }
+    this->allocator.share(high.allocator);
+    Node<Key, T> * lowRoot;
+    Node<Key, T> * highRoot;
+    int lowHeight, highHeight;
+    this->splitNode(this->root, this->blackHeight(this->root), key, &lowRoot,
+        &lowHeight, &highRoot, &highHeight);
+
+    this->root = lowRoot;
+    this->leftmost = lowRoot == NULL? NULL: this->first(lowRoot);
+    this->rightmost = lowRoot == NULL? NULL: this->last(lowRoot);
+    this->finger = NULL;
+    this->bloomStale = true;
+    high.root = highRoot;
+    high.leftmost = highRoot == NULL? NULL: high.first(highRoot);
+    high.rightmost = highRoot == NULL? NULL: high.last(highRoot);
+#if RBTREE_ORDER_STATISTICS
+    this->count = this->weight(lowRoot);
+    high.count = this->weight(highRoot);
+#else
+    // Only a part left empty tells the size of the other one.
+    bool known = this->countKnown;
+    high.count = highRoot == NULL? 0: this->count;
+    high.countKnown = highRoot == NULL || (lowRoot == NULL && known);
+    this->count = lowRoot == NULL? 0: this->count;
+    this->countKnown = lowRoot == NULL || (highRoot == NULL && known);
+#endif
+#if RBTREE_CHECKED
+    RBTREE_CHECK(this->rule2() && high.rule2());
+#endif
+    return high;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::join(RBTree & right) {
+    if (right.root == NULL) {
+        return true;
+    }
+    if (this->root != NULL &&
+        !this->less(this->rightmost->getKey(), right.leftmost->getKey())) {
+        return false;
+    }
+    this->allocator.share(right.allocator);
+    size_t total = this->count + right.count;
+    bool known = this->countKnown && right.countKnown;
+
+    // The first node of the right tree goes between both.
+    Node<Key, T> * middle = right.leftmost;
+    int multiplicity = middle->getMultiplicity();
+    right.unlinkNode(middle);
+    middle->setParent(NULL);
+    middle->setMultiplicity(multiplicity);
+    int height;
+    this->root = this->joinNodes(this->root, this->blackHeight(this->root),
+        middle, right.root, this->blackHeight(right.root), &height);
+    this->leftmost = this->first(this->root);
+    this->rightmost = this->last(this->root);
+    this->count = total;
+    this->countKnown = known;
+    this->bloomStale = true;
+
+    right.root = NULL;
+    right.leftmost = NULL;
+    right.rightmost = NULL;
+    right.count = 0;
+    right.countKnown = true;
+    right.finger = NULL;
+#if RBTREE_CHECKED
+    RBTREE_CHECK(this->rule2());
+#endif
+    return true;
+}
+
+/******************************************************************************
+ *                                                                           **
+ * SET OPERATIONS                                                            **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+Node<Key, T> * RBTree<Key, T, Compare, Alloc>::mergeMiddle(
+    Node<Key, T> * match, Node<Key, T> * theirs, SetOperation operation,
+    Multiplicities policy, std::vector<Node<Key, T> *> & dropped) {
+    if (match == NULL) {
+        if (operation == UNION) {
+            return theirs;
+        }
+        dropped.push_back(theirs);
+        return NULL;
+    }
+    dropped.push_back(theirs);
+    if (!(match->getData() == theirs->getData())) {
+        // Another element under the same key, which the tree can't hold.
+        if (operation == INTERSECTION) {
+            dropped.push_back(match);
+            return NULL;
+        }
+        return match;
+    }
+    int mine = match->getMultiplicity();
+    int other = theirs->getMultiplicity();
+    int multiplicity;
+    if (operation == DIFFERENCE) {
+        multiplicity = mine - other;
+    } else if (policy == SUM_MULTIPLICITY) {
+        multiplicity = mine + other;
+    } else if (policy == MAX_MULTIPLICITY) {
+        multiplicity = mine > other? mine: other;
+    } else {
+        multiplicity = mine < other? mine: other;
+    }
+    if (multiplicity <= 0) {
+        dropped.push_back(match);
+        return NULL;
+    }
+    match->setMultiplicity(multiplicity);
+    return match;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+Node<Key, T> * RBTree<Key, T, Compare, Alloc>::mergeNodes(Node<Key, T> * mine,
+    int mineHeight, Node<Key, T> * theirs, int theirsHeight,
+    SetOperation operation, Multiplicities policy, int * height,
+    std::vector<Node<Key, T> *> & dropped) {
+    if (theirs == NULL) {
+        if (operation == INTERSECTION) {
+            this->dropSubtree(mine, dropped);
+            *height = 0;
+            return NULL;
+        }
+        *height = mineHeight;
+        return mine;
+    }
+    if (mine == NULL) {
+        if (operation == UNION) {
+            *height = theirsHeight;
+            return theirs;
+        }
+        this->dropSubtree(theirs, dropped);
+        *height = 0;
+        return NULL;
+    }
+    Node<Key, T> * theirsLeft;
+    Node<Key, T> * theirsRight;
+    int theirsLeftHeight, theirsRightHeight;
+    this->expose(theirs, theirsHeight, &theirsLeft, &theirsLeftHeight,
+        &theirsRight, &theirsRightHeight);
+    Node<Key, T> * mineLeft;
+    Node<Key, T> * mineRight;
+    Node<Key, T> * match;
+    int mineLeftHeight, mineRightHeight;
+    this->splitNode(mine, mineHeight, theirs->getKey(), &mineLeft,
+        &mineLeftHeight, &mineRight, &mineRightHeight, &match);
+
+    int leftHeight, rightHeight;
+    Node<Key, T> * left = this->mergeNodes(mineLeft, mineLeftHeight,
+        theirsLeft, theirsLeftHeight, operation, policy, &leftHeight, dropped);
+    Node<Key, T> * right = this->mergeNodes(mineRight, mineRightHeight,
+        theirsRight, theirsRightHeight, operation, policy, &rightHeight,
+        dropped);
+    Node<Key, T> * middle = this->mergeMiddle(match, theirs, operation, policy,
+        dropped);
+    if (middle != NULL) {
+        return this->joinNodes(left, leftHeight, middle, right, rightHeight,
+            height);
+    }
+    return this->joinTwo(left, leftHeight, right, rightHeight, height);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::dropSubtree(Node<Key, T> * node,
+    std::vector<Node<Key, T> *> & dropped) {
+    while (node != NULL) {
+        this->dropSubtree(node->getLeft(), dropped);
+        dropped.push_back(node);
+        node = node->getRight();
+    }
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::explode(Node<Key, T> * node, int height,
+    int depth, std::vector<std::pair<Node<Key, T> *, int> > & pieces,
+    std::vector<Node<Key, T> *> & pivots) {
+    if (node == NULL || depth == 0) {
+        pieces.push_back(std::make_pair(node, height));
+        return;
+    }
+    Node<Key, T> * left;
+    Node<Key, T> * right;
+    int leftHeight, rightHeight;
+    this->expose(node, height, &left, &leftHeight, &right, &rightHeight);
+    this->explode(left, leftHeight, depth - 1, pieces, pivots);
+    pivots.push_back(node);
+    this->explode(right, rightHeight, depth - 1, pieces, pivots);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::mergeTree(RBTree & other,
+    SetOperation operation, Multiplicities policy, WorkPool & pool) {
+    this->allocator.share(other.allocator);
+    std::vector<std::pair<Node<Key, T> *, int> > theirs, mine;
+    std::vector<Node<Key, T> *> pivots;
+    this->explode(other.root, this->blackHeight(other.root),
+        this->splitDepth(pool.size()), theirs, pivots);
+    other.root = NULL;
+    other.leftmost = NULL;
+    other.rightmost = NULL;
+    other.count = 0;
+    other.countKnown = true;
+    other.finger = NULL;
+
+    std::vector<Node<Key, T> *> matches(pivots.size());
+    Node<Key, T> * rest = this->root;
+    int restHeight = this->blackHeight(rest);
+    for (size_t i = 0; i < pivots.size(); ++i) {
+        Node<Key, T> * low;
+        int lowHeight;
+        this->splitNode(rest, restHeight, pivots[i]->getKey(), &low,
+            &lowHeight, &rest, &restHeight, &matches[i]);
+        mine.push_back(std::make_pair(low, lowHeight));
+    }
+    mine.push_back(std::make_pair(rest, restHeight));
+
+    std::vector<std::pair<Node<Key, T> *, int> > merged(theirs.size());
+    std::vector<std::vector<Node<Key, T> *> > dropped(theirs.size() + 1);
+    pool.run(theirs.size(), [&](size_t task, size_t) {
+        RBTree scratch(this->getCompare());
+        merged[task].first = scratch.mergeNodes(mine[task].first,
+            mine[task].second, theirs[task].first, theirs[task].second,
+            operation, policy, &merged[task].second, dropped[task]);
+        scratch.root = NULL;
+    });
+
+    Node<Key, T> * result = merged[0].first;
+    int height = merged[0].second;
+    for (size_t i = 0; i < pivots.size(); ++i) {
+        Node<Key, T> * middle = this->mergeMiddle(matches[i], pivots[i],
+            operation, policy, dropped.back());
+        if (middle != NULL) {
+            result = this->joinNodes(result, height, middle,
+                merged[i + 1].first, merged[i + 1].second, &height);
+        } else {
+            result = this->joinTwo(result, height, merged[i + 1].first,
+                merged[i + 1].second, &height);
+        }
+    }
+    this->root = result;
+    this->leftmost = result == NULL? NULL: this->first(result);
+    this->rightmost = result == NULL? NULL: this->last(result);
+    this->finger = NULL;
+    this->bloomStale = true;
+#if RBTREE_ORDER_STATISTICS
+    this->count = this->weight(result);
+#else
+    this->countKnown = false;
+#endif
+    for (size_t i = 0; i < dropped.size(); ++i) {
+        for (size_t j = 0; j < dropped[i].size(); ++j) {
+            this->allocator.destroy(dropped[i][j]);
+            RBTREE_COUNT(frees, 1);
+        }
+    }
+#if RBTREE_CHECKED
+    RBTREE_CHECK(this->rule2());
+#endif
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::union_with(RBTree & other,
+    Multiplicities policy, size_t threads) {
+    if (&other == this) {
+        return false;
+    }
+    WorkPool pool(threads);
+    this->mergeTree(other, UNION, policy, pool);
+    return true;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::union_with(RBTree & other,
+    Multiplicities policy, WorkPool & pool) {
+    if (&other == this) {
+        return false;
+    }
+    this->mergeTree(other, UNION, policy, pool);
+    return true;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::intersect_with(RBTree & other,
+    Multiplicities policy, size_t threads) {
+    if (&other == this) {
+        return false;
+    }
+    WorkPool pool(threads);
+    this->mergeTree(other, INTERSECTION, policy, pool);
+    return true;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::intersect_with(RBTree & other,
+    Multiplicities policy, WorkPool & pool) {
+    if (&other == this) {
+        return false;
+    }
+    this->mergeTree(other, INTERSECTION, policy, pool);
+    return true;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::difference_with(RBTree & other,
+    size_t threads) {
+    if (&other == this) {
+        return false;
+    }
+    WorkPool pool(threads);
+    this->mergeTree(other, DIFFERENCE, SUM_MULTIPLICITY, pool);
+    return true;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool RBTree<Key, T, Compare, Alloc>::difference_with(RBTree & other,
+    WorkPool & pool) {
+    if (&other == this) {
+        return false;
+    }
+    this->mergeTree(other, DIFFERENCE, SUM_MULTIPLICITY, pool);
+    return true;
+}
+
+/******************************************************************************
+ *                                                                           **
+ * BULK CONSTRUCTION                                                         **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+template<typename Iterator>
+RBTree<Key, T, Compare, Alloc> RBTree<Key, T, Compare, Alloc>::build_sorted(
+    Iterator first, Iterator last, const Compare & compare) {
+    typedef typename std::decay<decltype(*first)>::type Record;
+    typedef std::integral_constant<bool,
+        (std::tuple_size<Record>::value > 2)> HasMultiplicity;
+
+    RBTree tree(compare);
+    std::vector<Node<Key, T> *> nodes;
+    std::vector<Iterator> late;
+    for (; first != last; ++first) {
+        auto && record = *first;
+        int multiplicity = recordMultiplicity(record, HasMultiplicity());
+        if (multiplicity <= 0) {
+            continue;
+        }
+        const Key & key = std::get<0>(record);
+        if (!nodes.empty()) {
+            Node<Key, T> * previous = nodes.back();
+            if (tree.less(key, previous->getKey())) {
+                late.push_back(first);
+                continue;
+            }
+            if (!tree.less(previous->getKey(), key)) {
+                if (previous->getData() == std::get<1>(record)) {
+                    previous->setMultiplicity(previous->getMultiplicity() +
+                        multiplicity);
+                    tree.count += multiplicity;
+                }
+                continue;
+            }
+        }
+        Node<Key, T> * node = tree.allocator.create(key,
+            std::get<1>(std::forward<decltype(record)>(record)));
+        node->setMultiplicity(multiplicity);
+        node->setColor(BLACK);
+        nodes.push_back(node);
+        tree.count += multiplicity;
+    }
+
+    tree.layBalanced(nodes);
+#if RBTREE_STATS
+    tree.statistics.allocations += nodes.size();
+#endif
+
+    for (size_t i = 0; i < late.size(); ++i) {
+        auto && record = *late[i];
+        int multiplicity = recordMultiplicity(record, HasMultiplicity());
+        for (int m = 0; m < multiplicity; ++m) {
+            tree.insert(std::get<0>(record), std::get<1>(record));
+        }
+    }
+    return tree;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+void RBTree<Key, T, Compare, Alloc>::layBalanced(
+    std::vector<Node<Key, T> *> & nodes) {
+    if (nodes.empty()) {
+        return;
+    }
+    // Every level but the lowest one is full, the lowest one is red unless
+    // it's full too.
+    size_t full = 1;
+    int levels = 0;
+    while (full * 2 - 1 <= nodes.size()) {
+        full *= 2;
+        ++levels;
+    }
+    int red = full - 1 == nodes.size()? -1: levels;
+    this->root = buildBalanced(nodes, 0, nodes.size(), 0, red);
+    this->root->setParent(NULL);
+    this->leftmost = nodes.front();
+    this->rightmost = nodes.back();
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+Node<Key, T> * RBTree<Key, T, Compare, Alloc>::buildBalanced(
+    std::vector<Node<Key, T> *> & nodes, size_t low, size_t high, int depth,
+    int red) {
+    if (low >= high) {
+        return NULL;
+    }
+    size_t middle = low + (high - low) / 2;
+    Node<Key, T> * node = nodes[middle];
+    node->setLeft(buildBalanced(nodes, low, middle, depth + 1, red));
+    node->setRight(buildBalanced(nodes, middle + 1, high, depth + 1, red));
+#if RBTREE_ORDER_STATISTICS
+    node->recount();
+#endif
+    if (depth == red) {
+        node->setColor(RED);
+    }
+    return node;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+template<typename R>
+int RBTree<Key, T, Compare, Alloc>::recordMultiplicity(const R & record,
+    std::true_type) {
+    return std::get<2>(record);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+template<typename R>
+int RBTree<Key, T, Compare, Alloc>::recordMultiplicity(const R &,
+    std::false_type) {
+    return 1;
+}
+
+/******************************************************************************
+ *                                                                           **
+ * SNAPSHOTS                                                                 **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+template<typename Serializer>
+bool RBTree<Key, T, Compare, Alloc>::save(const char * path,
+    Serializer serializer) {
+    std::string aside = std::string(path) + ".tmp";
+    SnapshotWriter out(aside.c_str());
+    uint32_t header[4] = {SNAPSHOT_MAGIC, SNAPSHOT_VERSION, sizeof(Key),
+        sizeof(T)};
+    uint64_t elements = this->size();
+    out.write(header, sizeof(header));
+    out.write(&elements, sizeof(elements));
+    for (Node<Key, T> * n = this->leftmost; n != NULL && out.good();
+        n = this->next(n)) {
+        int32_t multiplicity = n->getMultiplicity();
+        serializer.write(out, n->getKey());
+        out.write(&multiplicity, sizeof(multiplicity));
+        serializer.write(out, n->getData());
+    }
+    if (!out.close() || rename(aside.c_str(), path) != 0) {
+        remove(aside.c_str());
+        return false;
+    }
+    return true;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+template<typename Serializer>
+bool RBTree<Key, T, Compare, Alloc>::load(const char * path,
+    Serializer serializer) {
+    SnapshotReader in(path);
+    uint32_t header[4];
+    uint64_t elements;
+    if (!in.read(header, sizeof(header)) ||
+        !in.read(&elements, sizeof(elements)) ||
+        header[0] != SNAPSHOT_MAGIC || header[1] != SNAPSHOT_VERSION ||
+        header[2] != sizeof(Key) || header[3] != sizeof(T)) {
+        return false;
+    }
+
+    // The nodes go to a tree of their own, this one keeps its nodes until
+    // the whole file checks out.
+    RBTree loaded(this->getCompare());
+    std::vector<Node<Key, T> *> nodes;
+    bool whole = true;
+    while (in.remaining() > 0 && whole) {
+        Key key;
+        T data;
+        int32_t multiplicity;
+        whole = serializer.read(in, key) &&
+            in.read(&multiplicity, sizeof(multiplicity)) &&
+            serializer.read(in, data) && multiplicity > 0;
+        if (whole) {
+            Node<Key, T> * node = loaded.allocator.create(std::move(key),
+                std::move(data));
+            RBTREE_COUNT(allocations, 1);
+            node->setMultiplicity(multiplicity);
+            node->setColor(BLACK);
+            nodes.push_back(node);
+            loaded.count += multiplicity;
+        }
+    }
+    if (!whole || loaded.count != elements || !in.verify()) {
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            loaded.allocator.destroy(nodes[i]);
+            RBTREE_COUNT(frees, 1);
+        }
+        return false;
+    }
+    loaded.layBalanced(nodes);
+#if RBTREE_CHECKED
+    RBTREE_CHECK(loaded.ordered());
+#endif
+    loaded.fingerSearch = this->fingerSearch;
+    loaded.bloomFilter = this->bloomFilter;
+    *this = std::move(loaded);
+    return true;
+}
+
+/******************************************************************************
+ *                                                                           **
+ * FREEZING                                                                  **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+template<int Width>
+FrozenTree<Key, T, Compare, Width> RBTree<Key, T, Compare, Alloc>::freeze(void)
+    const {
+    std::vector<Key> keys;
+    std::vector<T> data;
+    std::vector<int> multiplicities;
+    for (Node<Key, T> * n = this->leftmost; n != NULL; n = this->next(n)) {
+        keys.push_back(n->getKey());
+        data.push_back(n->getData());
+        multiplicities.push_back(n->getMultiplicity());
+    }
+    return FrozenTree<Key, T, Compare, Width>(std::move(keys), std::move(data),
+        multiplicities, this->getCompare());
+}
 #endif
@@ -0,0 +1,272 @@
+#ifndef SHARDEDRBTREE_CLASS
+#define SHARDEDRBTREE_CLASS
+
+#include <stddef.h>//This gets NULL
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "RBTree.hh"
+
+template<typename Key, typename T, typename Compare = std::less<Key>,
+    typename Alloc = NodePool<Node<Key, T> > >
+/**
+ * @breif The ShardedRBTree is a multiset that many threads can use at once.
+ *        The key range is split into shards, each shard is a RBTree with a
+ *        lock of its own.
+ *
+ * The shards are given by their bounds, n bounds make n + 1 shards, and the
+ * shard i holds the keys from the bound i - 1, included, to the bound i, not
+ * included. insert(), exists() and extract() lock only the shard of the key,
+ * so threads working on different shards don't wait for each other. The
+ * shards follow the key order, so walking them one after the other walks the
+ * whole multiset in order, and min() and max() only look at the first and
+ * last shard that isn't empty.
+ *
+ * Nodes are never handed out, they could change once the lock is let go,
+ * the data is copied instead.
+ */
+class ShardedRBTree : private KeyCompare<Compare>{
+    private:
+        /**
+         * @breif A tree and its lock, on cache lines of their own so two
+         *        shards never share one.
+         */
+        struct alignas(64) Shard {
+            std::mutex lock;
+            RBTree<Key, T, Compare, Alloc> tree;
+
+            Shard(const Compare & compare) : tree(compare) {}
+        };
+
+        /**
+         * @breif The bounds between the shards, sorted.
+         */
+        std::vector<Key> bounds;
+
+        /**
+         * @breif The shards, one more than the bounds.
+         */
+        std::unique_ptr<std::unique_ptr<Shard>[]> shards;
+
+        /**
+         * @breif Returns the shard that holds a key.
+         * @param key The key.
+         * @return The shard.
+         */
+        Shard & shardOf(const Key & key);
+
+    public:
+        /**
+         * @breif Creates an empty multiset.
+         * @param bounds  The keys where a shard ends and the next one starts,
+         *                they are sorted if they aren't.
+         * @param compare The comparator of the keys.
+         */
+        ShardedRBTree(const std::vector<Key> & bounds,
+            const Compare & compare = Compare());
+
+        ShardedRBTree(const ShardedRBTree & other) = delete;
+        ShardedRBTree & operator=(const ShardedRBTree & other) = delete;
+
+        /**
+         * @breif Returns how many shards there are.
+         * @return The number of shards.
+         */
+        size_t shardCount(void) const;
+
+        /**
+         * @breif Inserts a key-data pair, see RBTree::insert().
+         * @param key  The key value to insert.
+         * @param data The data to insert.
+         * @return True if the data was inserted.
+         */
+        bool insert(const Key & key, const T & data);
+
+        /**
+         * @breif Inserts a key-data pair, moving the data.
+         * @param key  The key value to insert.
+         * @param data The data to insert.
+         * @return True if the data was inserted.
+         */
+        bool insert(const Key & key, T && data);
+
+        /**
+         * @breif Returns the multiplicity of a key.
+         * @param key The key to search for.
+         * @return The multiplicity, 0 if the key is not in the multiset.
+         */
+        int exists(const Key & key);
+
+        /**
+         * @breif Extracts an element, see RBTree::extract().
+         * @param key The key to extract.
+         * @return The extracted data, a default constructed one if the key is
+         *         not in the multiset.
+         */
+        T extract(const Key & key);
+
+        /**
+         * @breif Copies the element with the lowest key.
+         * @param key  Where the key is copied, may be NULL.
+         * @param data Where the data is copied, may be NULL.
+         * @return False if the multiset is empty.
+         */
+        bool min(Key * key, T * data);
+
+        /**
+         * @breif Copies the element with the highest key.
+         * @param key  Where the key is copied, may be NULL.
+         * @param data Where the data is copied, may be NULL.
+         * @return False if the multiset is empty.
+         */
+        bool max(Key * key, T * data);
+
+        /**
+         * @breif Returns how many elements there are, multiplicities
+         *        included. The shards are counted one after the other.
+         * @return The number of elements.
+         */
+        size_t size(void);
+
+        /**
+         * @breif Calls a function on every node in key order. Every shard is
+         *        locked first, so the function sees one consistent multiset,
+         *        and writers wait until it's done.
+         * @param fn The function, called with a const Node<Key, T> &.
+         * @return How many nodes were visited.
+         */
+        template<typename Function>
+        size_t for_each(Function fn);
+};
+
+/******************************************************************************
+ *                                                                           **
+ * CLASS IMPLEMENTATION                                                      **
+ *                                                                           **
+ ******************************************************************************/
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+ShardedRBTree<Key, T, Compare, Alloc>::ShardedRBTree(
+    const std::vector<Key> & bounds, const Compare & compare) :
+    KeyCompare<Compare>(compare), bounds(bounds) {
+    std::sort(this->bounds.begin(), this->bounds.end(),
+        [this](const Key & a, const Key & b) { return this->less(a, b); });
+    this->shards.reset(new std::unique_ptr<Shard>[this->bounds.size() + 1]);
+    for (size_t i = 0; i <= this->bounds.size(); ++i) {
+        this->shards[i].reset(new Shard(compare));
+    }
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+typename ShardedRBTree<Key, T, Compare, Alloc>::Shard &
+ShardedRBTree<Key, T, Compare, Alloc>::shardOf(const Key & key) {
+    size_t i = std::upper_bound(this->bounds.begin(), this->bounds.end(), key,
+        [this](const Key & a, const Key & b) { return this->less(a, b); }) -
+        this->bounds.begin();
+    return *this->shards[i];
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+size_t ShardedRBTree<Key, T, Compare, Alloc>::shardCount(void) const {
+    return this->bounds.size() + 1;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool ShardedRBTree<Key, T, Compare, Alloc>::insert(const Key & key,
+    const T & data) {
+    Shard & shard = this->shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.lock);
+    return shard.tree.insert(key, data);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool ShardedRBTree<Key, T, Compare, Alloc>::insert(const Key & key,
+    T && data) {
+    Shard & shard = this->shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.lock);
+    return shard.tree.insert(key, std::move(data));
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+int ShardedRBTree<Key, T, Compare, Alloc>::exists(const Key & key) {
+    Shard & shard = this->shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.lock);
+    return shard.tree.exists(key);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+T ShardedRBTree<Key, T, Compare, Alloc>::extract(const Key & key) {
+    Shard & shard = this->shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.lock);
+    return shard.tree.extract(key);
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool ShardedRBTree<Key, T, Compare, Alloc>::min(Key * key, T * data) {
+    for (size_t i = 0; i < this->shardCount(); ++i) {
+        std::lock_guard<std::mutex> lock(this->shards[i]->lock);
+        Node<Key, T> * node = this->shards[i]->tree.first();
+        if (node != NULL) {
+            if (key != NULL) *key = node->getKey();
+            if (data != NULL) *data = node->getData();
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+bool ShardedRBTree<Key, T, Compare, Alloc>::max(Key * key, T * data) {
+    for (size_t i = this->shardCount(); i > 0; --i) {
+        std::lock_guard<std::mutex> lock(this->shards[i - 1]->lock);
+        Node<Key, T> * node = this->shards[i - 1]->tree.last();
+        if (node != NULL) {
+            if (key != NULL) *key = node->getKey();
+            if (data != NULL) *data = node->getData();
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+size_t ShardedRBTree<Key, T, Compare, Alloc>::size(void) {
+    size_t elements = 0;
+    for (size_t i = 0; i < this->shardCount(); ++i) {
+        std::lock_guard<std::mutex> lock(this->shards[i]->lock);
+        elements += this->shards[i]->tree.size();
+    }
+    return elements;
+}
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+template<typename Function>
+size_t ShardedRBTree<Key, T, Compare, Alloc>::for_each(Function fn) {
+    // Always locked in the same order, so two walks can't deadlock.
+    for (size_t i = 0; i < this->shardCount(); ++i) {
+        this->shards[i]->lock.lock();
+    }
+    size_t visited = 0;
+    try {
+        for (size_t i = 0; i < this->shardCount(); ++i) {
+            RBTree<Key, T, Compare, Alloc> & tree = this->shards[i]->tree;
+            for (Node<Key, T> * node = tree.first(); node != NULL;
+                node = tree.next(node)) {
+                fn(static_cast<const Node<Key, T> &>(*node));
+                ++visited;
+            }
+        }
+    } catch (...) {
+        for (size_t i = 0; i < this->shardCount(); ++i) {
+            this->shards[i]->lock.unlock();
+        }
+        throw;
+    }
+    for (size_t i = 0; i < this->shardCount(); ++i) {
+        this->shards[i]->lock.unlock();
+    }
+    return visited;
+}
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef SYNCPOLICIES_ENUM
+#define SYNCPOLICIES_ENUM
+
+///When a journal flushes its records to the disk, the later, the cheaper and
+///the more records a crash of the machine may lose. Only SYNC_ALWAYS makes a
+///change durable before its call returns, with the others a change is only
+///sure to be on the disk once a commit() returned true.
+enum SyncPolicies {
+    SYNC_NEVER,///The records go to the system, which writes them when it likes.
+    ///The records are flushed to the disk in groups. There is no time bound:
+    ///a group is flushed when it's full, by commit() or by close(), so after
+    ///the last change of a burst up to a group less one record wait in the
+    ///buffer. Call commit() when the changes stop.
+    SYNC_GROUP,
+    SYNC_ALWAYS///Every record is flushed to the disk before the call returns.
+};
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef TREEITERATOR_CLASS
+#define TREEITERATOR_CLASS
+
+#include <stddef.h>//This gets NULL
+#include <iterator>
+#include <type_traits>
+
+template<typename Tree, typename Value>
+/**
+ * @breif The TreeIterator walks the nodes of a tree in key order, it's a
+ *        bidirectional iterator, so the tree can be used with <algorithm>.
+ *
+ * Each step visits one node, whatever its multiplicity. The past the end
+ * iterator holds a NULL node, and going back from it gives the last node.
+ * Value is the node type, const for a const_iterator. Tree must provide
+ * next(), previous() and last() as const methods.
+ */
+class TreeIterator{
+    public:
+        typedef typename std::remove_const<Value>::type NodeType;
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef NodeType value_type;
+        typedef ptrdiff_t difference_type;
+        typedef Value * pointer;
+        typedef Value & reference;
+
+    private:
+        /**
+         * @breif The tree being walked.
+         */
+        const Tree * tree;
+
+        /**
+         * @breif The current node, NULL past the end.
+         */
+        NodeType * node;
+
+    public:
+        /**
+         * @breif Creates an iterator that points nowhere.
+         */
+        TreeIterator(void) : tree(NULL), node(NULL) {}
+
+        /**
+         * @breif Creates an iterator on a node of a tree.
+         * @param tree The tree.
+         * @param node The node, NULL for past the end.
+         */
+        TreeIterator(const Tree * tree, NodeType * node) :
+            tree(tree), node(node) {}
+
+        /**
+         * @breif Creates a const iterator from a mutable one.
+         * @param other The mutable iterator.
+         */
+        template<typename Other, typename = typename std::enable_if<
+            std::is_const<Value>::value &&
+            std::is_same<Other, NodeType>::value>::type>
+        TreeIterator(const TreeIterator<Tree, Other> & other) :
+            tree(other.getTree()), node(other.getNode()) {}
+
+        /**
+         * @breif Returns the current node.
+         * @return The node, NULL past the end.
+         */
+        NodeType * getNode(void) const {
+            return this->node;
+        }
+
+        /**
+         * @breif Returns the tree being walked.
+         * @return The tree.
+         */
+        const Tree * getTree(void) const {
+            return this->tree;
+        }
+
+        reference operator*(void) const {
+            return *this->node;
+        }
+
+        pointer operator->(void) const {
+            return this->node;
+        }
+
+        TreeIterator & operator++(void) {
+            this->node = this->tree->next(this->node);
+            return *this;
+        }
+
+        TreeIterator operator++(int) {
+            TreeIterator before = *this;
+            ++*this;
+            return before;
+        }
+
+        TreeIterator & operator--(void) {
+            this->node = this->node == NULL? this->tree->last():
+                this->tree->previous(this->node);
+            return *this;
+        }
+
+        TreeIterator operator--(int) {
+            TreeIterator before = *this;
+            --*this;
+            return before;
+        }
+
+        template<typename Other>
+        bool operator==(const TreeIterator<Tree, Other> & other) const {
+            return this->node == other.getNode();
+        }
+
+        template<typename Other>
+        bool operator!=(const TreeIterator<Tree, Other> & other) const {
+            return this->node != other.getNode();
+        }
+};
+
+#endif
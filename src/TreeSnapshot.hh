@@ -0,0 +1,339 @@
+#ifndef TREESNAPSHOT_CLASS
+#define TREESNAPSHOT_CLASS
+
+#include <stddef.h>//This gets NULL
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @breif The first bytes of a snapshot, "RBTS" when read in the byte order
+ *        it was written in.
+ */
+const uint32_t SNAPSHOT_MAGIC = 0x53544252;
+
+/**
+ * @breif The version of the snapshot format, a file of another one isn't
+ *        read.
+ */
+const uint32_t SNAPSHOT_VERSION = 1;
+
+/**
+ * @breif Adds bytes to a running checksum. The bytes are taken eight at a
+ *        time, so a stream fed in pieces whose sizes are multiples of eight,
+ *        but the last one, sums the same as if it was fed at once.
+ * @param sum   The checksum so far.
+ * @param bytes The bytes.
+ * @param size  How many bytes.
+ * @return The new checksum.
+ */
+inline uint64_t snapshotChecksum(uint64_t sum, const char * bytes,
+    size_t size) {
+    const uint64_t prime = 0x100000001b3ULL;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        sum = (sum ^ word) * prime;
+        sum ^= sum >> 29;
+    }
+    for (; i < size; ++i) {
+        sum = (sum ^ (unsigned char) bytes[i]) * prime;
+    }
+    return sum;
+}
+
+/**
+ * @breif The SnapshotWriter writes a file through a buffer and keeps the
+ *        checksum of what it wrote, close() ends the file with it.
+ */
+class SnapshotWriter{
+    private:
+        FILE * file;
+        std::vector<char> buffer;
+        size_t used = 0;
+        uint64_t sum = 0xcbf29ce484222325ULL;
+        bool failed = false;
+
+        /**
+         * @breif Writes the buffer to the file.
+         */
+        void flush(void);
+
+    public:
+        /**
+         * @breif How many bytes are buffered before they are written.
+         */
+        static const size_t bufferSize = 1 << 16;
+
+        /**
+         * @breif Creates the file, or empties it.
+         * @param path The path of the file.
+         */
+        explicit SnapshotWriter(const char * path);
+
+        SnapshotWriter(const SnapshotWriter & other) = delete;
+        SnapshotWriter & operator=(const SnapshotWriter & other) = delete;
+
+        /**
+         * @breif Closes the file if close() wasn't called.
+         */
+        ~SnapshotWriter(void);
+
+        /**
+         * @breif Tells if everything went well so far.
+         * @return False if the file couldn't be opened or written.
+         */
+        bool good(void) const;
+
+        /**
+         * @breif Writes bytes.
+         * @param bytes The bytes.
+         * @param size  How many bytes.
+         */
+        void write(const void * bytes, size_t size);
+
+        /**
+         * @breif Writes the checksum, flushes the file to the disk and closes
+         *        it.
+         * @return False if anything failed since the file was opened.
+         */
+        bool close(void);
+};
+
+/**
+ * @breif The SnapshotReader reads a file written by a SnapshotWriter through
+ *        a buffer, the checksum at its end is left out and compared by
+ *        verify().
+ */
+class SnapshotReader{
+    private:
+        FILE * file;
+        std::vector<char> buffer;
+        size_t used = 0;
+        size_t filled = 0;
+        uint64_t left = 0;
+        uint64_t sum = 0xcbf29ce484222325ULL;
+        bool failed = false;
+
+        /**
+         * @breif Reads the next piece of the file into the buffer.
+         * @return False if there is nothing left before the checksum.
+         */
+        bool fill(void);
+
+    public:
+        /**
+         * @breif Opens a file.
+         * @param path The path of the file.
+         */
+        explicit SnapshotReader(const char * path);
+
+        SnapshotReader(const SnapshotReader & other) = delete;
+        SnapshotReader & operator=(const SnapshotReader & other) = delete;
+
+        /**
+         * @breif Closes the file.
+         */
+        ~SnapshotReader(void);
+
+        /**
+         * @breif Tells if everything went well so far.
+         * @return False if the file couldn't be opened or was too short.
+         */
+        bool good(void) const;
+
+        /**
+         * @breif Returns how many bytes are left before the checksum.
+         * @return The number of bytes.
+         */
+        uint64_t remaining(void) const;
+
+        /**
+         * @breif Reads bytes.
+         * @param bytes Where the bytes are copied.
+         * @param size  How many bytes.
+         * @return False if the file ends before.
+         */
+        bool read(void * bytes, size_t size);
+
+        /**
+         * @breif Checks that every byte was read and that the checksum at
+         *        the end of the file is the one of the bytes.
+         * @return True if the file is whole.
+         */
+        bool verify(void);
+};
+
+/**
+ * @breif The RawSerializer writes values as their bytes, which is right for
+ *        trivially copyable types only. A serializer for other types gives a
+ *        write() and a read() for them, like these ones, and may inherit
+ *        these for the rest. The streams are a SnapshotWriter and a
+ *        SnapshotReader, or anything with the same write(), read() and
+ *        remaining(), like the records of a journal.
+ */
+struct RawSerializer {
+    template<typename Out, typename X>
+    void write(Out & out, const X & value) {
+        static_assert(std::is_trivially_copyable<X>::value,
+            "give the snapshot a serializer for this type");
+        out.write(&value, sizeof(X));
+    }
+
+    template<typename In, typename X>
+    bool read(In & in, X & value) {
+        static_assert(std::is_trivially_copyable<X>::value,
+            "give the snapshot a serializer for this type");
+        return in.read(&value, sizeof(X));
+    }
+};
+
+/**
+ * @breif Reads the checksum a snapshot ends with, which tells it from other
+ *        snapshots without reading it whole.
+ * @param path The path of the snapshot.
+ * @param sum  Where the checksum is written.
+ * @return False if the file can't be read.
+ */
+inline bool snapshotChecksumOf(const char * path, uint64_t * sum);
+
+/******************************************************************************
+ *                                                                           **
+ * CLASS IMPLEMENTATION                                                      **
+ *                                                                           **
+ ******************************************************************************/
+
+inline SnapshotWriter::SnapshotWriter(const char * path) :
+    buffer(bufferSize) {
+    this->file = fopen(path, "wb");
+    this->failed = this->file == NULL;
+}
+
+inline SnapshotWriter::~SnapshotWriter(void) {
+    if (this->file != NULL) fclose(this->file);
+}
+
+inline bool SnapshotWriter::good(void) const {
+    return !this->failed;
+}
+
+inline void SnapshotWriter::flush(void) {
+    if (this->failed || this->used == 0) return;
+    this->sum = snapshotChecksum(this->sum, &this->buffer[0], this->used);
+    if (fwrite(&this->buffer[0], 1, this->used, this->file) != this->used) {
+        this->failed = true;
+    }
+    this->used = 0;
+}
+
+inline void SnapshotWriter::write(const void * bytes, size_t size) {
+    const char * from = static_cast<const char *>(bytes);
+    while (size > 0) {
+        size_t piece = bufferSize - this->used < size? bufferSize - this->used:
+            size;
+        memcpy(&this->buffer[this->used], from, piece);
+        this->used += piece;
+        from += piece;
+        size -= piece;
+        if (this->used == bufferSize) this->flush();
+    }
+}
+
+inline bool SnapshotWriter::close(void) {
+    if (this->file == NULL) return false;
+    this->flush();
+    if (!this->failed &&
+        fwrite(&this->sum, sizeof(this->sum), 1, this->file) != 1) {
+        this->failed = true;
+    }
+    // The file is renamed over the old snapshot, it must be on the disk
+    // before.
+    if (fflush(this->file) != 0 || fsync(fileno(this->file)) != 0) {
+        this->failed = true;
+    }
+    if (fclose(this->file) != 0) this->failed = true;
+    this->file = NULL;
+    return !this->failed;
+}
+
+inline SnapshotReader::SnapshotReader(const char * path) :
+    buffer(SnapshotWriter::bufferSize) {
+    this->file = fopen(path, "rb");
+    long size = -1;
+    if (this->file != NULL && fseek(this->file, 0, SEEK_END) == 0) {
+        size = ftell(this->file);
+        rewind(this->file);
+    }
+    this->failed = size < (long) sizeof(this->sum);
+    if (!this->failed) this->left = size - sizeof(this->sum);
+}
+
+inline SnapshotReader::~SnapshotReader(void) {
+    if (this->file != NULL) fclose(this->file);
+}
+
+inline bool SnapshotReader::good(void) const {
+    return !this->failed;
+}
+
+inline uint64_t SnapshotReader::remaining(void) const {
+    return this->left + (this->filled - this->used);
+}
+
+inline bool SnapshotReader::fill(void) {
+    if (this->failed || this->left == 0) return false;
+    size_t piece = this->left < this->buffer.size()? this->left:
+        this->buffer.size();
+    if (fread(&this->buffer[0], 1, piece, this->file) != piece) {
+        this->failed = true;
+        return false;
+    }
+    this->sum = snapshotChecksum(this->sum, &this->buffer[0], piece);
+    this->left -= piece;
+    this->used = 0;
+    this->filled = piece;
+    return true;
+}
+
+inline bool SnapshotReader::read(void * bytes, size_t size) {
+    char * to = static_cast<char *>(bytes);
+    while (size > 0) {
+        if (this->used == this->filled && !this->fill()) {
+            this->failed = true;
+            return false;
+        }
+        size_t piece = this->filled - this->used < size?
+            this->filled - this->used: size;
+        memcpy(to, &this->buffer[this->used], piece);
+        this->used += piece;
+        to += piece;
+        size -= piece;
+    }
+    return true;
+}
+
+inline bool SnapshotReader::verify(void) {
+    uint64_t stored;
+    if (this->failed || this->remaining() != 0 ||
+        fread(&stored, sizeof(stored), 1, this->file) != 1) {
+        return false;
+    }
+    return stored == this->sum;
+}
+
+inline bool snapshotChecksumOf(const char * path, uint64_t * sum) {
+    FILE * file = fopen(path, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    bool read = fseek(file, -(long) sizeof(*sum), SEEK_END) == 0 &&
+        fread(sum, sizeof(*sum), 1, file) == 1;
+    fclose(file);
+    return read;
+}
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef TREESTATS_CLASS
+#define TREESTATS_CLASS
+
+#include <stddef.h>//This gets NULL
+#include <stdint.h>
+#include <chrono>
+
+/**
+ * @breif A histogram of the latencies of the sampled operations of a kind,
+ *        in buckets of powers of two nanoseconds.
+ */
+struct LatencyHistogram {
+    static const int buckets = 40;
+
+    uint64_t operations = 0;///How many operations ran, sampled or not.
+    uint64_t samples = 0;///How many of them were timed.
+    uint64_t counts[buckets] = {};///counts[i] took from 2^i to 2^(i+1) ns.
+
+    /**
+     * @breif Adds a sample.
+     * @param ns The nanoseconds it took.
+     */
+    void add(uint64_t ns) {
+        int bucket = 0;
+        while (ns > 1 && bucket < buckets - 1) {
+            ns >>= 1;
+            ++bucket;
+        }
+        ++this->counts[bucket];
+        ++this->samples;
+    }
+
+    /**
+     * @breif Returns a bound of the latency of a fraction of the samples.
+     * @param fraction The fraction, 0.5 for the median.
+     * @return The nanoseconds that fraction of the samples took at most, the
+     *         top of their bucket, 0 if there are no samples.
+     */
+    uint64_t percentile(double fraction) const {
+        uint64_t seen = 0;
+        for (int i = 0; i < buckets; ++i) {
+            seen += this->counts[i];
+            if (seen > 0 && seen >= fraction * this->samples) {
+                return (uint64_t) 2 << i;
+            }
+        }
+        return 0;
+    }
+};
+
+/**
+ * @breif What a tree did since it was created or its stats were reset, see
+ *        RBTree::stats().
+ */
+struct TreeStats {
+    uint64_t rotateLeft = 0;
+    uint64_t rotateRight = 0;
+    uint64_t insertCases[5] = {};///insertCases[i] counts insertCase<i + 1>.
+    uint64_t recolors = 0;///Colors set by the insert and delete fix-ups.
+    uint64_t descents = 0;///Searches down the tree.
+    uint64_t comparisons = 0;///Key comparisons of the descents.
+    uint64_t depth = 0;///Nodes the descents went through.
+    uint64_t allocations = 0;///Nodes created.
+    uint64_t frees = 0;///Nodes destroyed one by one.
+    uint64_t releases = 0;///Times every node was given back at once.
+    uint64_t multiplicityHits = 0;///Inserts that only raised a multiplicity.
+    LatencyHistogram inserts;
+    LatencyHistogram lookups;
+    LatencyHistogram extracts;
+};
+
+/**
+ * @breif Times one of every few operations into a histogram, from its
+ *        creation to its destruction.
+ */
+class LatencySample{
+    private:
+        LatencyHistogram & histogram;
+        std::chrono::steady_clock::time_point start;
+        bool timed;
+
+    public:
+        /**
+         * @breif Counts an operation, and starts timing it if it's sampled.
+         * @param histogram The histogram of the kind of operation.
+         * @param period    One operation out of this many is timed.
+         */
+        LatencySample(LatencyHistogram & histogram, uint64_t period) :
+            histogram(histogram),
+            timed(++histogram.operations % period == 0) {
+            if (this->timed) {
+                this->start = std::chrono::steady_clock::now();
+            }
+        }
+
+        LatencySample(const LatencySample & other) = delete;
+        LatencySample & operator=(const LatencySample & other) = delete;
+
+        ~LatencySample(void) {
+            if (this->timed) {
+                this->histogram.add(std::chrono::duration_cast<
+                    std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                    this->start).count());
+            }
+        }
+};
+
+#endif
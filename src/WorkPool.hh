@@ -0,0 +1,255 @@
+#ifndef WORKPOOL_CLASS
+#define WORKPOOL_CLASS
+
+#include <stddef.h>//This gets NULL
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @breif The WorkPool runs batches of numbered tasks on a fixed set of
+ *        threads that steal work from each other.
+ *
+ * Every worker has a queue of its own. run() hands each worker a contiguous
+ * block of the tasks, so neighbouring tasks stay on one thread, a worker
+ * takes its tasks from the front of its queue and, once it runs dry, steals
+ * from the back of the others. The thread that calls run() is the worker 0,
+ * the pool only starts the others.
+ */
+class WorkPool{
+    private:
+        /**
+         * @breif The tasks a worker has left, on a cache line of their own.
+         */
+        struct alignas(64) Queue {
+            std::mutex lock;
+            std::deque<size_t> tasks;
+        };
+
+        /**
+         * @breif The started threads, the workers 1 and up.
+         */
+        std::vector<std::thread> threads;
+
+        /**
+         * @breif The queue of every worker.
+         */
+        std::unique_ptr<Queue[]> queues;
+
+        /**
+         * @breif The task function of the current batch.
+         */
+        std::function<void(size_t, size_t)> job;
+
+        /**
+         * @breif Guards the batch state below.
+         */
+        std::mutex guard;
+
+        /**
+         * @breif Wakes the threads when a batch starts or the pool stops.
+         */
+        std::condition_variable wake;
+
+        /**
+         * @breif Wakes run() when the last thread is done with a batch.
+         */
+        std::condition_variable done;
+
+        /**
+         * @breif Counts the batches, a thread works when it changes.
+         */
+        size_t batch = 0;
+
+        /**
+         * @breif How many threads are still in the current batch.
+         */
+        size_t busy = 0;
+
+        /**
+         * @breif True once the pool is being destroyed.
+         */
+        bool stopping = false;
+
+        /**
+         * @breif The first exception a task threw in the current batch.
+         */
+        std::exception_ptr failure;
+
+        /**
+         * @breif Takes the next task of a worker, its own or a stolen one.
+         * @param worker The worker.
+         * @param task   Where the task number is written.
+         * @return False if every queue is empty.
+         */
+        bool take(size_t worker, size_t * task);
+
+        /**
+         * @breif Runs tasks until there are none left.
+         * @param worker The worker running them.
+         */
+        void work(size_t worker);
+
+        /**
+         * @breif The loop of the started threads.
+         * @param worker The worker of the thread.
+         */
+        void loop(size_t worker);
+
+    public:
+        /**
+         * @breif Creates a pool and starts its threads.
+         * @param workers How many workers, the caller of run() included, 0
+         *                for one per hardware thread.
+         */
+        explicit WorkPool(size_t workers = 0);
+
+        WorkPool(const WorkPool & other) = delete;
+        WorkPool & operator=(const WorkPool & other) = delete;
+
+        /**
+         * @breif Stops and joins the threads.
+         */
+        ~WorkPool();
+
+        /**
+         * @breif Returns how many workers there are.
+         * @return The number of workers.
+         */
+        size_t size(void) const;
+
+        /**
+         * @breif Runs a batch of tasks and waits until all of them are done.
+         *        If a task throws, the rest still run and the first exception
+         *        is thrown again here.
+         * @param tasks How many tasks, numbered from 0.
+         * @param task  The function, called with the task number and the
+         *              worker running it, from 0 to size() - 1.
+         */
+        template<typename Task>
+        void run(size_t tasks, Task task);
+};
+
+/******************************************************************************
+ *                                                                           **
+ * CLASS IMPLEMENTATION                                                      **
+ *                                                                           **
+ ******************************************************************************/
+
+inline WorkPool::WorkPool(size_t workers) {
+    if (workers == 0) {
+        workers = std::thread::hardware_concurrency();
+    }
+    if (workers == 0) {
+        workers = 1;
+    }
+    this->queues.reset(new Queue[workers]);
+    for (size_t i = 1; i < workers; ++i) {
+        this->threads.emplace_back(&WorkPool::loop, this, i);
+    }
+}
+
+inline WorkPool::~WorkPool() {
+    {
+        std::lock_guard<std::mutex> lock(this->guard);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+    for (std::thread & thread : this->threads) {
+        thread.join();
+    }
+}
+
+inline size_t WorkPool::size(void) const {
+    return this->threads.size() + 1;
+}
+
+inline bool WorkPool::take(size_t worker, size_t * task) {
+    {
+        Queue & own = this->queues[worker];
+        std::lock_guard<std::mutex> lock(own.lock);
+        if (!own.tasks.empty()) {
+            *task = own.tasks.front();
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < this->size(); ++i) {
+        Queue & other = this->queues[(worker + i) % this->size()];
+        std::lock_guard<std::mutex> lock(other.lock);
+        if (!other.tasks.empty()) {
+            *task = other.tasks.back();
+            other.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void WorkPool::work(size_t worker) {
+    size_t task;
+    while (this->take(worker, &task)) {
+        try {
+            this->job(task, worker);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(this->guard);
+            if (!this->failure) this->failure = std::current_exception();
+        }
+    }
+}
+
+inline void WorkPool::loop(size_t worker) {
+    size_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(this->guard);
+            this->wake.wait(lock, [&] {
+                return this->stopping || this->batch != seen;
+            });
+            if (this->stopping) return;
+            seen = this->batch;
+        }
+        this->work(worker);
+        std::lock_guard<std::mutex> lock(this->guard);
+        if (--this->busy == 0) this->done.notify_one();
+    }
+}
+
+template<typename Task>
+void WorkPool::run(size_t tasks, Task task) {
+    size_t workers = this->size();
+    for (size_t i = 0; i < workers; ++i) {
+        std::lock_guard<std::mutex> lock(this->queues[i].lock);
+        for (size_t t = tasks * i / workers; t < tasks * (i + 1) / workers;
+            ++t) {
+            this->queues[i].tasks.push_back(t);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(this->guard);
+        this->job = task;
+        this->failure = NULL;
+        this->busy = this->threads.size();
+        ++this->batch;
+    }
+    this->wake.notify_all();
+    this->work(0);
+    std::exception_ptr failure;
+    {
+        // The threads may still be on their last task, the job has to
+        // outlive them.
+        std::unique_lock<std::mutex> lock(this->guard);
+        this->done.wait(lock, [this] { return this->busy == 0; });
+        this->job = NULL;
+        failure = this->failure;
+        this->failure = NULL;
+    }
+    if (failure) std::rethrow_exception(failure);
+}
+
+#endif
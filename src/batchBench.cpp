@@ -0,0 +1,67 @@
+#include <iostream>
+#include <stdlib.h>
+#include <utility>
+#include <vector>
+#include "Bench.hh"
+#include "RBTree.hh"
+
+using namespace std;
+
+/**
+ * @breif Feeds bursts of events to a tree that already holds n keys, one
+ *        element at a time and with insert_batch, and prints the ns per
+ *        element. The random bursts spread over the whole key range, the
+ *        clustered ones fall in a narrow window, like events of one source.
+ *        Usage: batchBench [keys] [events]
+ */
+int main(int argc, char ** argv) {
+    int n = argc > 1? atoi(argv[1]): 1000000;
+    int events = argc > 2? atoi(argv[2]): 1000000;
+    if (n <= 0 || events <= 0) {
+        cout << "usage: batchBench [keys] [events]" << endl;
+        return 1;
+    }
+    const int bursts[] = {10, 100, 1000, 10000};
+    cout << "burst\tkeys\t\tone by one ns\tbatch ns" << endl;
+    for (int clustered = 0; clustered < 2; ++clustered) {
+        for (int burst : bursts) {
+            KeyGenerator gen;
+            vector<pair<int, int> > initial(n), stream(events);
+            for (int i = 0; i < n; ++i) {
+                int key = gen.nextKey(1 << 30);
+                initial[i] = make_pair(key, key);
+            }
+            for (int i = 0; i < events; ++i) {
+                int base = clustered? (i / burst) * 4096: 0;
+                int key = clustered? base + gen.nextKey(burst * 4):
+                    gen.nextKey(1 << 30);
+                stream[i] = make_pair(key, key);
+            }
+
+            RBTree<int, int> * single = new RBTree<int, int>();
+            RBTree<int, int> * batched = new RBTree<int, int>();
+            single->insert_batch(initial.begin(), initial.end());
+            batched->insert_batch(initial.begin(), initial.end());
+
+            Stopwatch watch;
+            for (int i = 0; i < events; ++i) {
+                single->insert(stream[i].first, stream[i].second);
+            }
+            double singleNs = watch.elapsedNs() / events;
+            watch.restart();
+            for (int i = 0; i < events; i += burst) {
+                int end = i + burst < events? i + burst: events;
+                batched->insert_batch(stream.begin() + i, stream.begin() + end);
+            }
+            double batchNs = watch.elapsedNs() / events;
+
+            cout << burst << "\t" << (clustered? "clustered": "random\t") << "\t"
+                << singleNs << "\t\t" << batchNs << endl;
+            if (single->size() != batched->size() || !batched->validate()) {
+                cout << "the trees differ" << endl;
+            }
+            delete single;
+            delete batched;
+        }
+    }
+}
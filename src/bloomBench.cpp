@@ -0,0 +1,65 @@
+#include <iomanip>
+#include <iostream>
+#include <stdlib.h>
+#include <vector>
+#include "Bench.hh"
+#include "RBTree.hh"
+
+using namespace std;
+
+/**
+ * @breif Times exists() on one tree for keys that are there and for keys
+ *        that aren't, and on inserts, and prints the ns per key of each.
+ * @param name    The name printed for the tree.
+ * @param bloom   Wether the tree has the Bloom filter on.
+ * @param keys    The keys to insert and to look up.
+ * @param missing Keys that are not inserted.
+ */
+void measure(const char * name, bool bloom, const vector<int> & keys,
+    const vector<int> & missing) {
+    size_t n = keys.size();
+    RBTree<int, int> tree;
+    tree.setBloomFilter(bloom);
+    Stopwatch watch;
+    for (size_t i = 0; i < n; ++i) tree.insert(keys[i], keys[i]);
+    double insert = watch.elapsedNs() / n;
+    long found = tree.exists(missing[0]);//the filter is built here
+    watch.restart();
+    for (size_t i = 0; i < n; ++i) found += tree.exists(keys[i]);
+    double hits = watch.elapsedNs() / n;
+    watch.restart();
+    for (size_t i = 0; i < n; ++i) found += tree.exists(missing[i]);
+    double misses = watch.elapsedNs() / n;
+    keep(found);
+    BloomStats stats = tree.bloomStats();
+    cout << n << "\t" << left << setw(8) << name << insert << "\t" << hits
+        << "\t" << misses << "\t" << stats.falsePositiveRate * 100 << "\t"
+        << stats.bytes * 8.0 / n << endl;
+}
+
+/**
+ * @breif Compares exists() of keys that are not in a tree with and without
+ *        the Bloom filter, on growing key sets up to n keys. Prints the ns
+ *        per key of inserts, of hits and of misses, the false positive
+ *        rate in % and the bits of filter per key.
+ *        Usage: bloomBench [keys]
+ */
+int main(int argc, char ** argv) {
+    int most = argc > 1? atoi(argv[1]): 1000000;
+    if (most <= 0) {
+        cout << "usage: bloomBench [keys]" << endl;
+        return 1;
+    }
+    cout << "keys\ttree    insert\thit\tmiss\tfp %\tbits/key" << endl;
+    for (int n = 10000; n <= most; n *= 10) {
+        KeyGenerator gen;
+        vector<int> keys(n), missing(n);
+        for (int i = 0; i < n; ++i) {
+            // Even keys go in, odd ones are missing.
+            keys[i] = gen.nextKey(1 << 29) * 2;
+            missing[i] = gen.nextKey(1 << 29) * 2 + 1;
+        }
+        measure("plain", false, keys, missing);
+        measure("bloom", true, keys, missing);
+    }
+}
@@ -0,0 +1,151 @@
+#include <iomanip>
+#include <iostream>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "Bench.hh"
+#include "BPlusTree.hh"
+#include "RBTree.hh"
+
+using namespace std;
+
+/**
+ * @breif A payload of 128 bytes, which B+-tree leaves move around on every
+ *        insert and extract, and red-black nodes never do.
+ */
+struct Wide {
+    int value;
+    char padding[124];
+
+    Wide(int value = 0) : value(value) {}
+    operator long(void) const { return this->value; }
+    bool operator==(const Wide & other) const {
+        return this->value == other.value;
+    }
+};
+
+/**
+ * @breif Times one tree on a set of keys: random inserts, lookups of keys
+ *        that are there and of keys that aren't, an in-order walk and the
+ *        extraction of every key, and prints the ns per key of each.
+ * @param name    The name printed for the tree.
+ * @param tree    The empty tree.
+ * @param keys    The keys to insert, then to look up and extract.
+ * @param missing Keys that are not inserted.
+ */
+template<typename Tree, typename Walk>
+void measure(const string & name, Tree & tree, const vector<int> & keys,
+    const vector<int> & missing, Walk walk) {
+    size_t n = keys.size();
+    double ns[5];
+    Stopwatch watch;
+    for (size_t i = 0; i < n; ++i) tree.insert(keys[i], keys[i]);
+    ns[0] = watch.elapsedNs() / n;
+    long found = 0;
+    watch.restart();
+    for (size_t i = 0; i < n; ++i) found += tree.exists(keys[i]);
+    ns[1] = watch.elapsedNs() / n;
+    watch.restart();
+    for (size_t i = 0; i < n; ++i) found += tree.exists(missing[i]);
+    ns[2] = watch.elapsedNs() / n;
+    watch.restart();
+    found += walk(tree);
+    ns[3] = watch.elapsedNs() / n;
+    watch.restart();
+    for (size_t i = 0; i < n; ++i) found += (long) tree.extract(keys[i]);
+    ns[4] = watch.elapsedNs() / n;
+    keep(found);
+    cout << n << "\t" << left << setw(12) << name;
+    for (int i = 0; i < 5; ++i) cout << (i == 0? "": "\t") << ns[i];
+    cout << endl;
+}
+
+/**
+ * @breif Sums the keys of a B+-tree in order.
+ */
+template<typename Tree>
+long walkPositions(Tree & tree) {
+    long sum = 0;
+    for (auto position = tree.first(); position;
+        position = tree.next(position)) {
+        sum += position.getKey();
+    }
+    return sum;
+}
+
+/**
+ * @breif Sums the keys of a red-black tree in order.
+ */
+template<typename Tree>
+long walkNodes(Tree & tree) {
+    long sum = 0;
+    for (auto node = tree.first(); node != NULL; node = tree.next(node)) {
+        sum += node->getKey();
+    }
+    return sum;
+}
+
+/**
+ * @breif Runs every tree on one key set.
+ * @param keys    The keys to insert.
+ * @param missing Keys that are not inserted.
+ * @param suffix  Added to the names of the trees.
+ */
+template<typename D>
+void compare(const vector<int> & keys, const vector<int> & missing,
+    const string & suffix) {
+    {
+        RBTree<int, D> tree;
+        measure("rbtree" + suffix, tree, keys, missing,
+            walkNodes<decltype(tree)>);
+    }
+    {
+        BPlusTree<int, D, less<int>, 8> tree;
+        measure("b+ 8" + suffix, tree, keys, missing,
+            walkPositions<decltype(tree)>);
+    }
+    {
+        BPlusTree<int, D, less<int>, 16> tree;
+        measure("b+ 16" + suffix, tree, keys, missing,
+            walkPositions<decltype(tree)>);
+    }
+    {
+        BPlusTree<int, D, less<int>, 32> tree;
+        measure("b+ 32" + suffix, tree, keys, missing,
+            walkPositions<decltype(tree)>);
+    }
+    {
+        BPlusTree<int, D, less<int>, 64> tree;
+        measure("b+ 64" + suffix, tree, keys, missing,
+            walkPositions<decltype(tree)>);
+    }
+}
+
+/**
+ * @breif Compares RBTree with BPlusTree of several fan-outs on growing key
+ *        sets, up to n keys, and prints the ns per key of every operation.
+ *        The largest set runs again with 128-byte payloads.
+ *        Usage: btreeBench [keys]
+ */
+int main(int argc, char ** argv) {
+    int most = argc > 1? atoi(argv[1]): 1000000;
+    if (most <= 0) {
+        cout << "usage: btreeBench [keys]" << endl;
+        return 1;
+    }
+    cout << "keys\ttree        insert\texists\tmissing\twalk\textract" << endl;
+    for (int n = 10000; n <= most; n *= 10) {
+        KeyGenerator gen;
+        vector<int> keys(n), missing(n);
+        for (int i = 0; i < n; ++i) {
+            // Even keys go in, odd ones are missing.
+            keys[i] = gen.nextKey(1 << 29) * 2;
+            missing[i] = gen.nextKey(1 << 29) * 2 + 1;
+        }
+        compare<int>(keys, missing, "");
+        if (n > most / 10) {
+            compare<Wide>(keys, missing, " wide");
+            break;
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#include <iostream>
+#include <stdlib.h>
+#include <tuple>
+#include <vector>
+#include "Bench.hh"
+#include "RBTree.hh"
+
+using namespace std;
+
+/**
+ * @breif Compares build_sorted against repeated insert on sorted records,
+ *        the way a restart reloads a queue. One record in eight repeats the
+ *        previous one, so multiplicities are collapsed too.
+ *        Usage: buildBench [records]
+ */
+int main(int argc, char ** argv) {
+    int n = argc > 1? atoi(argv[1]): 1000000;
+    if (n <= 0) {
+        cout << "usage: buildBench [records]" << endl;
+        return 1;
+    }
+    vector<tuple<int, int, int> > records;
+    KeyGenerator gen;
+    int key = 0;
+    for (int i = 0; i < n; ++i) {
+        if (gen.nextKey(8) != 0) key += 1 + gen.nextKey(4);
+        records.push_back(make_tuple(key, key, 1 + gen.nextKey(3)));
+    }
+
+    Stopwatch watch;
+    RBTree<int, int> built = RBTree<int, int>::build_sorted(records.begin(),
+        records.end());
+    double buildNs = watch.elapsedNs();
+
+    watch.restart();
+    RBTree<int, int> inserted;
+    for (int i = 0; i < n; ++i) {
+        for (int m = 0; m < get<2>(records[i]); ++m) {
+            inserted.insert(get<0>(records[i]), get<1>(records[i]));
+        }
+    }
+    double insertNs = watch.elapsedNs();
+
+    cout << "records: " << n << ", elements: " << built.size() << endl;
+    cout << "build_sorted\t" << buildNs / n << " ns/record" << endl;
+    cout << "insert\t\t" << insertNs / n << " ns/record" << endl;
+    cout << "same size: " << (built.size() == inserted.size()? "yes": "no")
+        << ", built tree is valid: " << (built.validate()? "yes": "no") << endl;
+}
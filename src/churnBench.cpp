@@ -0,0 +1,64 @@
+#include <iostream>
+#include <stdlib.h>
+#include <vector>
+#include "Bench.hh"
+#include "RBTree.hh"
+
+using namespace std;
+
+/**
+ * @breif Returns the height of a subtree.
+ * @param node The root of the subtree.
+ * @return The number of nodes in the longest path to a leaf.
+ */
+int height(Node<int, int> * node) {
+    if (node == NULL) return 0;
+    int left = height(node->getLeft());
+    int right = height(node->getRight());
+    return 1 + (left > right? left: right);
+}
+
+/**
+ * @breif Keeps a fixed number of live keys while inserting and extracting,
+ *        and prints the memory taken at every checkpoint. The pool capacity
+ *        and the resident memory should stay flat.
+ *        Usage: churnBench [live keys] [operations]
+ */
+int main(int argc, char ** argv) {
+    int liveSize = argc > 1? atoi(argv[1]): 100000;
+    long operations = argc > 2? atol(argv[2]): 10000000;
+    if (liveSize <= 0 || operations <= 0) {
+        cout << "usage: churnBench [live keys] [operations]" << endl;
+        return 1;
+    }
+
+    KeyGenerator gen;
+    RBTree<int, int> * rbt = new RBTree<int, int>();
+    vector<int> live(liveSize);
+    for (int i = 0; i < liveSize; ++i) {
+        live[i] = gen.nextKey(1 << 30);
+        rbt->insert(live[i], live[i]);
+    }
+
+    cout << "operations\tns/op\tlive nodes\tpool slots\tchunks\theight\tresident kB" << endl;
+    long checkpoint = operations / 10 > 0? operations / 10: 1;
+    Stopwatch watch;
+    for (long op = 1; op <= operations; ++op) {
+        // Every step takes out one old key and puts a new one in its place.
+        int slot = gen.nextKey(liveSize);
+        rbt->extract(live[slot]);
+        live[slot] = gen.nextKey(1 << 30);
+        rbt->insert(live[slot], live[slot]);
+        if (op % checkpoint == 0) {
+            double ns = watch.elapsedNs() / checkpoint;
+            cout << op << "\t" << ns << "\t" << rbt->getAllocator().getLive()
+                << "\t" << rbt->getAllocator().getCapacity()
+                << "\t" << rbt->getAllocator().getChunks()
+                << "\t" << height(rbt->getRoot())
+                << "\t" << residentKb() << endl;
+            watch.restart();
+        }
+    }
+    cout << "tree is valid: " << (rbt->validate()? "yes": "no") << endl;
+    delete rbt;
+}
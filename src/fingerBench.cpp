@@ -0,0 +1,53 @@
+#include <iostream>
+#include <stdlib.h>
+#include <vector>
+#include "Bench.hh"
+#include "RBTree.hh"
+
+using namespace std;
+
+/**
+ * @breif Inserts a stream of keys into a tree and measures it.
+ * @param keys   The stream.
+ * @param finger Wether the tree uses the finger search.
+ * @return The nanoseconds per insertion.
+ */
+double insertStream(const vector<int> & keys, bool finger) {
+    RBTree<int, int> * rbt = new RBTree<int, int>();
+    rbt->setFingerSearch(finger);
+    Stopwatch watch;
+    for (size_t i = 0; i < keys.size(); ++i) rbt->insert(keys[i], keys[i]);
+    double ns = watch.elapsedNs() / keys.size();
+    if (!rbt->validate()) cout << "the tree is not valid" << endl;
+    delete rbt;
+    return ns;
+}
+
+/**
+ * @breif Compares insertion from the root against the finger search on
+ *        sorted, nearly sorted and random key streams. In the nearly sorted
+ *        stream each key lands up to 64 places before the newest one, like
+ *        late events in a simulation.
+ *        Usage: fingerBench [keys]
+ */
+int main(int argc, char ** argv) {
+    int n = argc > 1? atoi(argv[1]): 1000000;
+    if (n <= 0) {
+        cout << "usage: fingerBench [keys]" << endl;
+        return 1;
+    }
+    KeyGenerator gen;
+    vector<int> sorted(n), nearly(n), random(n);
+    for (int i = 0; i < n; ++i) {
+        sorted[i] = i;
+        nearly[i] = 64 * i - gen.nextKey(64 * 64);
+        random[i] = gen.nextKey(1 << 30);
+    }
+    cout << "stream\t\troot ns/op\tfinger ns/op" << endl;
+    cout << "sorted\t\t" << insertStream(sorted, false) << "\t"
+        << insertStream(sorted, true) << endl;
+    cout << "nearly sorted\t" << insertStream(nearly, false) << "\t"
+        << insertStream(nearly, true) << endl;
+    cout << "random\t\t" << insertStream(random, false) << "\t"
+        << insertStream(random, true) << endl;
+}
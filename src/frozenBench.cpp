@@ -0,0 +1,130 @@
+#include <iomanip>
+#include <iostream>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "Bench.hh"
+#include "RBTree.hh"
+
+using namespace std;
+
+/**
+ * @breif Times lookups on one tree: of keys that are there, of keys that
+ *        aren't, lower bounds of the missing keys and an in-order walk, and
+ *        prints the ns per key of each.
+ * @param name    The name printed for the tree.
+ * @param tree    The tree.
+ * @param keys    The keys in the tree.
+ * @param missing Keys that are not in the tree.
+ * @param bound   Returns the key of the lower bound of a key.
+ * @param walk    Sums the keys in order.
+ * @param build   The ns per key it took to make the tree.
+ */
+template<typename Tree, typename Bound, typename Walk>
+void measure(const string & name, Tree & tree, const vector<int> & keys,
+    const vector<int> & missing, Bound bound, Walk walk, double build) {
+    size_t n = keys.size();
+    double ns[4];
+    long found = 0;
+    Stopwatch watch;
+    for (size_t i = 0; i < n; ++i) found += tree.exists(keys[i]);
+    ns[0] = watch.elapsedNs() / n;
+    watch.restart();
+    for (size_t i = 0; i < n; ++i) found += tree.exists(missing[i]);
+    ns[1] = watch.elapsedNs() / n;
+    watch.restart();
+    for (size_t i = 0; i < n; ++i) found += bound(tree, missing[i]);
+    ns[2] = watch.elapsedNs() / n;
+    watch.restart();
+    found += walk(tree);
+    ns[3] = watch.elapsedNs() / n;
+    keep(found);
+    cout << n << "\t" << left << setw(12) << name << build;
+    for (int i = 0; i < 4; ++i) cout << "\t" << ns[i];
+    cout << endl;
+}
+
+/**
+ * @breif Returns the key of the lower bound of a key in a red-black tree.
+ */
+long boundNode(RBTree<int, int> & tree, int key) {
+    RBTree<int, int>::iterator it = tree.lower_bound(key);
+    return it == tree.end()? 0: it->getKey();
+}
+
+/**
+ * @breif Sums the keys of a red-black tree in order.
+ */
+long walkNodes(RBTree<int, int> & tree) {
+    long sum = 0;
+    for (auto node = tree.first(); node != NULL; node = tree.next(node)) {
+        sum += node->getKey();
+    }
+    return sum;
+}
+
+/**
+ * @breif Returns the key of the lower bound of a key in a frozen tree.
+ */
+template<typename Tree>
+long boundPosition(Tree & tree, int key) {
+    auto position = tree.lower_bound(key);
+    return position? position.getKey(): 0;
+}
+
+/**
+ * @breif Sums the keys of a frozen tree in order.
+ */
+template<typename Tree>
+long walkPositions(Tree & tree) {
+    long sum = 0;
+    for (auto position = tree.first(); position;
+        position = tree.next(position)) {
+        sum += position.getKey();
+    }
+    return sum;
+}
+
+/**
+ * @breif Freezes a tree with blocks of Width keys and times it.
+ */
+template<int Width>
+void frozen(const string & name, RBTree<int, int> & tree,
+    const vector<int> & keys, const vector<int> & missing) {
+    Stopwatch watch;
+    FrozenTree<int, int, less<int>, Width> ice = tree.freeze<Width>();
+    double build = watch.elapsedNs() / keys.size();
+    measure(name, ice, keys, missing, boundPosition<decltype(ice)>,
+        walkPositions<decltype(ice)>, build);
+}
+
+/**
+ * @breif Compares lookups in RBTree with the ones in its frozen copies, the
+ *        binary Eytzinger layout and blocks of 4 and 16 keys, on growing key
+ *        sets up to n keys, and prints the ns per key of the freezing and of
+ *        every lookup. The lookups go in random order.
+ *        Usage: frozenBench [keys]
+ */
+int main(int argc, char ** argv) {
+    int most = argc > 1? atoi(argv[1]): 1000000;
+    if (most <= 0) {
+        cout << "usage: frozenBench [keys]" << endl;
+        return 1;
+    }
+    cout << "keys\ttree        freeze\texists\tmissing\tbound\twalk" << endl;
+    for (int n = 10000; n <= most; n *= 10) {
+        KeyGenerator gen;
+        vector<int> keys(n), missing(n);
+        for (int i = 0; i < n; ++i) {
+            // Even keys go in, odd ones are missing.
+            keys[i] = gen.nextKey(1 << 29) * 2;
+            missing[i] = gen.nextKey(1 << 29) * 2 + 1;
+        }
+        RBTree<int, int> tree;
+        for (int i = 0; i < n; ++i) tree.insert(keys[i], keys[i]);
+        measure("rbtree", tree, keys, missing, boundNode, walkNodes, 0);
+        frozen<1>("eytzinger", tree, keys, missing);
+        frozen<4>("blocks 4", tree, keys, missing);
+        frozen<16>("blocks 16", tree, keys, missing);
+    }
+}
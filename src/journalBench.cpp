@@ -0,0 +1,109 @@
+#include <iostream>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "Bench.hh"
+#include "JournaledRBTree.hh"
+
+using namespace std;
+
+/**
+ * @breif Runs a stream of inserts and extracts on a plain tree and on
+ *        journaled trees at every durability level, and prints the ns per
+ *        operation and how many times the journal was flushed to the disk.
+ *        Then times the recovery from the journal and a compaction.
+ *        SYNC_ALWAYS runs the first hundredth of the operations only.
+ *        Usage: journalBench [operations] [directory]
+ */
+int main(int argc, char ** argv) {
+    int n = argc > 1? atoi(argv[1]): 1000000;
+    string directory = argc > 2? argv[2]: ".";
+    if (n <= 0) {
+        cout << "usage: journalBench [operations] [directory]" << endl;
+        return 1;
+    }
+    string snapshot = directory + "/journalBench.snapshot";
+    string journal = directory + "/journalBench.journal";
+    KeyGenerator gen;
+    vector<int> keys(n);
+    for (int i = 0; i < n; ++i) {
+        keys[i] = gen.nextKey(1 << 20);
+    }
+
+    RBTree<int, long> plain;
+    Stopwatch watch;
+    for (int i = 0; i < n; ++i) {
+        if (i % 4 == 3) {
+            keep(plain.extract(keys[i - 1]));
+        } else {
+            plain.insert(keys[i], keys[i]);
+        }
+    }
+    cout << "policy\t\tgroup\tops\tns/op\t\tsyncs" << endl;
+    cout << "no journal\t-\t" << n << "\t" << watch.elapsedNs() / n << endl;
+
+    const SyncPolicies policies[] = {SYNC_NEVER, SYNC_GROUP, SYNC_GROUP,
+        SYNC_GROUP, SYNC_ALWAYS};
+    const size_t groups[] = {0, 1000, 100, 10, 1};
+    const char * names[] = {"SYNC_NEVER", "SYNC_GROUP", "SYNC_GROUP",
+        "SYNC_GROUP", "SYNC_ALWAYS"};
+    for (int p = 0; p < 5; ++p) {
+        unlink(snapshot.c_str());
+        unlink(journal.c_str());
+        int ops = policies[p] == SYNC_ALWAYS? (n + 99) / 100: n;
+        JournaledRBTree<int, long> tree;
+        if (!tree.open(snapshot.c_str(), journal.c_str(), policies[p],
+            groups[p])) {
+            cout << "could not open " << journal << endl;
+            return 1;
+        }
+        watch.restart();
+        for (int i = 0; i < ops; ++i) {
+            if (i % 4 == 3) {
+                keep(tree.extract(keys[i - 1]));
+            } else {
+                tree.insert(keys[i], keys[i]);
+            }
+        }
+        tree.commit();
+        cout << names[p] << "\t" << groups[p] << "\t" << ops << "\t"
+            << watch.elapsedNs() / ops << "\t\t" << tree.getJournal().getSyncs()
+            << endl;
+    }
+
+    // The last journal is replaced by a full one to recover from.
+    unlink(snapshot.c_str());
+    unlink(journal.c_str());
+    {
+        JournaledRBTree<int, long> tree;
+        tree.open(snapshot.c_str(), journal.c_str(), SYNC_NEVER);
+        for (int i = 0; i < n; ++i) {
+            if (i % 4 == 3) {
+                tree.extract(keys[i - 1]);
+            } else {
+                tree.insert(keys[i], keys[i]);
+            }
+        }
+    }
+    JournaledRBTree<int, long> recovered;
+    watch.restart();
+    recovered.open(snapshot.c_str(), journal.c_str(), SYNC_NEVER);
+    double replayNs = watch.elapsedNs() / n;
+    watch.restart();
+    recovered.compact();
+    double compactNs = watch.elapsedNs() / n;
+    JournaledRBTree<int, long> loaded;
+    watch.restart();
+    loaded.open(snapshot.c_str(), journal.c_str(), SYNC_NEVER);
+    double loadNs = watch.elapsedNs() / n;
+    cout << "recovery from the journal\t" << replayNs << " ns/op" << endl;
+    cout << "compaction\t\t\t" << compactNs << " ns/op" << endl;
+    cout << "recovery from the snapshot\t" << loadNs << " ns/op" << endl;
+    if (recovered.size() != plain.size() || loaded.size() != plain.size() ||
+        !loaded.getTree().validate()) {
+        cout << "the trees differ" << endl;
+    }
+    unlink(snapshot.c_str());
+    unlink(journal.c_str());
+}
@@ -0,0 +1,54 @@
+#include <iostream>
+#include <stdlib.h>
+#include <vector>
+#include "Bench.hh"
+#include "RBTree.hh"
+
+using namespace std;
+
+/**
+ * @breif Fills a tree with random keys and looks up random ones, printing
+ *        the bytes each node takes and the cache misses of each lookup. Build
+ *        it with and without RBTREE_COMPACT_NODES to compare both layouts.
+ *        Usage: layoutBench [keys] [lookups]
+ */
+int main(int argc, char ** argv) {
+    int n = argc > 1? atoi(argv[1]): 10000000;
+    int lookups = argc > 2? atoi(argv[2]): 1000000;
+    if (n <= 0 || lookups <= 0) {
+        cout << "usage: layoutBench [keys] [lookups]" << endl;
+        return 1;
+    }
+    KeyGenerator gen;
+    vector<int> keys(n), probes(lookups);
+    for (int i = 0; i < n; ++i) keys[i] = gen.nextKey(1 << 30);
+    for (int i = 0; i < lookups; ++i) probes[i] = keys[gen.nextKey(n)];
+
+    long before = residentKb();
+    RBTree<int, int> * rbt = new RBTree<int, int>();
+    for (int i = 0; i < n; ++i) rbt->insert(keys[i], keys[i]);
+    long treeKb = residentKb() - before;
+    size_t nodes = rbt->getAllocator().getLive();
+
+    CacheMissCounter misses;
+    long sum = 0;
+    Stopwatch watch;
+    misses.start();
+    for (int i = 0; i < lookups; ++i) sum += rbt->exists(probes[i]);
+    long long missCount = misses.stop();
+    double lookupNs = watch.elapsedNs();
+    keep(sum);
+
+    cout << "layout: " << (RBTREE_COMPACT_NODES? "compact": "pointer") << endl;
+    cout << "nodes: " << nodes << ", sizeof(Node<int, int>): "
+        << sizeof(Node<int, int>) << " bytes" << endl;
+    cout << "resident bytes per node: " << treeKb * 1024.0 / nodes << endl;
+    cout << "lookup: " << lookupNs / lookups << " ns, cache misses: ";
+    if (missCount < 0) {
+        cout << "not counted here";
+    } else {
+        cout << (double) missCount / lookups;
+    }
+    cout << endl << "tree is valid: " << (rbt->validate()? "yes": "no") << endl;
+    delete rbt;
+}
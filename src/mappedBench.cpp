@@ -0,0 +1,100 @@
+#include <iostream>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "Bench.hh"
+#include "MappedRBTree.hh"
+#include "RBTree.hh"
+
+using namespace std;
+
+/**
+ * @breif Inserts n random keys in a tree in memory and in a tree mapped from
+ *        a file, and prints the ns per key of the inserts, of looking every
+ *        key up, of walking them in order and of extracting them. Then prints
+ *        how long reopening the file takes and how long it is.
+ *        Usage: mappedBench [keys] [path]
+ */
+int main(int argc, char ** argv) {
+    int n = argc > 1? atoi(argv[1]): 1000000;
+    string path = argc > 2? argv[2]: "mappedBench.tree";
+    if (n <= 0) {
+        cout << "usage: mappedBench [keys] [path]" << endl;
+        return 1;
+    }
+    KeyGenerator gen;
+    vector<int> keys(n);
+    for (int i = 0; i < n; ++i) {
+        keys[i] = gen.nextKey(1 << 30);
+    }
+    unlink(path.c_str());
+
+    RBTree<int, long> memory;
+    MappedRBTree<int, long> mapped;
+    if (!mapped.open(path.c_str(), 64 << 20)) {
+        cout << "could not map " << path << endl;
+        return 1;
+    }
+    double ns[2][4];
+    Stopwatch watch;
+    for (int i = 0; i < n; ++i) memory.insert(keys[i], keys[i]);
+    ns[0][0] = watch.elapsedNs() / n;
+    watch.restart();
+    for (int i = 0; i < n; ++i) mapped.insert(keys[i], keys[i]);
+    ns[1][0] = watch.elapsedNs() / n;
+
+    long found = 0;
+    watch.restart();
+    for (int i = 0; i < n; ++i) found += memory.exists(keys[i]);
+    ns[0][1] = watch.elapsedNs() / n;
+    watch.restart();
+    for (int i = 0; i < n; ++i) found += mapped.exists(keys[i]);
+    ns[1][1] = watch.elapsedNs() / n;
+
+    watch.restart();
+    for (Node<int, long> * node = memory.first(); node != NULL;
+        node = memory.next(node)) {
+        found += node->getKey();
+    }
+    ns[0][2] = watch.elapsedNs() / n;
+    watch.restart();
+    for (const MappedRBTree<int, long>::MNode * node = mapped.first();
+        node != NULL; node = mapped.next(node)) {
+        found += node->getKey();
+    }
+    ns[1][2] = watch.elapsedNs() / n;
+    keep(found);
+
+    watch.restart();
+    mapped.close();
+    double closeMs = watch.elapsedNs() / 1e6;
+    watch.restart();
+    bool reopened = mapped.open(path.c_str(), 64 << 20);
+    double openUs = watch.elapsedNs() / 1e3;
+    if (!reopened || mapped.size() != memory.size()) {
+        cout << "the file could not be opened again" << endl;
+        return 1;
+    }
+
+    watch.restart();
+    for (int i = 0; i < n; ++i) keep(memory.extract(keys[i]));
+    ns[0][3] = watch.elapsedNs() / n;
+    watch.restart();
+    for (int i = 0; i < n; ++i) keep(mapped.extract(keys[i]));
+    ns[1][3] = watch.elapsedNs() / n;
+
+    cout << "tree\tinsert ns\texists ns\twalk ns\textract ns" << endl;
+    const char * names[] = {"memory", "mapped"};
+    for (int t = 0; t < 2; ++t) {
+        cout << names[t] << "\t" << ns[t][0] << "\t\t" << ns[t][1] << "\t\t"
+            << ns[t][2] << "\t" << ns[t][3] << endl;
+    }
+    cout << "sync and close " << closeMs << " ms, reopen " << openUs
+        << " us, file " << mapped.length() << " bytes" << endl;
+    if (memory.size() != 0 || mapped.size() != 0 || !mapped.validate()) {
+        cout << "the trees differ" << endl;
+    }
+    mapped.close();
+    unlink(path.c_str());
+}
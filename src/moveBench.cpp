@@ -0,0 +1,134 @@
+#include <iostream>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "Bench.hh"
+#include "RBTree.hh"
+
+using namespace std;
+
+/**
+ * @breif A payload that is expensive to copy and counts how many times it is
+ *        copied and moved.
+ */
+class Heavy{
+    public:
+        static long copies;
+        static long moves;
+
+        string text;
+        vector<int> values;
+
+        Heavy(void) {}
+
+        Heavy(int seed) : text(256, 'a' + seed % 26), values(32, seed) {}
+
+        Heavy(const Heavy & other) : text(other.text), values(other.values) {
+            ++copies;
+        }
+
+        Heavy(Heavy && other) :
+            text(std::move(other.text)), values(std::move(other.values)) {
+            ++moves;
+        }
+
+        Heavy & operator=(const Heavy & other) {
+            this->text = other.text;
+            this->values = other.values;
+            ++copies;
+            return *this;
+        }
+
+        Heavy & operator=(Heavy && other) {
+            this->text = std::move(other.text);
+            this->values = std::move(other.values);
+            ++moves;
+            return *this;
+        }
+
+        bool operator==(const Heavy & other) const {
+            return this->values == other.values && this->text == other.text;
+        }
+
+        /**
+         * @breif Sets both counters back to 0.
+         */
+        static void reset(void) {
+            copies = 0;
+            moves = 0;
+        }
+};
+
+long Heavy::copies = 0;
+long Heavy::moves = 0;
+
+/**
+ * @breif Prints the counters and the time of a run.
+ * @param name The name of the run.
+ * @param ns   The elapsed nanoseconds.
+ * @param n    How many operations were done.
+ */
+void report(string name, double ns, int n) {
+    cout << name << "\t" << ns / n << "\t" << (double) Heavy::copies / n <<
+        "\t" << (double) Heavy::moves / n << endl;
+}
+
+/**
+ * @breif Counts copies and moves of a heavy payload through the insertion
+ *        paths of the tree: copying, moving, emplacing, repeated keys and
+ *        extraction.
+ *        Usage: moveBench [keys]
+ */
+int main(int argc, char ** argv) {
+    int n = argc > 1? atoi(argv[1]): 200000;
+    if (n <= 0) {
+        cout << "usage: moveBench [keys]" << endl;
+        return 1;
+    }
+    vector<int> keys(n);
+    KeyGenerator gen;
+    for (int i = 0; i < n; ++i) keys[i] = gen.nextKey(1 << 30);
+
+    cout << "path\tns/op\tcopies/op\tmoves/op" << endl;
+    Stopwatch watch;
+    {
+        RBTree<int, Heavy> rbt;
+        vector<Heavy> payloads;
+        for (int i = 0; i < n; ++i) payloads.push_back(Heavy(keys[i]));
+        Heavy::reset();
+        watch.restart();
+        for (int i = 0; i < n; ++i) rbt.insert(keys[i], payloads[i]);
+        report("insert(copy)", watch.elapsedNs(), n);
+
+        Heavy::reset();
+        watch.restart();
+        for (int i = 0; i < n; ++i) rbt.insert(keys[i], payloads[i]);
+        report("insert(repeated)", watch.elapsedNs(), n);
+
+        Heavy::reset();
+        watch.restart();
+        for (int i = 0; i < n; ++i) keep(rbt.extract(keys[i]));
+        report("extract(kept)", watch.elapsedNs(), n);
+
+        Heavy::reset();
+        watch.restart();
+        for (int i = 0; i < n; ++i) keep(rbt.extract(keys[i]));
+        report("extract(deleted)", watch.elapsedNs(), n);
+    }
+    {
+        RBTree<int, Heavy> rbt;
+        vector<Heavy> payloads;
+        for (int i = 0; i < n; ++i) payloads.push_back(Heavy(keys[i]));
+        Heavy::reset();
+        watch.restart();
+        for (int i = 0; i < n; ++i) rbt.insert(keys[i], std::move(payloads[i]));
+        report("insert(move)", watch.elapsedNs(), n);
+    }
+    {
+        RBTree<int, Heavy> rbt;
+        Heavy::reset();
+        watch.restart();
+        for (int i = 0; i < n; ++i) rbt.emplace(keys[i], keys[i]);
+        report("emplace", watch.elapsedNs(), n);
+    }
+}
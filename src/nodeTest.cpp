@@ -5,23 +5,23 @@
 
 using namespace std;
 
-template<typename T>
+template<typename Key, typename T>
 /**
  * @breig Returns a representig string of the Node's color.
  * @param  node The node on which we want to know the color.
  * @return      A string indicating if the node is RED or BLACK.
  */
-string whichColor(Node<T> * node) {
+string whichColor(Node<Key, T> * node) {
     return node->getColor() == RED? "RED": "BLACK";
 }
 
-template<typename T>
+template<typename Key, typename T>
 /**
  * @breif Prints all the properties a Node has.
  * @param node    The node of which we are printing its properties.
  * @param varName The name of the variable containing the node.
  */
-void printProprerties(Node<T> * node,string varName) {
+void printProprerties(Node<Key, T> * node,string varName) {
     if (node == NULL) return;//wont print a NULL Node, if that even makes sense.
     cout << "Printing the properties of " << varName << endl;
     cout << "\tI'm at: " << node << endl;
@@ -38,12 +38,12 @@ void printProprerties(Node<T> * node,string varName) {
  * @breif Node tests. Tries to ensure the class works correctly.
  */
 int main(void) {
-    Node<string> * node1 = new Node<string>(1,"foo");
+    Node<int, string> * node1 = new Node<int, string>(1,"foo");
     cout << "node1 created." << endl;
     printProprerties(node1, "node1");
     cout << endl;
 
-    Node<string> * node2 = new Node<string>(2,"bar");
+    Node<int, string> * node2 = new Node<int, string>(2,"bar");
     cout << "node2 created." << endl;
     printProprerties(node2, "node2");
     cout << endl;
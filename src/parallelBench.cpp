@@ -0,0 +1,81 @@
+#include <iostream>
+#include <stdlib.h>
+#include <thread>
+#include "Bench.hh"
+#include "RBTree.hh"
+
+using namespace std;
+
+/**
+ * @breif Sums the keys of a tree of random keys with a first()/next() walk
+ *        and with parallel_reduce(), ordered and not, from 1 to 32 threads,
+ *        and prints the time and the speedup over the walk. Then times
+ *        many sums of a small tree, each starting its threads or all on one
+ *        WorkPool kept between them.
+ *        Usage: parallelBench [keys]
+ */
+int main(int argc, char ** argv) {
+    int n = argc > 1? atoi(argv[1]): 10000000;
+    if (n <= 0) {
+        cout << "usage: parallelBench [keys]" << endl;
+        return 1;
+    }
+    KeyGenerator gen;
+    RBTree<int, int> * rbt = new RBTree<int, int>();
+    for (int i = 0; i < n; ++i) {
+        int key = gen.nextKey(1 << 30);
+        rbt->insert(key, key);
+    }
+    auto map = [](const Node<int, int> & node) {
+        return (long) node.getKey() * node.getMultiplicity();
+    };
+    auto combine = [](long a, long b) { return a + b; };
+
+    Stopwatch watch;
+    long walked = 0;
+    for (Node<int, int> * node = rbt->first(); node != NULL;
+        node = rbt->next(node)) {
+        walked += map(*node);
+    }
+    double walkMs = watch.elapsedNs() / 1e6;
+    cout << "cores: " << thread::hardware_concurrency() << endl;
+    cout << "walk\t\t" << walkMs << " ms" << endl;
+    cout << "threads\tordered ms\tspeedup\tunordered ms\tspeedup" << endl;
+    for (size_t threads = 1; threads <= 32; threads *= 2) {
+        watch.restart();
+        long ordered = rbt->parallel_reduce(0L, map, combine, true, threads);
+        double orderedMs = watch.elapsedNs() / 1e6;
+        watch.restart();
+        long unordered = rbt->parallel_reduce(0L, map, combine, false, threads);
+        double unorderedMs = watch.elapsedNs() / 1e6;
+        cout << threads << "\t" << orderedMs << "\t\t" << walkMs / orderedMs
+            << "\t" << unorderedMs << "\t\t" << walkMs / unorderedMs << endl;
+        if (ordered != walked || unordered != walked) {
+            cout << "the sums differ" << endl;
+        }
+    }
+    delete rbt;
+
+    RBTree<int, int> small;
+    for (int i = 0; i < 10000; ++i) {
+        small.insert(i, i);
+    }
+    const int sums = 1000;
+    long total = 0;
+    watch.restart();
+    for (int i = 0; i < sums; ++i) {
+        total += small.parallel_reduce(0L, map, combine, false, 0);
+    }
+    double startedUs = watch.elapsedNs() / 1e3 / sums;
+    WorkPool pool;
+    watch.restart();
+    for (int i = 0; i < sums; ++i) {
+        total += small.parallel_reduce(0L, map, combine, false, pool);
+    }
+    double pooledUs = watch.elapsedNs() / 1e3 / sums;
+    keep(total);
+    cout << "sum of 10000 keys, threads started per call\t" << startedUs
+        << " us" << endl;
+    cout << "sum of 10000 keys, one pool for every call\t" << pooledUs
+        << " us" << endl;
+}
@@ -0,0 +1,88 @@
+#include <iostream>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "Bench.hh"
+#include "RBTree.hh"
+
+using namespace std;
+
+template<typename Alloc>
+/**
+ * @breif Builds a tree with n random keys and then throws it away.
+ * @param n        How many keys to insert.
+ * @param insertNs Where the time spent inserting is added.
+ * @param clearNs  Where the time spent destroying the tree is added.
+ */
+void insertRun(int n, double * insertNs, double * clearNs) {
+    KeyGenerator gen;
+    RBTree<int, int, less<int>, Alloc> * rbt =
+        new RBTree<int, int, less<int>, Alloc>();
+    Stopwatch watch;
+    for (int i = 0; i < n; ++i) {
+        int key = gen.nextKey(n * 4);
+        rbt->insert(key, key);
+    }
+    *insertNs += watch.elapsedNs();
+    watch.restart();
+    delete rbt;
+    *clearNs += watch.elapsedNs();
+}
+
+template<typename Alloc>
+/**
+ * @breif Creates and destroys nodes the way an event queue does, keeping a
+ *        window of live nodes.
+ * @param n      How many nodes to create.
+ * @param window How many nodes are alive at once.
+ * @return The elapsed nanoseconds.
+ */
+double churnRun(int n, int window) {
+    Alloc allocator;
+    vector<Node<int, string> *> live(window, (Node<int, string> *) NULL);
+    Stopwatch watch;
+    for (int i = 0; i < n; ++i) {
+        allocator.destroy(live[i % window]);
+        live[i % window] = allocator.create(i, string("event"));
+    }
+    for (int i = 0; i < window; ++i) {
+        allocator.destroy(live[i]);
+    }
+    allocator.release();
+    return watch.elapsedNs();
+}
+
+/**
+ * @breif Compares the NodePool against plain new on insert heavy runs.
+ *        Usage: poolBench [keys] [rounds]
+ */
+int main(int argc, char ** argv) {
+    int n = argc > 1? atoi(argv[1]): 100000;
+    int rounds = argc > 2? atoi(argv[2]): 3;
+    if (n <= 0 || rounds <= 0) {
+        cout << "usage: poolBench [keys] [rounds]" << endl;
+        return 1;
+    }
+
+    double poolInsert = 0, poolClear = 0, newInsert = 0, newClear = 0;
+    for (int r = 0; r < rounds; ++r) {
+        insertRun<NodePool<Node<int, int> > >(n, &poolInsert, &poolClear);
+        insertRun<NewAllocator<Node<int, int> > >(n, &newInsert, &newClear);
+    }
+    double ops = (double) n * rounds;
+    cout << "keys: " << n << ", rounds: " << rounds << endl;
+    cout << "insert\tNodePool\t" << poolInsert / ops << " ns/op" << endl;
+    cout << "insert\tnew\t\t" << newInsert / ops << " ns/op" << endl;
+    cout << "destroy\tNodePool\t" << poolClear / rounds << " ns/tree" << endl;
+    cout << "destroy\tnew\t\t" << newClear / rounds << " ns/tree" << endl;
+
+    int events = n * 20;
+    double poolChurn = 0, newChurn = 0;
+    for (int r = 0; r < rounds; ++r) {
+        poolChurn += churnRun<NodePool<Node<int, string> > >(events, 1024);
+        newChurn += churnRun<NewAllocator<Node<int, string> > >(events, 1024);
+    }
+    ops = (double) events * rounds;
+    cout << "churn\tNodePool\t" << poolChurn / ops << " ns/op" << endl;
+    cout << "churn\tnew\t\t" << newChurn / ops << " ns/op" << endl;
+}
@@ -0,0 +1,103 @@
+#include <iostream>
+#include <stdlib.h>
+#include <functional>
+#include <queue>
+#include <set>
+#include <vector>
+#include "Bench.hh"
+#include "PriorityQueue.hh"
+
+using namespace std;
+
+/**
+ * @breif Compares the PriorityQueue against std::priority_queue and
+ *        std::multiset. Every structure is filled with n random keys, then
+ *        runs the hold model (pop the minimum, push a later key) and is
+ *        drained at the end.
+ *        Usage: pqBench [keys] [hold operations]
+ */
+int main(int argc, char ** argv) {
+    int n = argc > 1? atoi(argv[1]): 1000000;
+    int holds = argc > 2? atoi(argv[2]): n;
+    if (n <= 0 || holds < 0) {
+        cout << "usage: pqBench [keys] [hold operations]" << endl;
+        return 1;
+    }
+    vector<int> keys(n), increments(holds);
+    KeyGenerator gen;
+    for (int i = 0; i < n; ++i) keys[i] = gen.nextKey(1 << 30);
+    for (int i = 0; i < holds; ++i) increments[i] = 1 + gen.nextKey(1 << 20);
+
+    double push, hold, drain;
+    long sum = 0;
+    Stopwatch watch;
+
+    cout << "structure\tpush ns/op\thold ns/op\tpop ns/op" << endl;
+
+    {
+        PriorityQueue<int, int> * pq = new PriorityQueue<int, int>();
+        watch.restart();
+        for (int i = 0; i < n; ++i) pq->push(keys[i], keys[i]);
+        push = watch.elapsedNs();
+        watch.restart();
+        for (int i = 0; i < holds; ++i) {
+            int key = pq->peek_min()->getKey();
+            sum += pq->pop_min();
+            pq->push(key + increments[i], key + increments[i]);
+        }
+        hold = watch.elapsedNs();
+        watch.restart();
+        while (!pq->empty()) sum += pq->pop_min();
+        drain = watch.elapsedNs();
+        cout << "PriorityQueue\t" << push / n << "\t" << hold / (holds? holds: 1)
+            << "\t" << drain / n << endl;
+        delete pq;
+    }
+
+    {
+        priority_queue<int, vector<int>, greater<int> > pq;
+        watch.restart();
+        for (int i = 0; i < n; ++i) pq.push(keys[i]);
+        push = watch.elapsedNs();
+        watch.restart();
+        for (int i = 0; i < holds; ++i) {
+            int key = pq.top();
+            sum += key;
+            pq.pop();
+            pq.push(key + increments[i]);
+        }
+        hold = watch.elapsedNs();
+        watch.restart();
+        while (!pq.empty()) {
+            sum += pq.top();
+            pq.pop();
+        }
+        drain = watch.elapsedNs();
+        cout << "priority_queue\t" << push / n << "\t" << hold / (holds? holds: 1)
+            << "\t" << drain / n << endl;
+    }
+
+    {
+        multiset<int> ms;
+        watch.restart();
+        for (int i = 0; i < n; ++i) ms.insert(keys[i]);
+        push = watch.elapsedNs();
+        watch.restart();
+        for (int i = 0; i < holds; ++i) {
+            int key = *ms.begin();
+            sum += key;
+            ms.erase(ms.begin());
+            ms.insert(key + increments[i]);
+        }
+        hold = watch.elapsedNs();
+        watch.restart();
+        while (!ms.empty()) {
+            sum += *ms.begin();
+            ms.erase(ms.begin());
+        }
+        drain = watch.elapsedNs();
+        cout << "multiset\t" << push / n << "\t" << hold / (holds? holds: 1)
+            << "\t" << drain / n << endl;
+    }
+    keep(sum);
+}
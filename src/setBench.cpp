@@ -0,0 +1,86 @@
+#include <iostream>
+#include <stdlib.h>
+#include "Bench.hh"
+#include "RBTree.hh"
+
+using namespace std;
+
+/**
+ * @breif Fills a tree with random keys.
+ * @param tree The tree.
+ * @param n    How many keys.
+ * @param gen  The generator.
+ */
+void fill(RBTree<int, int> & tree, int n, KeyGenerator & gen) {
+    for (int i = 0; i < n; ++i) {
+        int key = gen.nextKey(1 << 24);
+        tree.insert(key, key);
+    }
+}
+
+/**
+ * @breif Merges a tree of m random keys into one of n, with union_with() and
+ *        intersect_with(), and the way it was done before, walking the small
+ *        tree and inserting into, or looking up in, the big one. The set
+ *        operations share one WorkPool. Prints the time of each in ms.
+ *        Usage: setBench [n] [threads]
+ */
+int main(int argc, char ** argv) {
+    int n = argc > 1? atoi(argv[1]): 1000000;
+    int threads = argc > 2? atoi(argv[2]): 0;
+    if (n <= 0 || threads < 0) {
+        cout << "usage: setBench [n] [threads]" << endl;
+        return 1;
+    }
+    WorkPool pool(threads);
+    cout << "m\tinsert ms\tunion ms\tlookup ms\tintersect ms" << endl;
+    for (int m = 100; m <= n; m *= 10) {
+        KeyGenerator gen;
+        RBTree<int, int> big, small, big2, small2;
+        fill(big, n, gen);
+        fill(small, m, gen);
+        KeyGenerator again;
+        fill(big2, n, again);
+        fill(small2, m, again);
+
+        Stopwatch watch;
+        for (Node<int, int> * node = small.first(); node != NULL;
+            node = small.next(node)) {
+            for (int i = 0; i < node->getMultiplicity(); ++i) {
+                big.insert(node->getKey(), node->getData());
+            }
+        }
+        double insertMs = watch.elapsedNs() / 1e6;
+        watch.restart();
+        big2.union_with(small2, SUM_MULTIPLICITY, pool);
+        double unionMs = watch.elapsedNs() / 1e6;
+        if (big.size() != big2.size()) {
+            cout << "the unions differ" << endl;
+        }
+
+        RBTree<int, int> big3, small3, big4, small4;
+        KeyGenerator third;
+        fill(big3, n, third);
+        fill(small3, m, third);
+        KeyGenerator fourth;
+        fill(big4, n, fourth);
+        fill(small4, m, fourth);
+        watch.restart();
+        long found = 0;
+        for (Node<int, int> * node = small3.first(); node != NULL;
+            node = small3.next(node)) {
+            found += big3.exists(node->getKey()) > 0;
+        }
+        double lookupMs = watch.elapsedNs() / 1e6;
+        watch.restart();
+        big4.intersect_with(small4, MIN_MULTIPLICITY, pool);
+        double intersectMs = watch.elapsedNs() / 1e6;
+        keep(found);
+        if (!big2.validate() || !big4.validate()) {
+            cout << "a tree is not valid" << endl;
+        }
+
+        cout << m << "\t" << insertMs << "\t\t" << unionMs << "\t\t"
+            << lookupMs << "\t\t" << intersectMs << endl;
+    }
+}
@@ -0,0 +1,83 @@
+#include <iostream>
+#include <stdlib.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Bench.hh"
+#include "ShardedRBTree.hh"
+
+using namespace std;
+
+/**
+ * @breif Runs the ingest on a number of threads, each thread inserts its
+ *        share of the keys and looks up one key for every four inserted.
+ * @param threads How many threads.
+ * @param keys    The keys, split evenly among the threads.
+ * @param op      The operation, called with a key and wether to insert it.
+ * @return The elapsed nanoseconds.
+ */
+template<typename Operation>
+double ingest(int threads, const vector<int> & keys, Operation op) {
+    vector<thread> workers;
+    Stopwatch watch;
+    for (int t = 0; t < threads; ++t) {
+        workers.push_back(thread([&keys, &op, t, threads](void) {
+            size_t from = keys.size() * t / threads;
+            size_t to = keys.size() * (t + 1) / threads;
+            for (size_t i = from; i < to; ++i) op(keys[i], i % 4 != 3);
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); ++t) workers[t].join();
+    return watch.elapsedNs();
+}
+
+/**
+ * @breif Measures the ingest on a ShardedRBTree and on a RBTree behind one
+ *        mutex, from 1 to 32 threads, and prints the throughput per core.
+ *        Usage: shardBench [operations] [shards]
+ */
+int main(int argc, char ** argv) {
+    int n = argc > 1? atoi(argv[1]): 4000000;
+    int shardCount = argc > 2? atoi(argv[2]): 64;
+    if (n <= 0 || shardCount <= 0) {
+        cout << "usage: shardBench [operations] [shards]" << endl;
+        return 1;
+    }
+    KeyGenerator gen;
+    vector<int> keys(n);
+    for (int i = 0; i < n; ++i) keys[i] = gen.nextKey(1 << 30);
+    vector<int> bounds;
+    for (int i = 1; i < shardCount; ++i) {
+        bounds.push_back((int) ((1LL << 30) * i / shardCount));
+    }
+    int cores = thread::hardware_concurrency() > 0?
+        thread::hardware_concurrency(): 1;
+
+    cout << "cores: " << cores << endl;
+    cout << "threads\tstructure\tMops/s\tMops/s per core" << endl;
+    for (int threads = 1; threads <= 32; threads *= 2) {
+        int busy = threads < cores? threads: cores;
+        {
+            ShardedRBTree<int, int> * sharded = new ShardedRBTree<int, int>(bounds);
+            double ns = ingest(threads, keys, [sharded](int key, bool write) {
+                if (write) sharded->insert(key, key);
+                else keep(sharded->exists(key));
+            });
+            cout << threads << "\tShardedRBTree\t" << n * 1e3 / ns << "\t"
+                << n * 1e3 / ns / busy << endl;
+            delete sharded;
+        }
+        {
+            RBTree<int, int> * rbt = new RBTree<int, int>();
+            mutex lock;
+            double ns = ingest(threads, keys, [rbt, &lock](int key, bool write) {
+                lock_guard<mutex> guard(lock);
+                if (write) rbt->insert(key, key);
+                else keep(rbt->exists(key));
+            });
+            cout << threads << "\tRBTree+mutex\t" << n * 1e3 / ns << "\t"
+                << n * 1e3 / ns / busy << endl;
+            delete rbt;
+        }
+    }
+}
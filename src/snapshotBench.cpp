@@ -0,0 +1,65 @@
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "Bench.hh"
+#include "RBTree.hh"
+
+using namespace std;
+
+/**
+ * @breif Rebuilds a tree of n random keys by replaying their inserts and by
+ *        loading a snapshot of it, and prints the ns per key of both, of
+ *        the save, and the size of the file.
+ *        Usage: snapshotBench [keys] [path]
+ */
+int main(int argc, char ** argv) {
+    int n = argc > 1? atoi(argv[1]): 1000000;
+    const char * path = argc > 2? argv[2]: "snapshotBench.snapshot";
+    if (n <= 0) {
+        cout << "usage: snapshotBench [keys] [path]" << endl;
+        return 1;
+    }
+    KeyGenerator gen;
+    vector<int> keys(n);
+    for (int i = 0; i < n; ++i) {
+        keys[i] = gen.nextKey(1 << 30);
+    }
+
+    Stopwatch watch;
+    RBTree<int, long> * replayed = new RBTree<int, long>();
+    for (int i = 0; i < n; ++i) {
+        replayed->insert(keys[i], keys[i] * 3L);
+    }
+    double replayNs = watch.elapsedNs() / n;
+
+    watch.restart();
+    if (!replayed->save(path)) {
+        cout << "could not write " << path << endl;
+        return 1;
+    }
+    double saveNs = watch.elapsedNs() / n;
+
+    watch.restart();
+    RBTree<int, long> * loaded = new RBTree<int, long>();
+    bool whole = loaded->load(path);
+    double loadNs = watch.elapsedNs() / n;
+
+    FILE * file = fopen(path, "rb");
+    long bytes = 0;
+    if (file != NULL) {
+        fseek(file, 0, SEEK_END);
+        bytes = ftell(file);
+        fclose(file);
+    }
+    remove(path);
+
+    cout << "keys\treplay ns\tsave ns\tload ns\tbytes" << endl;
+    cout << n << "\t" << replayNs << "\t\t" << saveNs << "\t" << loadNs << "\t"
+        << bytes << endl;
+    if (!whole || loaded->size() != replayed->size() || !loaded->validate()) {
+        cout << "the trees differ" << endl;
+    }
+    delete replayed;
+    delete loaded;
+}
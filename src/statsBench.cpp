@@ -0,0 +1,67 @@
+#include <iomanip>
+#include <iostream>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "Bench.hh"
+#include "RBTree.hh"
+
+using namespace std;
+
+/**
+ * @breif Inserts a stream of keys into an empty tree and prints, per
+ *        insert, the rotations, recolors, comparisons and depth of the
+ *        descent, with the median and 99th percentile latency of the
+ *        sampled inserts.
+ * @param name The name printed for the stream.
+ * @param keys The keys, in the order they are inserted.
+ */
+void measure(const string & name, const vector<int> & keys) {
+    RBTree<int, int> tree;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(keys[i], keys[i]);
+    }
+    TreeStats stats = tree.stats();
+    double n = keys.size();
+    cout << left << setw(12) << name
+        << (stats.rotateLeft + stats.rotateRight) / n << "\t"
+        << stats.recolors / n << "\t"
+        << stats.comparisons / (double) stats.descents << "\t"
+        << stats.depth / (double) stats.descents << "\t"
+        << stats.insertCases[2] / n << "\t"
+        << stats.inserts.percentile(0.5) << "\t"
+        << stats.inserts.percentile(0.99) << endl;
+}
+
+/**
+ * @breif Shows what inserts cost the tree for ascending, descending, random
+ *        and clustered keys, from the counts of RBTREE_STATS, which this
+ *        bench is built with.
+ *        Usage: statsBench [keys]
+ */
+int main(int argc, char ** argv) {
+    int n = argc > 1? atoi(argv[1]): 1000000;
+    if (n <= 0) {
+        cout << "usage: statsBench [keys]" << endl;
+        return 1;
+    }
+    if (!RBTREE_STATS) {
+        cout << "build with -DRBTREE_STATS=1" << endl;
+        return 1;
+    }
+    vector<int> ascending(n), descending(n), random(n), clustered(n);
+    KeyGenerator gen;
+    for (int i = 0; i < n; ++i) {
+        ascending[i] = i;
+        descending[i] = n - i;
+        random[i] = gen.nextKey(1 << 29);
+        // Runs of 64 growing keys starting at random places.
+        clustered[i] = i % 64 == 0? gen.nextKey(1 << 29): clustered[i - 1] + 1;
+    }
+    cout << "keys        rotate\trecolor\tcompare\tdepth\tcase 3\tp50 ns\tp99 ns"
+        << endl;
+    measure("ascending", ascending);
+    measure("descending", descending);
+    measure("random", random);
+    measure("clustered", clustered);
+}
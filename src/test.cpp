@@ -1,28 +1,43 @@
+#define RBTREE_ORDER_STATISTICS 1//rank and select are shown below
+
+#include <algorithm>
+#include <cctype>
 #include <iostream>
 #include <stddef.h>//This gets NULL
+#include <sys/wait.h>
+#include <functional>
+#include <iterator>
+#include <string_view>
+#include <vector>
 #include "Color.hh"
 #include "Node.hh"
 #include "RBTree.hh"
+#include "PriorityQueue.hh"
+#include "ShardedRBTree.hh"
+#include "PersistentRBTree.hh"
+#include "JournaledRBTree.hh"
+#include "MappedRBTree.hh"
+#include "BPlusTree.hh"
 
 using namespace std;
 
-template<typename T>
+template<typename Key, typename T>
 /**
  * @breig Returns a representig string of the Node's color.
  * @param  node The node on which we want to know the color.
  * @return      A string indicating if the node is RED or BLACK.
  */
-string whichColor(Node<T> * node) {
+string whichColor(Node<Key, T> * node) {
     return node->getColor() == RED? "RED": "BLACK";
 }
 
-template<typename T>
+template<typename Key, typename T>
 /**
  * @breif Prints all the properties a Node has.
  * @param node    The node of which we are printing its properties.
  * @param varName The name of the variable containing the node.
  */
-void printProprerties(Node<T> * node,string varName) {
+void printProprerties(Node<Key, T> * node,string varName) {
     if (node == NULL) return;//wont print a NULL Node, if that even makes sense.
     cout << "Printing the properties of " << varName << endl;
     cout << "\tI'm at: " << node << endl;
@@ -35,11 +50,48 @@ void printProprerties(Node<T> * node,string varName) {
     cout << "\tColor: " << whichColor(node) << endl;
 }
 
+/**
+ * @breif Orders strings ignoring the case of their letters, so two strings
+ *        it takes for the same may have different std::hash.
+ */
+struct CaseLess {
+    bool operator()(const string & a, const string & b) const {
+        return lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(),
+            [](char x, char y) { return tolower(x) < tolower(y); });
+    }
+};
+
+/**
+ * @breif Writes strings to snapshots as their length and their characters,
+ *        the rest as their bytes.
+ */
+struct StringSerializer : RawSerializer {
+    using RawSerializer::write;
+    using RawSerializer::read;
+
+    template<typename Out>
+    void write(Out & out, const string & value) {
+        uint32_t length = value.size();
+        out.write(&length, sizeof(length));
+        out.write(value.data(), length);
+    }
+
+    template<typename In>
+    bool read(In & in, string & value) {
+        uint32_t length;
+        if (!in.read(&length, sizeof(length)) || length > in.remaining()) {
+            return false;
+        }
+        value.resize(length);
+        return in.read(&value[0], length);
+    }
+};
+
 /**
  * @breif Tests.
  */
 int main(void) {
-    RBTree<string> * rbt = new RBTree<string>(5, "hola");
+    RBTree<int, string> * rbt = new RBTree<int, string>(5, "hola");
     cout << "rbt created, 5 added" << endl;
     rbt->insert(6,"soy 6");
     cout << "6 added" << endl;
@@ -71,7 +123,7 @@ int main(void) {
         << rbt->previous(rbt->last())->getData() << endl << endl;
 
 
-    RBTree<double> * rbt2 = new RBTree<double>(15, 5.0);
+    RBTree<int, double> * rbt2 = new RBTree<int, double>(15, 5.0);
     cout << "rbt created, 15 added" << endl;
     rbt2->insert(15,5.0);
     cout << "15 added...again(check its multiplicity)" << endl;
@@ -104,5 +156,267 @@ int main(void) {
         rbt2->previous(rbt2->last())->getKey() << " and it's data is: " <<
         rbt2->previous(rbt2->last())->getData() << endl;
 
+    cout << endl << "extracted from rbt: " << rbt->extract(2) << endl;
+    cout << "2 exists " << rbt->exists(2) << " times in rbt" << endl;
+    rbt2->extract(15);
+    cout << "15 exists " << rbt2->exists(15) << " times in rbt2" << endl;
+    rbt2->extract(15);
+    cout << "15 exists " << rbt2->exists(15) << " times in rbt2" << endl;
+
+    RBTree<int, string> * rbt3 = new RBTree<int, string>(
+        new Node<int, string>(7, "seven"));
+    rbt3->insert(new Node<int, string>(3, "three"));
+    rbt3->insert(new Node<int, string>(7, "seven"));
+    rbt3->extract(3);
+    cout << "tree of new nodes: 7 is " << rbt3->exists(7) << " times in it, "
+        << "valid: " << (rbt3->validate()? "yes": "no") << endl;
+    delete rbt3;
+
+    PriorityQueue<int, string> pq;
+    pq.push(30, "third");
+    pq.push(10, "first");
+    pq.push(20, "second");
+    pq.push(10, "first");
+    cout << endl << "pq has " << pq.size() << " elements, min key " <<
+        pq.peek_min()->getKey() << ", max key " << pq.peek_max()->getKey() << endl;
+    cout << "pq pops min: " << pq.pop_min() << ", " << pq.pop_min() <<
+        ", then max: " << pq.pop_max() << endl;
+    cout << "pq has " << pq.size() << " elements left" << endl;
+
+    RBTree<string, int, less<> > names;
+    names.insert("ana", 1);
+    names.insert("bob", 2);
+    names.insert("bob", 2);
+    string_view probe = "bob";
+    cout << endl << "bob exists " << names.exists(probe) <<
+        " times in names, looked up with a string_view" << endl;
+
+    RBTree<long long, string, greater<long long> > stamps;
+    stamps.insert(1700000000000000000LL, "later");
+    stamps.insert(1600000000000000000LL, "sooner");
+    cout << "with greater<> the first stamp is: " << stamps.first()->getData()
+        << endl;
+
+    vector<pair<int, string> > sorted;
+    sorted.push_back(make_pair(1, "one"));
+    sorted.push_back(make_pair(2, "two"));
+    sorted.push_back(make_pair(2, "two"));
+    sorted.push_back(make_pair(3, "three"));
+    RBTree<int, string> built = RBTree<int, string>::build_sorted(
+        sorted.begin(), sorted.end());
+    cout << "built from sorted pairs: " << built.size() << " elements, 2 is "
+        << built.exists(2) << " times, root key " << built.getRoot()->getKey()
+        << ", valid: " << (built.validate()? "yes": "no") << endl;
+
+    cout << "rbt2 has " << rbt2->rank(24) << " elements before 24, " <<
+        rbt2->count_range(10, 40) << " from 10 to 40, and its median key is "
+        << rbt2->select(rbt2->size() / 2)->getKey() << endl;
+
+    rbt2->insert(rbt2->find(60), 70, 7.0);
+    rbt2->setFingerSearch(true);
+    rbt2->insert(80, 8.0);
+    cout << "70 inserted from the node of 60, 80 with the finger, last key is "
+        << rbt2->last()->getKey() << endl;
+
+    cout << "rbt2 keys in order:";
+    for (const Node<int, double> & node : *rbt2) {
+        cout << " " << node.getKey();
+    }
+    cout << endl << "rbt2 keys from 10 to 40:";
+    size_t visited = rbt2->for_each_in_range(10, 40,
+        [](Node<int, double> & node) { cout << " " << node.getKey(); });
+    cout << " (" << visited << " nodes)" << endl;
+    cout << "rbt2 first key after 24 is " << rbt2->upper_bound(24)->getKey()
+        << ", 24 is in a range of " << distance(rbt2->equal_range(24).first,
+        rbt2->equal_range(24).second) << " node" << endl;
+
+    ShardedRBTree<int, string> shards(vector<int>{10, 20});
+    shards.insert(25, "c");
+    shards.insert(5, "a");
+    shards.insert(15, "b");
+    int minKey, maxKey;
+    shards.min(&minKey, NULL);
+    shards.max(&maxKey, NULL);
+    cout << "sharded tree has " << shards.shardCount() << " shards, keys from "
+        << minKey << " to " << maxKey << ":";
+    shards.for_each([](const Node<int, string> & node) {
+        cout << " " << node.getData();
+    });
+    cout << endl;
+
+    RBTree<int, string> events;
+    vector<pair<int, string> > burst{{7, "g"}, {3, "c"}, {7, "g"}, {1, "a"}};
+    size_t inserted = events.insert_batch(burst.begin(), burst.end());
+    cout << "batch inserted " << inserted << " events, 7 is " << events.exists(7)
+        << " times in the tree, valid: " << (events.validate()? "yes": "no")
+        << endl;
+
+    long keySum = events.parallel_reduce(0L,
+        [](const Node<int, string> & node) {
+            return (long) node.getKey() * node.getMultiplicity();
+        },
+        [](long a, long b) { return a + b; });
+    cout << "the keys of the events add up to " << keySum << endl;
+
+    RBTree<int, string> later = events.split(5);
+    cout << "split at 5 leaves " << events.size() << " events before and "
+        << later.size() << " from 5 on";
+    events.join(later);
+    cout << ", joined again " << events.size() << " events, valid: "
+        << (events.validate()? "yes": "no") << endl;
+
+    RBTree<int, string> worker1, worker2;
+    worker1.insert(1, "a");
+    worker1.insert(2, "b");
+    worker2.insert(2, "b");
+    worker2.insert(3, "c");
+    worker1.union_with(worker2, MAX_MULTIPLICITY);
+    cout << "union of the workers has " << worker1.size() << " elements, 2 is "
+        << worker1.exists(2) << " time, valid: "
+        << (worker1.validate()? "yes": "no") << endl;
+
+    RBTree<int, string> mineA, theirsB, mineC, theirsD;
+    mineA.insert(1, "a");
+    theirsB.insert(1, "b");
+    mineA.union_with(theirsB);
+    mineC.insert(1, "a");
+    theirsD.insert(1, "b");
+    mineC.intersect_with(theirsD);
+    cout << "union with other data under 1: 1 is " << mineA.exists(1)
+        << " time with data " << mineA.find(1)->getData()
+        << ", intersection has " << mineC.size() << " elements" << endl;
+
+    RBTree<int, string> restored;
+    worker1.save("test.snapshot", StringSerializer());
+    bool loaded = restored.load("test.snapshot", StringSerializer());
+    remove("test.snapshot");
+    cout << "snapshot loaded: " << (loaded? "yes": "no") << ", "
+        << restored.size() << " elements, 3 is " << restored.find(3)->getData()
+        << ", valid: " << (restored.validate()? "yes": "no") << endl;
+
+    {
+        JournaledRBTree<int, string, less<int>, NodePool<Node<int, string> >,
+            StringSerializer> journaled;
+        journaled.open("test.snapshot", "test.journal");
+        journaled.insert(1, "one");
+        journaled.insert(2, "two");
+        journaled.compact();
+        journaled.extract(1);
+    }
+    JournaledRBTree<int, string, less<int>, NodePool<Node<int, string> >,
+        StringSerializer> recovered;
+    bool recoveredOk = recovered.open("test.snapshot", "test.journal");
+    remove("test.snapshot");
+    remove("test.journal");
+    cout << "journal recovered: " << (recoveredOk? "yes": "no") << ", "
+        << recovered.size() << " element, 1 is " << recovered.exists(1)
+        << " times in the tree" << endl;
+
+    {
+        MappedRBTree<int, double> mapped;
+        mapped.open("test.tree");
+        mapped.insert(2, 0.5);
+        mapped.insert(1, 0.25);
+        mapped.insert(2, 0.5);
+    }
+    MappedRBTree<int, double> reopened;
+    bool mappedOk = reopened.open("test.tree");
+    cout << "mapped tree reopened: " << (mappedOk? "yes": "no") << ", first is "
+        << reopened.first()->getKey() << ", 2 is " << reopened.exists(2)
+        << " times in the tree, valid: " << (reopened.validate()? "yes": "no")
+        << endl;
+    reopened.close();
+    if (fork() == 0) {
+        // Crashes with the changes not synced.
+        MappedRBTree<int, double> crashed;
+        crashed.open("test.tree");
+        crashed.insert(3, 0.75);
+        crashed.extract(1);
+        _exit(0);
+    }
+    wait(NULL);
+    bool dirtyOk = reopened.open("test.tree");
+    bool recoverOk = reopened.open("test.tree", 1 << 20, true);
+    cout << "crashed mapped tree opened: " << (dirtyOk? "yes": "no")
+        << ", recovered: " << (recoverOk? "yes": "no") << ", "
+        << reopened.size() << " elements, valid: "
+        << (reopened.validate()? "yes": "no") << endl;
+    reopened.close();
+    remove("test.tree");
+
+    BPlusTree<int, string, less<int>, 4> wide;
+    for (int i = 10; i > 0; --i) {
+        wide.insert(i, to_string(i));
+    }
+    wide.insert(3, "3");
+    wide.extract(7);
+    cout << "b+ tree keys:";
+    for (auto position = wide.first(); position;
+        position = wide.next(position)) {
+        cout << " " << position.getKey();
+    }
+    cout << ", 3 is " << wide.exists(3) << " times in the tree, valid: "
+        << (wide.validate()? "yes": "no") << endl;
+
+    RBTree<int, string> thawed;
+    for (int i = 1; i <= 20; ++i) {
+        thawed.insert(i * 5, to_string(i * 5));
+    }
+    thawed.insert(50, "50");
+    FrozenTree<int, string> frozen = thawed.freeze();
+    cout << "frozen tree has " << frozen.size() << " elements, 50 is "
+        << frozen.exists(50) << " times in it, the first key from 42 on is "
+        << frozen.lower_bound(42).getKey() << ", keys:";
+    for (auto position = frozen.first(); position;
+        position = frozen.next(position)) {
+        cout << " " << position.getKey();
+    }
+    cout << endl;
+
+    RBTree<int, bool> flags;
+    flags.insert(1, true);
+    flags.insert(2, false);
+    FrozenTree<int, bool> frozenFlags = flags.freeze();
+    cout << "frozen flags: 1 is " << (frozenFlags.first().getData()? "on": "off")
+        << ", 2 is " << (frozenFlags.last().getData()? "on": "off") << endl;
+
+    thawed.setBloomFilter(true);
+    int misses = 0;
+    for (int i = 1; i <= 100; ++i) {
+        misses += thawed.exists(i * 5 + 1) == 0;
+    }
+    BloomStats filtered = thawed.bloomStats();
+    cout << "bloom filter answered " << filtered.rejected << " of " << misses
+        << " misses alone with " << filtered.bytes << " bytes, 50 is "
+        << thawed.exists(50) << " times in the tree" << endl;
+
+    RBTree<string, int, CaseLess> caseless;
+    caseless.insert("ABC", 1);
+    bool caselessFilter = caseless.setBloomFilter(true);
+    cout << "bloom filter with a case blind comparator: "
+        << (caselessFilter? "on": "off") << ", abc is "
+        << caseless.exists("abc") << " times in the tree" << endl;
+
+    PersistentRBTree<int, string> versions;
+    versions.insert(1, "one");
+    versions.insert(2, "two");
+    PersistentRBTree<int, string>::Snapshot before = versions.snapshot();
+    versions.insert(3, "three");
+    versions.extract(1);
+    cout << "persistent tree had " << before.size() << " elements, 1 is "
+        << before.exists(1) << " times in the old snapshot and "
+        << versions.exists(1) << " times now, " << versions.size()
+        << " elements now, valid: " << (versions.snapshot().validate()?
+        "yes": "no") << endl;
+
+    TreeStats counted = thawed.stats();
+    cout << "stats compiled in: " << (RBTREE_STATS? "yes": "no")
+        << ", thawed made " << counted.allocations << " nodes and "
+        << counted.rotateLeft + counted.rotateRight << " rotations" << endl;
+
+    cout << endl << "rbt passes the full audit: " <<
+        (rbt->validate()? "yes": "no") << endl;
+    cout << "rbt2 passes the full audit: " <<
+        (rbt2->validate()? "yes": "no") << endl;
 
 }
@@ -0,0 +1,238 @@
+#include <iostream>
+#include <fstream>
+#include <stdlib.h>
+#include <string.h>
+#include <functional>
+#include <map>
+#include <queue>
+#include <vector>
+#include "Bench.hh"
+#include "PriorityQueue.hh"
+
+using namespace std;
+
+/**
+ * @breif The key patterns every structure is filled with.
+ */
+const char * const patterns[] = {"sequential", "random", "zigzag"};
+
+/**
+ * @breif Returns the i-th key of a pattern. Keys are always even, so any odd
+ *        key is a miss. The zigzag pattern takes turns at both ends of the
+ *        range and meets in the middle, which keeps the fix-up rotating.
+ * @param pattern The pattern.
+ * @param i       The position of the key.
+ * @param n       How many keys the pattern has.
+ * @param gen     The generator for the random pattern.
+ * @return The key.
+ */
+int patternKey(const char * pattern, int i, int n, KeyGenerator & gen) {
+    if (strcmp(pattern, "sequential") == 0) return 2 * i;
+    if (strcmp(pattern, "random") == 0) return 2 * gen.nextKey(1 << 29);
+    return 2 * (i % 2 == 0? i / 2: n - 1 - i / 2);
+}
+
+/**
+ * @breif Shuffles keys, the same way on every run.
+ * @param keys The keys.
+ * @param gen  The generator.
+ */
+void shuffle(vector<int> & keys, KeyGenerator & gen) {
+    for (size_t i = keys.size(); i > 1; --i) {
+        swap(keys[i - 1], keys[gen.next() % i]);
+    }
+}
+
+/**
+ * @breif Runs ops operations in batches and records the time of each batch.
+ * @param rec The recorder, cleared first.
+ * @param ops How many operations to run.
+ * @param op  The operation, called with its position.
+ */
+template<typename Operation>
+void timeBatches(LatencyRecorder & rec, int ops, Operation op) {
+    int batch = ops / 100 > 1000? 1000: ops / 100 > 0? ops / 100: 1;
+    rec.clear();
+    Stopwatch watch;
+    for (int i = 0; i < ops; i += batch) {
+        int end = i + batch < ops? i + batch: ops;
+        watch.restart();
+        for (int j = i; j < end; ++j) op(j);
+        rec.add(watch.elapsedNs(), end - i);
+    }
+}
+
+/**
+ * @breif Writes a row of results to the CSV file and to the console.
+ * @param csv       The CSV file.
+ * @param structure The structure measured.
+ * @param pattern   The key pattern.
+ * @param operation The operation measured.
+ * @param n         How many keys the structure holds.
+ * @param rec       The measures.
+ * @param peakKb    The peak resident memory of the case.
+ */
+void report(ofstream & csv, const char * structure, const char * pattern,
+    const char * operation, int n, const LatencyRecorder & rec, long peakKb) {
+    csv << structure << "," << pattern << "," << operation << "," << n << ","
+        << rec.getOps() << "," << rec.nsPerOp() << "," << rec.percentile(50)
+        << "," << rec.percentile(90) << "," << rec.percentile(99) << ","
+        << peakKb << endl;
+    cout << structure << "\t" << pattern << "\t" << operation << "\t" << n
+        << "\t" << rec.nsPerOp() << " ns/op\tp99 " << rec.percentile(99)
+        << "\t" << peakKb << " kB" << endl;
+}
+
+/**
+ * @breif Measures the RBTree: insertion, hits, misses, iteration and churn,
+ *        extracting a live key and inserting a new one.
+ */
+void benchTree(ofstream & csv, const char * pattern, const vector<int> & keys,
+    const vector<int> & probes, const vector<int> & fresh) {
+    int n = keys.size();
+    LatencyRecorder rec;
+    long sum = 0;
+    resetPeakResident();
+    RBTree<int, int> * rbt = new RBTree<int, int>();
+    timeBatches(rec, n, [&](int i) { rbt->insert(keys[i], keys[i]); });
+    long peakKb = peakResidentKb();
+    report(csv, "RBTree", pattern, "insert", n, rec, peakKb);
+    timeBatches(rec, n, [&](int i) { sum += rbt->exists(probes[i]); });
+    report(csv, "RBTree", pattern, "exists hit", n, rec, peakKb);
+    timeBatches(rec, n, [&](int i) { sum += rbt->exists(probes[i] + 1); });
+    report(csv, "RBTree", pattern, "exists miss", n, rec, peakKb);
+    Node<int, int> * node = rbt->first();
+    timeBatches(rec, n, [&](int i) {
+        if (node == NULL) return;
+        sum += node->getKey();
+        node = rbt->next(node);
+    });
+    report(csv, "RBTree", pattern, "iterate", n, rec, peakKb);
+    vector<int> live(keys);
+    timeBatches(rec, n, [&](int i) {
+        rbt->extract(live[fresh[i] / 2 % n]);
+        live[fresh[i] / 2 % n] = fresh[i];
+        rbt->insert(fresh[i], fresh[i]);
+    });
+    report(csv, "RBTree", pattern, "churn", n, rec, peakResidentKb());
+    delete rbt;
+    keep(sum);
+}
+
+/**
+ * @breif Measures std::multimap on the same operations as the RBTree.
+ */
+void benchMultimap(ofstream & csv, const char * pattern,
+    const vector<int> & keys, const vector<int> & probes,
+    const vector<int> & fresh) {
+    int n = keys.size();
+    LatencyRecorder rec;
+    long sum = 0;
+    resetPeakResident();
+    multimap<int, int> * mm = new multimap<int, int>();
+    timeBatches(rec, n, [&](int i) { mm->insert(make_pair(keys[i], keys[i])); });
+    long peakKb = peakResidentKb();
+    report(csv, "multimap", pattern, "insert", n, rec, peakKb);
+    timeBatches(rec, n, [&](int i) { sum += mm->count(probes[i]); });
+    report(csv, "multimap", pattern, "exists hit", n, rec, peakKb);
+    timeBatches(rec, n, [&](int i) { sum += mm->count(probes[i] + 1); });
+    report(csv, "multimap", pattern, "exists miss", n, rec, peakKb);
+    multimap<int, int>::iterator it = mm->begin();
+    timeBatches(rec, n, [&](int i) {
+        if (it == mm->end()) return;
+        sum += it->first;
+        ++it;
+    });
+    report(csv, "multimap", pattern, "iterate", n, rec, peakKb);
+    vector<int> live(keys);
+    timeBatches(rec, n, [&](int i) {
+        multimap<int, int>::iterator found = mm->find(live[fresh[i] / 2 % n]);
+        if (found != mm->end()) mm->erase(found);
+        live[fresh[i] / 2 % n] = fresh[i];
+        mm->insert(make_pair(fresh[i], fresh[i]));
+    });
+    report(csv, "multimap", pattern, "churn", n, rec, peakResidentKb());
+    delete mm;
+    keep(sum);
+}
+
+/**
+ * @breif Measures the hold model, popping the minimum and pushing a later
+ *        key, on the PriorityQueue and on std::priority_queue.
+ */
+void benchQueues(ofstream & csv, const char * pattern,
+    const vector<int> & keys, const vector<int> & fresh) {
+    int n = keys.size();
+    LatencyRecorder rec;
+    long sum = 0;
+
+    resetPeakResident();
+    PriorityQueue<int, int> * pq = new PriorityQueue<int, int>();
+    timeBatches(rec, n, [&](int i) { pq->push(keys[i], keys[i]); });
+    long peakKb = peakResidentKb();
+    report(csv, "PriorityQueue", pattern, "push", n, rec, peakKb);
+    timeBatches(rec, n, [&](int i) {
+        int key = pq->peek_min()->getKey();
+        sum += pq->pop_min();
+        key += fresh[i] % 4096 * 2;
+        pq->push(key, key);
+    });
+    report(csv, "PriorityQueue", pattern, "hold", n, rec, peakKb);
+    delete pq;
+
+    resetPeakResident();
+    priority_queue<int, vector<int>, greater<int> > * heap =
+        new priority_queue<int, vector<int>, greater<int> >();
+    timeBatches(rec, n, [&](int i) { heap->push(keys[i]); });
+    peakKb = peakResidentKb();
+    report(csv, "priority_queue", pattern, "push", n, rec, peakKb);
+    timeBatches(rec, n, [&](int i) {
+        int key = heap->top();
+        sum += key;
+        heap->pop();
+        heap->push(key + fresh[i] % 4096 * 2);
+    });
+    report(csv, "priority_queue", pattern, "hold", n, rec, peakKb);
+    delete heap;
+    keep(sum);
+}
+
+/**
+ * @breif Measures the RBTree against std::multimap and the PriorityQueue
+ *        against std::priority_queue, at every power of ten from 1e3 keys to
+ *        the given maximum, filling them with sequential, random and zigzag
+ *        keys. Each operation is timed in batches, the CSV file gets the
+ *        mean and the p50, p90 and p99 of the batches, in ns per operation,
+ *        and the peak resident memory of the case.
+ *        Usage: treeBench [max keys] [csv file]
+ */
+int main(int argc, char ** argv) {
+    int maxKeys = argc > 1? atoi(argv[1]): 10000000;
+    const char * path = argc > 2? argv[2]: "bench.csv";
+    if (maxKeys < 1000) {
+        cout << "usage: treeBench [max keys, at least 1000] [csv file]" << endl;
+        return 1;
+    }
+    ofstream csv(path);
+    if (!csv) {
+        cout << "can't write " << path << endl;
+        return 1;
+    }
+    csv << "structure,pattern,operation,keys,ops,ns_per_op,p50_ns,p90_ns,"
+        "p99_ns,peak_rss_kb" << endl;
+
+    for (long n = 1000; n <= maxKeys; n *= 10) {
+        for (const char * pattern : patterns) {
+            KeyGenerator gen;
+            vector<int> keys(n), probes, fresh(n);
+            for (int i = 0; i < n; ++i) keys[i] = patternKey(pattern, i, n, gen);
+            probes = keys;
+            shuffle(probes, gen);
+            for (int i = 0; i < n; ++i) fresh[i] = 2 * gen.nextKey(1 << 29);
+            benchTree(csv, pattern, keys, probes, fresh);
+            benchMultimap(csv, pattern, keys, probes, fresh);
+            benchQueues(csv, pattern, keys, fresh);
+        }
+    }
+    cout << "results written to " << path << endl;
+}